@@ -11,45 +11,121 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <ctype.h>
+#include <limits.h>
 #include <unistd.h>
 #include <sys/wait.h>
 #include <sys/types.h>
 #include <signal.h>
 #include <errno.h>
+#include <poll.h>
+#include <sys/select.h>
+#include <sys/syscall.h>
+#include <sys/resource.h>
 #include "map.h"
+#include "fleet.h"
+#include "world.h"
+#include "ring.h"
+#include "ursula.h"
+#include "wheel.h"
+#include "placement.h"
 
-// Global pipe to Ursula
-FILE* ursula_pipe = NULL;
+// Plazo de cada espera de confirmación en el canal antes de comprobar si el barco sigue vivo
+#define RING_ACK_TIMEOUT_MS 100
+// Plazo de los barcos para retirarse tras SIGQUIT antes de hundirlos con SIGKILL
+#define TEARDOWN_GRACE_MS 3000
+// Rondas máximas de una orden goto o formation
+#define FLEET_MAX_ROUNDS 1000
+// Un barco sin latido durante este tiempo se marca en status (en modo capitán sólo late al recibir órdenes)
+#define TELEMETRY_STALE_MS 5000
+
+// Conexión con Ursula (FIFO o anillo en memoria compartida, ver ursula.h)
+UrsulaLink ursula_link;
 
 pid_t my_pid;
 
+// Ursula a las que se dirigen "sea" y "query": la de --ursula o, si es un fichero de federación, la de cada región
+int region_count = 0;
+char region_fifo[URSULA_MAX_REGIONS][PATH_MAX];
+
+// Estado del mar publicado por cada Ursula (proyección de solo lectura, NULL hasta el primer "sea")
+const WorldState* sea[URSULA_MAX_REGIONS];
+
+// Conexión con el servicio de consultas espaciales de cada Ursula (NULL hasta el primer "query")
+FILE* query_stream[URSULA_MAX_REGIONS];
+
+// Registro de la flota (ver fleet.h). Se modifica también desde handle_sigchld, así que el bucle
+// principal bloquea SIGCHLD mientras lo recorre o lo modifica.
+Fleet fleet;
+
+// Número del último comando enviado por un canal en memoria compartida
+uint32_t ring_seq = 0;
+
+// Grupo de procesos de la flota: las órdenes a todos los barcos son un único killpg (0 hasta lanzar el primero)
+pid_t fleet_pgid = 0;
+// 1 mientras la flota está detenida con la orden "pause"
+int fleet_paused = 0;
+// cgroup de la flota (vacío si no se pidió --cgroup)
+char fleet_cgroup[512] = "";
+
+// Máscara con SIGCHLD para las secciones críticas y máscara original para esperar con sigsuspend
+sigset_t sigchld_mask;
+sigset_t wait_mask;
+
 /**
- * @brief Estructura para rastrear barcos lanzados y sus canales de comunicación
+ * @brief Da de baja del registro a un barco ya recolectado y muestra el resultado (oro recolectado o si fue hundido).
+ * Se llama desde handle_sigchld o, con SIGCHLD bloqueada, desde fleet_teardown.
+ * @param pid PID del proceso recolectado.
+ * @param status Estado devuelto por waitpid.
  */
-typedef struct
+void ship_finished(pid_t pid, int status)
 {
-    int id;
-    pid_t pid;
-    // Capitán escribe en [1], Barco lee de [0] (stdin)
-    int pipe_to_ship[2];
-    // Barco escribe en [1] (stdout), Capitán lee de [0]
-    int pipe_from_ship[2];
-    // Wrapper FILE* para pipe_from_ship[0] para el uso de getline
-    FILE* read_stream;
-    // Rastrear posición para detección de colisiones
-    int x, y;
-    // 1 si está vivo, 0 si terminó
-    int active;
-} ShipRecord;
-
-ShipRecord launched_ships[100];
-int ships_count = 0;
+    int finished_id = -1;
+    ShipRecord* ship = fleet_find_pid(&fleet, pid);
+    if (ship)
+    {
+        finished_id = ship->id;
+
+        if (ship->pidfd != -1) close(ship->pidfd);
+        close(ship->pipe_to_ship[1]);
+        // read_stream envuelve pipe_from_ship[0]: fclose cierra ambos
+        if (ship->read_stream)
+        {
+            fclose(ship->read_stream);
+            ship->read_stream = NULL;
+        }
+        else
+        {
+            close(ship->pipe_from_ship[0]);
+        }
+        ring_channel_destroy(ship->channel);
+        ship->channel = NULL;
+        telemetry_destroy(ship->telemetry);
+        ship->telemetry = NULL;
+        fleet_remove(&fleet, ship);
+        // Sin barcos el grupo deja de existir y su número podría reutilizarse para otro proceso
+        if (fleet_count(&fleet) == 0) fleet_pgid = 0;
+    }
+
+    if (finished_id != -1)
+    {
+        if (WIFEXITED(status))
+        {
+            int gold_collected = WEXITSTATUS(status);
+            fprintf(stderr, "[Capitán] Barco %d (PID %d) ha terminado. Tesoros recolectados: %d\n",
+                    finished_id, pid, gold_collected);
+        }
+        else if (WIFSIGNALED(status))
+        {
+            fprintf(stderr, "[Capitán] Barco %d (PID %d) fue hundido por la señal %d.\n",
+                    finished_id, pid, WTERMSIG(status));
+        }
+    }
+}
 
 /**
  * @brief Manejador de la señal SIGCHLD para detectar cuando los barcos terminan
  * * Este manejador utiliza waitpid con WNOHANG para recolectar procesos hijos sin bloquear.
- * * Identifica qué barco terminó buscando el PID coincidente, actualiza el registro del barco,
- *   y muestra el resultado (oro recolectado o si fue hundido).
  * @param sig Número de la señal (no usado)
  */
 void handle_sigchld(int sig)
@@ -60,42 +136,89 @@ void handle_sigchld(int sig)
 
     while ((pid = waitpid(-1, &status, WNOHANG)) > 0)
     {
-        int finished_id = -1;
-        for (int i = 0; i < 100; i++)
-        {
-            if (launched_ships[i].pid == pid)
-            {
-                finished_id = launched_ships[i].id;
-                launched_ships[i].pid = 0;
-                launched_ships[i].active = 0;
+        ship_finished(pid, status);
+    }
+}
 
-                close(launched_ships[i].pipe_to_ship[1]);
-                close(launched_ships[i].pipe_from_ship[0]);
-                if (launched_ships[i].read_stream)
-                {
-                    fclose(launched_ships[i].read_stream);
-                    launched_ships[i].read_stream = NULL;
-                }
-                break;
-            }
-        }
+/**
+ * @brief Envía una señal a toda la flota con un único killpg sobre su grupo de procesos.
+ * @return 0 en caso de éxito, -1 si no hay flota o el grupo ya no existe.
+ */
+int fleet_signal(int sig)
+{
+    // killpg(0, ...) alcanzaría al grupo del propio capitán
+    if (fleet_pgid <= 0) return -1;
+    return killpg(fleet_pgid, sig);
+}
 
-        if (finished_id != -1)
+/**
+ * @brief Retira a toda la flota: SIGQUIT al grupo (y SIGCONT por si estaba detenida) y espera el fin de cada
+ * barco en su pidfd, sin depender de que lleguen las SIGCHLD. Los barcos que no se retiran en
+ * TEARDOWN_GRACE_MS se hunden con SIGKILL. Se llama con SIGCHLD bloqueada.
+ */
+void fleet_teardown(void)
+{
+    int n = fleet_count(&fleet);
+    struct pollfd* fds = malloc(sizeof(struct pollfd) * (n > 0 ? n : 1));
+    pid_t* pids = malloc(sizeof(pid_t) * (n > 0 ? n : 1));
+    int waiting = 0;
+
+    if (fleet_signal(SIGQUIT) == 0)
+    {
+        fleet_signal(SIGCONT);
+    }
+    else
+    {
+        for (int i = 0; i < n; i++) kill(fleet_at(&fleet, i)->pid, SIGQUIT);
+    }
+    fleet_paused = 0;
+
+    // Barcos sin pidfd (o sin memoria para vigilarlos): se esperan con sigsuspend como antes
+    for (int i = 0; fds && pids && i < n; i++)
+    {
+        ShipRecord* ship = fleet_at(&fleet, i);
+        if (ship->pidfd == -1) continue;
+        fds[waiting].fd = ship->pidfd;
+        fds[waiting].events = POLLIN;
+        pids[waiting] = ship->pid;
+        waiting++;
+    }
+
+    int timeout = TEARDOWN_GRACE_MS;
+    while (waiting > 0)
+    {
+        int ready = poll(fds, waiting, timeout);
+        if (ready == -1 && errno != EINTR) break;
+        if (ready == 0)
         {
-            ships_count--;
+            fprintf(stderr, "[Capitán] %d barcos no se retiran, se hunden con SIGKILL.\n", waiting);
+            for (int i = 0; i < waiting; i++) syscall(SYS_pidfd_send_signal, fds[i].fd, SIGKILL, NULL, 0);
+            timeout = -1;
+            continue;
+        }
 
-            if (WIFEXITED(status))
-            {
-                int gold_collected = WEXITSTATUS(status);
-                fprintf(stderr, "[Capitán] Barco %d (PID %d) ha terminado. Tesoros recolectados: %d\n",
-                        finished_id, pid, gold_collected);
-            }
-            else if (WIFSIGNALED(status))
+        // Recolectar los terminados y compactar la lista (ship_finished cierra su pidfd)
+        int kept = 0;
+        for (int i = 0; i < waiting; i++)
+        {
+            int status;
+            if ((fds[i].revents & (POLLIN | POLLHUP | POLLERR)) && waitpid(pids[i], &status, WNOHANG) > 0)
             {
-                fprintf(stderr, "[Capitán] Barco %d (PID %d) fue hundido por la señal %d.\n",
-                        finished_id, pid, WTERMSIG(status));
+                ship_finished(pids[i], status);
+                continue;
             }
+            fds[kept] = fds[i];
+            pids[kept] = pids[i];
+            kept++;
         }
+        waiting = kept;
+    }
+    free(fds);
+    free(pids);
+
+    while (fleet_count(&fleet) > 0)
+    {
+        sigsuspend(&wait_mask);
     }
 }
 
@@ -110,12 +233,14 @@ void handle_sigint(int sig)
     (void)sig;
     fprintf(stderr, "\n[Capitán] ¡Señal SIGINT recibida! Ordenando retirada (SIGQUIT) a todos los barcos...\n");
 
-    for (int i = 0; i < 100; i++)
+    if (fleet_signal(SIGQUIT) == 0)
     {
-        if (launched_ships[i].pid > 0 && launched_ships[i].active)
-        {
-            kill(launched_ships[i].pid, SIGQUIT);
-        }
+        fleet_signal(SIGCONT); // Una flota detenida no atendería la retirada
+        return;
+    }
+    for (int i = 0; i < fleet_count(&fleet); i++)
+    {
+        kill(fleet_at(&fleet, i)->pid, SIGQUIT);
     }
 }
 
@@ -126,12 +251,534 @@ void handle_sigint(int sig)
  */
 void cleanup_ursula()
 {
-    if (ursula_pipe)
+    UrsulaEvent ev = {URSULA_END_CAPT, my_pid, 0, 0, 0, 0, 0};
+    ursula_send(&ursula_link, &ev);
+    ursula_disconnect(&ursula_link);
+}
+
+/** @brief Retira el cgroup de la flota a la salida (registrada con atexit). */
+void cleanup_cgroup()
+{
+    placement_cgroup_remove(fleet_cgroup);
+}
+
+/** @return 1 si algún barco no tiene página de telemetría y status tendría que preguntarle con SIGTSTP. */
+int fleet_needs_polling(void)
+{
+    for (int i = 0; i < fleet_count(&fleet); i++)
+    {
+        if (!fleet_at(&fleet, i)->telemetry) return 1;
+    }
+    return 0;
+}
+
+/** @return 1 si el barco sigue vivo, 0 si ya terminó (aunque no se haya recolectado). */
+int ship_alive(ShipRecord* ship)
+{
+    siginfo_t info;
+    info.si_pid = 0;
+    return waitid(P_PID, ship->pid, &info, WEXITED | WNOHANG | WNOWAIT) == 0 && info.si_pid == 0;
+}
+
+/**
+ * @brief Encola un comando en el canal en memoria compartida del barco, sin esperar su confirmación.
+ * Se llama con SIGCHLD bloqueada, así que el canal sigue proyectado aunque el barco muera: cada
+ * RING_ACK_TIMEOUT_MS se comprueba con waitid (sin recolectarlo) si sigue vivo.
+ * @param ship Barco destino.
+ * @param op Operación (RING_CMD_*).
+ * @param dx, dy Argumentos del comando.
+ * @param seq Recibe el número del comando, que repetirá su confirmación.
+ * @return 0 si el comando fue entregado, -1 si el barco ya no responde.
+ */
+int ring_send(ShipRecord* ship, int op, int dx, int dy, uint32_t* seq)
+{
+    RingRecord cmd = {++ring_seq, op, dx, dy};
+    *seq = cmd.seq;
+    while (ring_push_wait(&ship->channel->to_ship, &cmd, RING_ACK_TIMEOUT_MS) != 0)
+    {
+        if (!ship_alive(ship)) return -1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Espera la confirmación del comando seq. Las confirmaciones de comandos que dimos por perdidos se descartan.
+ * @return 0 si llegó la confirmación, -1 si el barco ya no responde.
+ */
+int ring_wait_ack(ShipRecord* ship, uint32_t seq, RingRecord* ack)
+{
+    while (1)
+    {
+        if (ring_pop_wait(&ship->channel->to_captain, ack, RING_ACK_TIMEOUT_MS) == 0)
+        {
+            if (ack->seq == seq) return 0;
+            continue;
+        }
+        if (!ship_alive(ship)) return -1;
+    }
+}
+
+/**
+ * @brief Envía un comando por el canal en memoria compartida del barco y espera su confirmación.
+ * @param ack Recibe la confirmación del barco (puede ser NULL si no se espera respuesta).
+ * @return 0 si el comando fue entregado (y confirmado, si se pidió), -1 si el barco ya no responde.
+ */
+int ring_command(ShipRecord* ship, int op, int dx, int dy, RingRecord* ack)
+{
+    uint32_t seq;
+    if (ring_send(ship, op, dx, dy, &seq) != 0) return -1;
+    if (!ack) return 0;
+    return ring_wait_ack(ship, seq, ack);
+}
+
+/** @brief Nombre del comando de movimiento (protocolo de tuberías) para el paso (dx, dy). */
+const char* step_name(int dx, int dy)
+{
+    if (dx > 0) return "right";
+    if (dx < 0) return "left";
+    return dy > 0 ? "down" : "up";
+}
+
+/** @return 0 si dir es up/down/left/right (y deja su paso en dx, dy), -1 en caso contrario. */
+int parse_step(const char* dir, int* dx, int* dy)
+{
+    *dx = 0;
+    *dy = 0;
+    if (strcasecmp(dir, "up") == 0) *dy = -1;
+    else if (strcasecmp(dir, "down") == 0) *dy = 1;
+    else if (strcasecmp(dir, "left") == 0) *dx = -1;
+    else if (strcasecmp(dir, "right") == 0) *dx = 1;
+    else return -1;
+    return 0;
+}
+
+/**
+ * @brief Mueve a la vez un paso a cada barco de la lista. Primero descarta los pasos hacia rocas o fuera del mapa y
+ * resuelve las colisiones internas de la flota en una pasada (fleet_plan); después envía todos los comandos sin
+ * esperar, y sólo entonces recoge las confirmaciones: los barcos trabajan en paralelo y la orden completa cuesta un
+ * viaje de ida y vuelta, no uno por barco. Se llama con SIGCHLD bloqueada.
+ * Si un barco rechaza su paso (p.ej. sin comida), el que lo seguía puede acabar en su misma celda; el combate
+ * lo resuelve Ursula como en cualquier otro encuentro.
+ * @param dx, dy Paso de cada barco (se modifican: quedan a 0 los pasos que no se dieron).
+ * @return Número de barcos que confirmaron su movimiento.
+ */
+int fleet_step(Map* map, ShipRecord** ships, int* dx, int* dy, int n)
+{
+    uint32_t* seqs = malloc(sizeof(uint32_t) * (n > 0 ? n : 1));
+    char* resp_line = NULL;
+    size_t resp_len = 0;
+    int moved = 0;
+    if (!seqs) return 0;
+
+    for (int i = 0; i < n; i++)
+    {
+        if ((dx[i] != 0 || dy[i] != 0) && !map_can_sail(map, ships[i]->x + dx[i], ships[i]->y + dy[i]))
+        {
+            dx[i] = 0;
+            dy[i] = 0;
+        }
+    }
+    if (fleet_plan(&fleet, ships, dx, dy, n) < 0)
+    {
+        free(seqs);
+        return 0;
+    }
+
+    // Ida: todos los comandos
+    for (int i = 0; i < n; i++)
+    {
+        if (dx[i] == 0 && dy[i] == 0) continue;
+        int sent = ships[i]->channel ? ring_send(ships[i], RING_CMD_MOVE, dx[i], dy[i], &seqs[i]) == 0
+                                     : dprintf(ships[i]->pipe_to_ship[1], "%s\n", step_name(dx[i], dy[i])) > 0;
+        if (!sent)
+        {
+            dx[i] = 0;
+            dy[i] = 0;
+        }
+    }
+
+    // Vuelta: las confirmaciones (mientras se espera a uno, los demás ya están trabajando)
+    for (int i = 0; i < n; i++)
+    {
+        if (dx[i] == 0 && dy[i] == 0) continue;
+        int confirmed = 0;
+        if (ships[i]->channel)
+        {
+            RingRecord ack;
+            confirmed = ring_wait_ack(ships[i], seqs[i], &ack) == 0 && ack.op == RING_ACK_OK;
+        }
+        else if (getline(&resp_line, &resp_len, ships[i]->read_stream) > 0)
+        {
+            confirmed = strncmp(resp_line, "OK", 2) == 0;
+        }
+
+        if (confirmed && fleet_move(&fleet, ships[i], ships[i]->x + dx[i], ships[i]->y + dy[i]) == 0)
+        {
+            moved++;
+        }
+        else
+        {
+            dx[i] = 0;
+            dy[i] = 0;
+        }
+    }
+
+    free(resp_line);
+    free(seqs);
+    return moved;
+}
+
+/**
+ * @brief Lleva cada barco de la lista hacia su destino (tx[i], ty[i]) por rondas: en cada ronda cada barco da un paso
+ * (por el eje en que le queda más distancia, o por el otro si ese es roca) y todos se mueven con fleet_step.
+ * Si una ronda no mueve a ninguno se reintenta una vez por el otro eje (para rodear a barcos quietos); termina
+ * cuando todos han llegado o tampoco así se mueve ninguno.
+ */
+void fleet_goto(Map* map, ShipRecord** ships, const int* tx, const int* ty, int n)
+{
+    int* dx = malloc(sizeof(int) * (n > 0 ? n : 1));
+    int* dy = malloc(sizeof(int) * (n > 0 ? n : 1));
+    int rounds = 0, arrived = 0, other_axis = 0;
+    if (!dx || !dy)
+    {
+        free(dx);
+        free(dy);
+        return;
+    }
+
+    while (rounds < FLEET_MAX_ROUNDS)
+    {
+        int pending = 0;
+        for (int i = 0; i < n; i++)
+        {
+            int ddx = tx[i] - ships[i]->x, ddy = ty[i] - ships[i]->y;
+            int sx = (ddx > 0) - (ddx < 0), sy = (ddy > 0) - (ddy < 0);
+            int first_x = (abs(ddx) >= abs(ddy)) != other_axis;
+
+            dx[i] = first_x ? sx : 0;
+            dy[i] = first_x ? 0 : sy;
+            if (!map_can_sail(map, ships[i]->x + dx[i], ships[i]->y + dy[i]))
+            {
+                dx[i] = first_x ? 0 : sx;
+                dy[i] = first_x ? sy : 0;
+            }
+            if (dx[i] != 0 || dy[i] != 0) pending++;
+        }
+        if (pending == 0) break;
+        if (fleet_step(map, ships, dx, dy, n) > 0) other_axis = 0;
+        else if (!other_axis) other_axis = 1;
+        else break;
+        rounds++;
+    }
+
+    for (int i = 0; i < n; i++)
+    {
+        if (ships[i]->x == tx[i] && ships[i]->y == ty[i]) arrived++;
+    }
+    fprintf(stderr, "%d de %d barcos en su destino tras %d rondas.\n", arrived, n, rounds);
+    free(dx);
+    free(dy);
+}
+
+static int compare_ship_id(const void* a, const void* b)
+{
+    int ia = (*(ShipRecord* const*)a)->id, ib = (*(ShipRecord* const*)b)->id;
+    return (ia > ib) - (ia < ib);
+}
+
+/**
+ * @brief Ejecuta una orden a varios barcos:
+ *   all <dir>                          toda la flota un paso
+ *   group <a>-<b> <dir>                los barcos con ID entre a y b un paso
+ *   group <a>-<b> goto <x> <y>         esos barcos hacia (x, y), por rondas
+ *   formation line|column              la flota en fila (o columna) a partir del barco de menor ID
+ * Se llama con SIGCHLD bloqueada.
+ * @return 0 si la orden era válida, -1 en caso contrario.
+ */
+int fleet_order(Map* map, const char* cmd_line)
+{
+    char kind[16], dir[16];
+    int lo = INT_MIN, hi = INT_MAX, x = 0, y = 0;
+    int go = 0, formation = 0, dx0 = 0, dy0 = 0;
+
+    if (sscanf(cmd_line, "%15s", kind) != 1) return -1;
+    if (strcasecmp(kind, "all") == 0)
+    {
+        if (sscanf(cmd_line, "%*s %15s", dir) != 1 || parse_step(dir, &dx0, &dy0) != 0) return -1;
+    }
+    else if (strcasecmp(kind, "group") == 0)
+    {
+        int fields = sscanf(cmd_line, "%*s %d-%d %15s %d %d", &lo, &hi, dir, &x, &y);
+        if (fields == 5 && strcasecmp(dir, "goto") == 0) go = 1;
+        else if (fields != 3 || parse_step(dir, &dx0, &dy0) != 0) return -1;
+    }
+    else if (strcasecmp(kind, "formation") == 0)
+    {
+        if (sscanf(cmd_line, "%*s %15s", dir) != 1) return -1;
+        if (strcasecmp(dir, "line") == 0) formation = 1;
+        else if (strcasecmp(dir, "column") == 0) formation = 2;
+        else return -1;
+    }
+    else
+    {
+        return -1;
+    }
+
+    int total = fleet_count(&fleet);
+    ShipRecord** ships = malloc(sizeof(ShipRecord*) * (total > 0 ? total : 1));
+    int* ax = malloc(sizeof(int) * (total > 0 ? total : 1));
+    int* ay = malloc(sizeof(int) * (total > 0 ? total : 1));
+    int n = 0;
+    if (!ships || !ax || !ay)
+    {
+        free(ships);
+        free(ax);
+        free(ay);
+        fprintf(stderr, "Sin memoria para la orden.\n");
+        return 0;
+    }
+
+    for (int i = 0; i < total; i++)
+    {
+        ShipRecord* ship = fleet_at(&fleet, i);
+        if (ship->id >= lo && ship->id <= hi) ships[n++] = ship;
+    }
+    qsort(ships, n, sizeof(ShipRecord*), compare_ship_id);
+
+    if (formation || go)
+    {
+        // Destinos: la celda pedida, o la fila/columna que empieza en el barco de menor ID
+        // Los barcos con destino inalcanzable (roca, otra componente de agua) se quedan fuera de la orden sin gastar
+        // comida en buscarlo
+        int reachable = 0;
+        for (int i = 0; i < n; i++)
+        {
+            int tx = formation ? ships[0]->x + (formation == 1 ? i : 0) : x;
+            int ty = formation ? ships[0]->y + (formation == 2 ? i : 0) : y;
+            if (!map_same_component(map, ships[i]->x, ships[i]->y, tx, ty)) continue;
+            ships[reachable] = ships[i];
+            ax[reachable] = tx;
+            ay[reachable++] = ty;
+        }
+        if (reachable < n) fprintf(stderr, "%d barcos no pueden llegar a su destino, se quedan donde están.\n", n - reachable);
+        fleet_goto(map, ships, ax, ay, reachable);
+    }
+    else
+    {
+        for (int i = 0; i < n; i++)
+        {
+            ax[i] = dx0;
+            ay[i] = dy0;
+        }
+        int moved = fleet_step(map, ships, ax, ay, n);
+        fprintf(stderr, "%d de %d barcos movidos hacia %s.\n", moved, n, dir);
+    }
+
+    free(ships);
+    free(ax);
+    free(ay);
+    return 0;
+}
+
+/**
+ * @brief Orden "sea": une las instantáneas del estado del mar de cada Ursula (una sola fuera de una federación),
+ * sin interrumpir a ninguna.
+ */
+void sea_report(void)
+{
+    WorldState* snapshot = malloc(sizeof(WorldState));
+    int regions = 0, ships = 0, captains = 0, treasury = 0, food = 0, gold = 0, backlog = 0;
+    unsigned int coalesced = 0;
+
+    for (int r = 0; r < region_count && snapshot; r++)
+    {
+        if (!sea[r]) sea[r] = world_attach(region_fifo[r]);
+        if (!sea[r]) continue;
+        if (world_snapshot(sea[r], snapshot) != 0)
+        {
+            fprintf(stderr, "No se pudo obtener una instantánea consistente del mar de %s.\n", region_fifo[r]);
+            continue;
+        }
+        regions++;
+        for (int i = 0; i < WORLD_MAX_SHIPS; i++)
+        {
+            WorldShip* s = &snapshot->ships[i];
+            if (!s->active) continue;
+            ShipRecord* own = fleet_find_pid(&fleet, s->pid);
+            fprintf(stderr, "PID %d en (%d, %d) Comida: %d Oro: %d%s\n", s->pid, s->x, s->y, s->food, s->gold,
+                    own ? " (propio)" : "");
+        }
+        ships += snapshot->ship_count;
+        if (snapshot->captain_count > captains) captains = snapshot->captain_count; // Cada capitán está en todas las regiones
+        treasury = snapshot->treasury;                                              // El tesoro es común a la federación
+        food += snapshot->food_at_sea;
+        gold += snapshot->gold_at_sea;
+        backlog += snapshot->backlog;
+        coalesced += snapshot->coalesced;
+    }
+    free(snapshot);
+
+    if (regions == 0)
     {
-        fprintf(ursula_pipe, "%d,END_CAPT\n", my_pid);
-        fflush(ursula_pipe);
-        fclose(ursula_pipe);
+        fprintf(stderr, "Ursula no está publicando el estado del mar.\n");
+        return;
     }
+    fprintf(stderr, "Barcos en el mar: %d, Capitanes: %d, Tesoro de Ursula: %d\n", ships, captains, treasury);
+    fprintf(stderr, "A bordo de todos los barcos: %d de comida, %d de oro\n", food, gold);
+    fprintf(stderr, "Atraso de Ursula: %d eventos en la última pasada, %u movimientos agrupados\n", backlog, coalesced);
+    if (region_count > 1) fprintf(stderr, "Regiones que publican su estado: %d de %d\n", regions, region_count);
+}
+
+// Fila de la respuesta a una consulta: un barco, o los agregados de who (RADIUS, RECT, KNN, TOP / STATS, CAPTAIN)
+typedef struct
+{
+    char who[16];
+    int pid, x, y, food, gold;
+    long t_ships, t_food, t_gold, t_banked;
+    long long dist2;
+} QueryRow;
+
+static int compare_dist(const void* a, const void* b)
+{
+    const QueryRow *ra = a, *rb = b;
+    if (ra->dist2 != rb->dist2) return ra->dist2 < rb->dist2 ? -1 : 1;
+    return ra->pid - rb->pid;
+}
+
+static int compare_gold(const void* a, const void* b)
+{
+    const QueryRow *ra = a, *rb = b;
+    if (ra->gold != rb->gold) return rb->gold - ra->gold;
+    return ra->pid - rb->pid;
+}
+
+/**
+ * @brief Orden "query": envía la consulta al servicio de cada Ursula (ver ursula.h) y une las respuestas.
+ * Los barcos de RADIUS y RECT se concatenan; los de KNN y TOP se reordenan y se quedan los k primeros (cada región
+ * devuelve sus k mejores, así que los k mejores del mar están entre ellos). Los agregados se suman por capitán.
+ * @param request Consulta, sin el "query" inicial.
+ */
+void query_report(const char* request)
+{
+    char kind[16] = "";
+    long qx = 0, qy = 0, qk = 0;
+    int fields = sscanf(request, "%15s %ld %ld %ld", kind, &qx, &qy, &qk);
+    int aggregates = strcasecmp(kind, "stats") == 0 || strcasecmp(kind, "captain") == 0;
+    int knn = strcasecmp(kind, "knn") == 0 && fields == 4;
+    int top = strcasecmp(kind, "top") == 0 && fields >= 2;
+    if (top) qk = qx;
+
+    QueryRow* rows = NULL;
+    int count = 0, capacity = 0, answered = 0, reachable = 0;
+    char error[256] = "";
+    char* line = NULL;
+    size_t len = 0;
+
+    for (int r = 0; r < region_count; r++)
+    {
+        if (!query_stream[r])
+        {
+            int fd = ursula_query_open(region_fifo[r]);
+            if (fd != -1) query_stream[r] = fdopen(fd, "r+");
+            if (fd != -1 && !query_stream[r]) close(fd);
+        }
+        FILE* stream = query_stream[r];
+        if (!stream) continue;
+        reachable++;
+
+        int n = -1;
+        if (fprintf(stream, "%s\n", request) < 0 || fflush(stream) != 0 || getline(&line, &len, stream) <= 0)
+        {
+            fprintf(stderr, "Se perdió la conexión con el servicio de consultas de %s.\n", region_fifo[r]);
+            fclose(stream);
+            query_stream[r] = NULL;
+            continue;
+        }
+        if (sscanf(line, "%d", &n) != 1)
+        {
+            // Una región puede no conocer al capitán de CAPTAIN: el error sólo cuenta si ninguna responde
+            if (!error[0]) snprintf(error, sizeof(error), "%s", line);
+            continue;
+        }
+        answered++;
+
+        for (int i = 0; i < n; i++)
+        {
+            if (getline(&line, &len, stream) <= 0) break;
+            QueryRow row;
+            memset(&row, 0, sizeof(row));
+            if (aggregates)
+            {
+                // Fila de agregados: "<quién>,<barcos>,<comida>,<oro>,<en puerto>" (quién: * o PID del capitán)
+                if (sscanf(line, "%15[^,],%ld,%ld,%ld,%ld", row.who, &row.t_ships, &row.t_food, &row.t_gold,
+                           &row.t_banked) != 5)
+                {
+                    continue;
+                }
+                int k = 0;
+                while (k < count && strcmp(rows[k].who, row.who) != 0) k++;
+                if (k < count)
+                {
+                    rows[k].t_ships += row.t_ships;
+                    rows[k].t_food += row.t_food;
+                    rows[k].t_gold += row.t_gold;
+                    rows[k].t_banked += row.t_banked;
+                    continue;
+                }
+            }
+            else
+            {
+                if (sscanf(line, "%d,%d,%d,%d,%d", &row.pid, &row.x, &row.y, &row.food, &row.gold) != 5) continue;
+                long long ddx = (long long)row.x - qx, ddy = (long long)row.y - qy;
+                row.dist2 = ddx * ddx + ddy * ddy;
+            }
+            if (count == capacity)
+            {
+                int grown = capacity ? capacity * 2 : 64;
+                QueryRow* more = realloc(rows, grown * sizeof(QueryRow));
+                if (!more) break;
+                rows = more;
+                capacity = grown;
+            }
+            rows[count++] = row;
+        }
+    }
+
+    if (reachable == 0)
+    {
+        fprintf(stderr, "Ursula no atiende consultas espaciales.\n");
+    }
+    else if (answered == 0)
+    {
+        if (error[0]) fprintf(stderr, "Ursula: %s", error);
+    }
+    else if (aggregates)
+    {
+        for (int i = 0; i < count; i++)
+        {
+            int sea_row = strcmp(rows[i].who, "*") == 0;
+            fprintf(stderr, "%s%s: %ld barcos, Comida: %ld Oro: %ld, Oro en puerto: %ld%s\n",
+                    sea_row ? "Todo el mar" : "Capitán ", sea_row ? "" : rows[i].who, rows[i].t_ships, rows[i].t_food,
+                    rows[i].t_gold, rows[i].t_banked, atoi(rows[i].who) == my_pid ? " (propio)" : "");
+        }
+    }
+    else
+    {
+        if (region_count > 1 && (knn || top))
+        {
+            qsort(rows, count, sizeof(QueryRow), knn ? compare_dist : compare_gold);
+            if (qk >= 0 && count > qk) count = (int)qk;
+        }
+        for (int i = 0; i < count; i++)
+        {
+            ShipRecord* own = fleet_find_pid(&fleet, rows[i].pid);
+            fprintf(stderr, "PID %d en (%d, %d) Comida: %d Oro: %d%s\n", rows[i].pid, rows[i].x, rows[i].y,
+                    rows[i].food, rows[i].gold, own ? " (propio)" : "");
+        }
+        fprintf(stderr, "%d barcos encontrados.\n", count);
+    }
+    free(rows);
+    free(line);
 }
 
 int main(int argc, char* argv[])
@@ -143,6 +790,14 @@ int main(int argc, char* argv[])
     char* ship_path = "./ship";
     char* ursula_fifo = NULL; // Ruta al pipe de Ursula
     int random_mode = 0;
+    int use_rings = 0; // Comandos por anillos en memoria compartida en vez de tuberías
+    int clock_ms = 0; // Duración del tic del reloj de la flota en modo aleatorio (0 = un alarm() por barco)
+    static CpuList ship_cpus; // CPUs entre las que se reparten los barcos (vacía = sin afinidad)
+    int ship_nice = 0; // Prioridad nice de los barcos
+    int ship_batch = 0; // Barcos en SCHED_BATCH
+    char* cgroup_parent = NULL; // cgroup (v2) bajo el que se crea el de la flota
+    int cpu_weight = 100; // Peso de CPU del cgroup de la flota
+    int launched = 0; // Barcos lanzados, para repartirlos por ship_cpus
 
     for (int i = 1; i < argc; i++)
     {
@@ -186,6 +841,64 @@ int main(int argc, char* argv[])
         {
             random_mode = 1;
         }
+        else if (strcasecmp(argv[i], "--rings") == 0)
+        {
+            use_rings = 1;
+        }
+        else if (strcasecmp(argv[i], "--clock") == 0)
+        {
+            char* end = NULL;
+            long v = i + 1 < argc ? strtol(argv[++i], &end, 10) : 0;
+            if (!end || *end != '\0' || v <= 0 || v > 60000)
+            {
+                fprintf(stderr, "Error: --clock requiere la duración del tic en ms (1-60000).\n");
+                return EXIT_FAILURE;
+            }
+            clock_ms = (int)v;
+        }
+        else if (strcasecmp(argv[i], "--ship-cpus") == 0)
+        {
+            if (i + 1 >= argc || placement_parse_cpus(argv[++i], &ship_cpus) != 0)
+            {
+                fprintf(stderr, "Error: --ship-cpus requiere una lista de CPUs (p.ej. 2-7,10).\n");
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcasecmp(argv[i], "--ship-nice") == 0)
+        {
+            char* end = NULL;
+            long v = i + 1 < argc ? strtol(argv[++i], &end, 10) : 0;
+            if (!end || *end != '\0' || v < -20 || v > 19)
+            {
+                fprintf(stderr, "Error: --ship-nice requiere un valor entre -20 y 19.\n");
+                return EXIT_FAILURE;
+            }
+            ship_nice = (int)v;
+        }
+        else if (strcasecmp(argv[i], "--batch") == 0)
+        {
+            ship_batch = 1;
+        }
+        else if (strcasecmp(argv[i], "--cgroup") == 0)
+        {
+            if (i + 1 < argc) cgroup_parent = argv[++i];
+            else
+            {
+                fprintf(stderr, "Error: --cgroup requiere la ruta de un cgroup (p.ej. /sys/fs/cgroup/mar).\n");
+                return EXIT_FAILURE;
+            }
+        }
+        else if (strcasecmp(argv[i], "--cpu-weight") == 0)
+        {
+            char* end = NULL;
+            long v = i + 1 < argc ? strtol(argv[++i], &end, 10) : 0;
+            if (!end || *end != '\0' || v < 1 || v > 10000)
+            {
+                fprintf(stderr, "Error: --cpu-weight requiere un valor entre 1 y 10000.\n");
+                return EXIT_FAILURE;
+            }
+            cpu_weight = (int)v;
+        }
         else if (strcasecmp(argv[i], "--ursula") == 0 && i + 1 < argc) ursula_fifo = argv[++i]; // Parsear arg Ursula
 
     }
@@ -210,27 +923,28 @@ int main(int argc, char* argv[])
     }
 
 
-    // Inicializar array de barcos
-    for (int i = 0; i < 100; i++)
+    // Inicializar registro de barcos
+    if (fleet_init(&fleet) != 0)
     {
-        launched_ships[i].pid = 0;
-        launched_ships[i].active = 0;
-        launched_ships[i].read_stream = NULL;
+        perror("Error reservando el registro de la flota");
+        return EXIT_FAILURE;
     }
 
+    // SIGCHLD queda bloqueada salvo mientras esperamos (sigsuspend o lectura de comandos), para que
+    // handle_sigchld nunca modifique el registro a medias de una operación del bucle principal.
+    sigemptyset(&sigchld_mask);
+    sigaddset(&sigchld_mask, SIGCHLD);
+    sigprocmask(SIG_BLOCK, &sigchld_mask, &wait_mask);
+
     fprintf(stderr, "Nombre del Capitán: %s PID: %d\n", name, my_pid);
 
     // Conectar a Ursula si se solicitó
     if (ursula_fifo)
     {
-        ursula_pipe = fopen(ursula_fifo, "w");
-        if (ursula_pipe)
+        if (ursula_connect(&ursula_link, ursula_fifo) == 0)
         {
-            // fprintf escribe el mensaje en el pipe directamente
-            fprintf(ursula_pipe, "%d,INIT_CAPT\n", my_pid);
-            // fflush: Fuerza a tomar lo que está actualmente en el buffer y escribirlo inmediatamente
-            // en el pipe.
-            fflush(ursula_pipe);
+            UrsulaEvent ev = {URSULA_INIT_CAPT, my_pid, 0, 0, 0, 0, 0};
+            ursula_send(&ursula_link, &ev);
             // Registrar la limpieza para enviar FIN_CAPT a la salida
             atexit(cleanup_ursula);
         }
@@ -238,6 +952,14 @@ int main(int argc, char* argv[])
         {
             perror("Fallo al abrir la tubería hacia Ursula");
         }
+
+        // En una federación, "sea" y "query" preguntan a la Ursula de cada región
+        UrsulaFederation* federation = ursula_link.federation;
+        region_count = federation ? federation->count : 1;
+        for (int r = 0; r < region_count; r++)
+        {
+            snprintf(region_fifo[r], sizeof(region_fifo[r]), "%s", federation ? federation->regions[r].fifo : ursula_fifo);
+        }
     }
 
     Map* map = map_load(map_file);
@@ -255,6 +977,34 @@ int main(int argc, char* argv[])
         return EXIT_FAILURE;
     }
 
+    // cgroup propio de la flota: los barcos entran en él antes de exec
+    if (cgroup_parent)
+    {
+        if (placement_cgroup_create(cgroup_parent, cpu_weight, fleet_cgroup, sizeof(fleet_cgroup)) == 0)
+        {
+            atexit(cleanup_cgroup);
+            fprintf(stderr, "[Capitán] Flota en el cgroup %s (cpu.weight %d)\n", fleet_cgroup, cpu_weight);
+        }
+        else
+        {
+            perror("Error creando el cgroup de la flota, los barcos se quedan en el del capitán");
+            fleet_cgroup[0] = '\0';
+        }
+    }
+
+    // Reloj común de la flota (sólo en modo aleatorio): los barcos lo heredan y esperan en él su turno
+    int clock_fd = -1;
+    TickWheel* wheel = NULL;
+    if (clock_ms > 0 && !random_mode)
+    {
+        fprintf(stderr, "--clock sólo tiene efecto con --random, se ignora.\n");
+    }
+    else if (clock_ms > 0)
+    {
+        wheel = wheel_create(&clock_fd);
+        if (!wheel) perror("Error creando el reloj de la flota, cada barco usará su alarm()");
+    }
+
     int id, x, y, speed;
     char* line = NULL;
     size_t len = 0;
@@ -270,7 +1020,16 @@ int main(int argc, char* argv[])
 
         if (sscanf(line, "%d (%d,%d) %d", &id, &x, &y, &speed) == 4)
         {
+            if (fleet_find_id(&fleet, id))
+            {
+                fprintf(stderr, "Barco ID %d duplicado en %s, se ignora.\n", id, ships_file);
+                continue;
+            }
             fprintf(stderr, "Lanzando Barco ID: %d, Posición: (%d, %d)\n", id, x, y);
+            if (map_component_ports(map, map_component(map, x, y)) == 0)
+            {
+                fprintf(stderr, "Aviso: desde (%d, %d) no se puede llegar a ningún puerto.\n", x, y);
+            }
 
             // Crear pipes
             int p_to_s[2]; // Escribir al barco
@@ -281,10 +1040,34 @@ int main(int argc, char* argv[])
                 continue;
             }
 
+            // Canal en memoria compartida (sólo en modo capitán): el barco hereda el memfd a través de exec
+            int ring_fd = -1;
+            ShipChannel* channel = NULL;
+            if (use_rings && !random_mode)
+            {
+                channel = ring_channel_create(&ring_fd);
+                if (!channel) perror("Error creando el canal en memoria compartida, se usan las tuberías");
+            }
+
+            // Página de telemetría: el barco la hereda igual que el canal
+            int telemetry_fd = -1;
+            ShipTelemetry* telemetry = telemetry_create(&telemetry_fd);
+            if (!telemetry) perror("Error creando la página de telemetría, status usará SIGTSTP");
+
             pid_t pid = fork();
             if (pid < 0)
             {
                 perror("fallo en fork");
+                if (channel)
+                {
+                    ring_channel_destroy(channel);
+                    close(ring_fd);
+                }
+                if (telemetry)
+                {
+                    telemetry_destroy(telemetry);
+                    close(telemetry_fd);
+                }
                 continue;
             }
 
@@ -306,85 +1089,177 @@ int main(int argc, char* argv[])
                 // Debemos cerrar estos pipes aquí. Si no lo hacemos,
                 // los barcos anteriores nunca recibirán señales de EOF (terminación)
                 // porque este nuevo hijo está manteniendo accidentalmente sus pipes abiertos.
-                for (int i = 0; i < 100; i++)
+                for (int i = 0; i < fleet_count(&fleet); i++)
                 {
-                    if (launched_ships[i].active)
-                    {
-                        close(launched_ships[i].pipe_to_ship[1]);
-                        close(launched_ships[i].pipe_from_ship[0]);
-                    }
+                    close(fleet_at(&fleet, i)->pipe_to_ship[1]);
+                    close(fleet_at(&fleet, i)->pipe_from_ship[0]);
                 }
 
-                // Cerrar pipe de Ursula en el hijo (el hijo abrirá su propia conexión)
-                if (ursula_pipe) fclose(ursula_pipe);
+                // Cerrar la conexión con Ursula en el hijo (el hijo abrirá la suya)
+                ursula_disconnect(&ursula_link);
+
+                // Unirse al grupo de la flota (el primer barco lo crea). El padre hace lo mismo para no depender
+                // de quién se ejecute antes; si el grupo ya quedó vacío, este barco abre uno nuevo.
+                if (setpgid(0, fleet_pgid) == -1) setpgid(0, 0);
+
+                // Ubicación del barco: afinidad, clase de planificación, prioridad y cgroup se heredan a través de exec
+                if (ship_cpus.count > 0 && placement_pin_one(0, &ship_cpus, launched) == -1)
+                {
+                    perror("Error fijando la CPU del barco");
+                }
+                if (ship_batch && placement_batch() == -1) perror("Error pasando el barco a SCHED_BATCH");
+                if (ship_nice != 0 && setpriority(PRIO_PROCESS, 0, ship_nice) == -1)
+                {
+                    perror("Error cambiando la prioridad del barco");
+                }
+                if (fleet_cgroup[0] && placement_cgroup_attach(fleet_cgroup, getpid()) == -1)
+                {
+                    perror("Error moviendo el barco al cgroup de la flota");
+                }
 
                 // Señales por defecto
                 signal(SIGINT, SIG_DFL);
                 signal(SIGCHLD, SIG_DFL);
+                // La máscara de señales se hereda a través de exec
+                sigprocmask(SIG_SETMASK, &wait_mask, NULL);
 
-                char x_str[12], y_str[12], speed_str[12];
+                char x_str[12], y_str[12], speed_str[12], fd_str[12], telemetry_str[12], clock_str[12];
                 // Convertir enteros a strings para los argumentos de exec
                 snprintf(x_str, sizeof(x_str), "%d", x);
                 snprintf(y_str, sizeof(y_str), "%d", y);
                 snprintf(speed_str, sizeof(speed_str), "%d", speed);
+                snprintf(fd_str, sizeof(fd_str), "%d", ring_fd);
+                snprintf(telemetry_str, sizeof(telemetry_str), "%d", telemetry_fd);
+                snprintf(clock_str, sizeof(clock_str), "%d", clock_fd);
 
-                // Propagar el arg --ursula al barco
+                char* args[20];
+                int n_args = 0;
+                args[n_args++] = "ship";
+                args[n_args++] = "--pos";
+                args[n_args++] = x_str;
+                args[n_args++] = y_str;
                 if (random_mode)
                 {
-                    if (ursula_fifo)
-                        execl(ship_path, "ship", "--pos", x_str, y_str, "--random", "10", speed_str, "--map", map_file, "--ursula", ursula_fifo, NULL);
-                    else
-                        execl(ship_path, "ship", "--pos", x_str, y_str, "--random", "10", speed_str, "--map", map_file, NULL);
+                    args[n_args++] = "--random";
+                    args[n_args++] = "10";
+                    args[n_args++] = speed_str;
                 }
                 else
                 {
-                    if (ursula_fifo)
-                        execl(ship_path, "ship", "--pos", x_str, y_str, "--captain", "--map", map_file, "--ursula", ursula_fifo, NULL);
-                    else
-                        execl(ship_path, "ship", "--pos", x_str, y_str, "--captain", "--map", map_file, NULL);
+                    args[n_args++] = "--captain";
+                }
+                args[n_args++] = "--map";
+                args[n_args++] = map_file;
+                // Propagar el arg --ursula al barco
+                if (ursula_fifo)
+                {
+                    args[n_args++] = "--ursula";
+                    args[n_args++] = ursula_fifo;
                 }
+                if (channel)
+                {
+                    args[n_args++] = "--ring-fd";
+                    args[n_args++] = fd_str;
+                }
+                if (telemetry)
+                {
+                    args[n_args++] = "--telemetry-fd";
+                    args[n_args++] = telemetry_str;
+                }
+                if (wheel)
+                {
+                    args[n_args++] = "--clock-fd";
+                    args[n_args++] = clock_str;
+                }
+                args[n_args] = NULL;
+
+                execv(ship_path, args);
 
-                perror("fallo en execl");
-                exit(EXIT_FAILURE);
+                perror("fallo en execv");
+                // _exit: los manejadores atexit son del capitán (retirarían el cgroup de la flota entera)
+                _exit(EXIT_FAILURE);
             }
             else // Proceso Padre
             {
+                launched++;
                 // Cerrar extremo de lectura del pipe de escritura
                 close(p_to_s[0]);
                 // Cerrar extremo de escritura del pipe de lectura
                 close(p_from_s[1]);
+                // El memfd ya lo tiene el hijo; la proyección del padre lo mantiene vivo
+                if (channel) close(ring_fd);
+                if (telemetry) close(telemetry_fd);
+
+                if (fleet_pgid == 0 || (setpgid(pid, fleet_pgid) == -1 && errno == EPERM)) setpgid(pid, pid);
+                pid_t pgid = getpgid(pid);
+                if (pgid > 0 && pgid != getpgrp()) fleet_pgid = pgid;
+
+                // El hijo no se ha recolectado todavía, así que el pidfd no puede referirse a otro proceso
+                int pidfd = (int)syscall(SYS_pidfd_open, pid, 0);
+
+                // handle_sigint recorre la lista de barcos vivos: no puede verla a medio crecer
+                sigset_t add_mask;
+                sigemptyset(&add_mask);
+                sigaddset(&add_mask, SIGINT);
+                sigprocmask(SIG_BLOCK, &add_mask, NULL);
+                ShipRecord* ship = fleet_add(&fleet, id, pid, x, y);
+                sigprocmask(SIG_UNBLOCK, &add_mask, NULL);
 
-                int placed = 0;
-                for (int i = 0; i < 100; i++)
+                if (ship)
                 {
-                    if (launched_ships[i].pid == 0)
-                    {
-                        launched_ships[i].id = id;
-                        launched_ships[i].pid = pid;
-                        launched_ships[i].x = x;
-                        launched_ships[i].y = y;
-                        launched_ships[i].pipe_to_ship[1] = p_to_s[1];
-                        launched_ships[i].pipe_from_ship[0] = p_from_s[0];
-                        launched_ships[i].read_stream = fdopen(p_from_s[0], "r");
-                        launched_ships[i].active = 1;
-                        placed = 1;
-                        break;
-                    }
+                    ship->pipe_to_ship[1] = p_to_s[1];
+                    ship->pipe_from_ship[0] = p_from_s[0];
+                    ship->read_stream = fdopen(p_from_s[0], "r");
+                    ship->channel = channel;
+                    ship->pidfd = pidfd;
+                    ship->telemetry = telemetry;
+                }
+                else
+                {
+                    // Sin registro no podríamos controlarlo: lo retiramos enseguida
+                    perror("Error registrando el barco");
+                    kill(pid, SIGQUIT);
+                    close(p_to_s[1]);
+                    close(p_from_s[0]);
+                    ring_channel_destroy(channel);
+                    if (pidfd != -1) close(pidfd);
+                    telemetry_destroy(telemetry);
                 }
-                if (placed) ships_count++;
             }
         }
     }
 
     free(line);
     fclose(file);
+    // Todos los barcos tienen ya su copia del reloj
+    if (wheel) close(clock_fd);
 
-    if (random_mode)
+    if (wheel)
+    {
+        fprintf(stderr, "[Capitán] Marcando el reloj de la flota cada %d ms (Modo Aleatorio)...\n", clock_ms);
+        // Plazos absolutos: el tiempo de despertar a los barcos no se acumula como deriva
+        int64_t next_tick = telemetry_now_ms() + clock_ms;
+        while (fleet_count(&fleet) > 0)
+        {
+            int64_t left = next_tick - telemetry_now_ms();
+            if (left > 0)
+            {
+                // Como sigsuspend, pero con plazo: SIGCHLD sólo se atiende mientras esperamos
+                struct timespec ts = {left / 1000, (left % 1000) * 1000000L};
+                pselect(0, NULL, NULL, NULL, &ts, &wait_mask);
+                continue;
+            }
+            wheel_advance(wheel);
+            next_tick += clock_ms;
+        }
+        wheel_destroy(wheel);
+    }
+    else if (random_mode)
     {
         fprintf(stderr, "[Capitán] Esperando a que los barcos terminen (Modo Aleatorio)...\n");
-        while (ships_count > 0)
+        while (fleet_count(&fleet) > 0)
         {
-            pause();
+            sigsuspend(&wait_mask);
         }
     }
     else
@@ -395,16 +1270,22 @@ int main(int argc, char* argv[])
         char* resp_line = NULL;
         size_t resp_len = 0;
 
-        while (ships_count > 0)
+        while (fleet_count(&fleet) > 0)
         {
             // Prompt to stderr
-            fprintf(stderr, "Introduce command [exit | status | <id> up/down/right/left]: ");
+            fprintf(stderr, "Introduce command [exit | status | pause | resume | nice <n> | all <dir> | group <a>-<b> <dir>|goto <x> <y> | formation line|column | sea | near <x> <y> <r> | query radius|rect|knn|top|stats|captain ... | <id> up/down/right/left]: ");
+
+            // Sólo mientras esperamos al usuario dejamos que handle_sigchld dé de baja barcos
+            sigprocmask(SIG_SETMASK, &wait_mask, NULL);
+            ssize_t cmd_read = getline(&cmd_line, &cmd_len, stdin);
+            int cmd_errno = errno;
+            sigprocmask(SIG_BLOCK, &sigchld_mask, NULL);
 
-            if (getline(&cmd_line, &cmd_len, stdin) == -1)
+            if (cmd_read == -1)
             {
-                if (errno == EINTR) {
+                if (cmd_errno == EINTR) {
                     clearerr(stdin);
-                    continue; // Un barco murió, el bucle reevaluará ships_count > 0
+                    continue; // Un barco murió, el bucle reevaluará fleet_count > 0
                 }
             }
 
@@ -414,47 +1295,131 @@ int main(int argc, char* argv[])
             if (strcasecmp(cmd_line, "exit") == 0)
             {
                 fprintf(stderr, "Saliendo y terminando todos los barcos.\n");
-                for (int i = 0; i < 100; i++)
+                fleet_teardown();
+                break;
+            }
+            else if (strcasecmp(cmd_line, "pause") == 0 || strcasecmp(cmd_line, "resume") == 0)
+            {
+                int pause = strcasecmp(cmd_line, "pause") == 0;
+                if (fleet_signal(pause ? SIGSTOP : SIGCONT) == 0)
                 {
-                    if (launched_ships[i].active)
-                    {
-                        kill(launched_ships[i].pid, SIGQUIT);
-                    }
+                    fleet_paused = pause;
+                    fprintf(stderr, pause ? "Flota detenida.\n" : "Flota en marcha.\n");
                 }
-                while (ships_count > 0)
+                else
                 {
-                    pause();
+                    perror("Error enviando la orden a la flota");
                 }
-                break;
+            }
+            else if (strncasecmp(cmd_line, "nice", 4) == 0)
+            {
+                int value;
+                if (sscanf(cmd_line + 4, "%d", &value) != 1)
+                {
+                    fprintf(stderr, "Uso: nice <valor entre -20 y 19>\n");
+                }
+                else if (fleet_pgid <= 0 || setpriority(PRIO_PGRP, fleet_pgid, value) == -1)
+                {
+                    perror("Error cambiando la prioridad de la flota");
+                }
+                else
+                {
+                    fprintf(stderr, "Prioridad de la flota: %d\n", value);
+                }
+            }
+            else if (fleet_paused && ((strcasecmp(cmd_line, "status") == 0 && fleet_needs_polling()) || isdigit((unsigned char)cmd_line[0]) ||
+                                      strncasecmp(cmd_line, "all", 3) == 0 || strncasecmp(cmd_line, "group", 5) == 0 ||
+                                      strncasecmp(cmd_line, "formation", 9) == 0))
+            {
+                // Un barco detenido no contestaría: los movimientos (y status sin telemetría) esperarían para siempre
+                fprintf(stderr, "La flota está detenida; use resume.\n");
             }
             else if (strcasecmp(cmd_line, "status") == 0)
             {
-                for (int i = 0; i < 100; i++)
+                int64_t now = telemetry_now_ms();
+                for (int i = 0; i < fleet_count(&fleet); i++)
                 {
-                    if (launched_ships[i].active)
+                    ShipRecord* ship = fleet_at(&fleet, i);
+                    ShipTelemetry t;
+
+                    // Lectura de la página del barco, sin interrumpirlo ni esperarlo
+                    if (ship->telemetry)
                     {
-                        kill(launched_ships[i].pid, SIGTSTP);
+                        telemetry_read(ship->telemetry, &t);
+                        if (t.pid == 0)
+                        {
+                            fprintf(stderr, "Barco %d (PID: %d) aún no ha publicado su estado.\n", ship->id, ship->pid);
+                            continue;
+                        }
+                        int64_t age = now - t.last_tick_ms;
+                        fprintf(stderr, "Barco %d vivo (PID: %d) Ubicación: (%d, %d) Comida: %d Oro: %d "
+                                "Movimientos: %u Rechazados: %u Último latido: hace %lld ms%s\n",
+                                ship->id, t.pid, t.x, t.y, t.food, t.gold, t.moves, t.rejected, (long long)age,
+                                age > TELEMETRY_STALE_MS ? " (sin actividad)" : "");
+                        continue;
+                    }
 
-                        ssize_t n = getline(&resp_line, &resp_len, launched_ships[i].read_stream);
+                    kill(ship->pid, SIGTSTP);
 
-                        if (n > 0)
+                    ssize_t n = getline(&resp_line, &resp_len, ship->read_stream);
+
+                    if (n > 0)
+                    {
+                        // Parsing status response from Ship
+                        int s_pid, s_x, s_y, s_food, s_gold;
+                        if (sscanf(resp_line, "PID de barco: %d, Ubicación: (%d, %d), Comida: %d, Oro: %d",
+                                   &s_pid, &s_x, &s_y, &s_food, &s_gold) == 5)
                         {
-                            // Parsing status response from Ship
-                            int s_pid, s_x, s_y, s_food, s_gold;
-                            if (sscanf(resp_line, "PID de barco: %d, Ubicación: (%d, %d), Comida: %d, Oro: %d",
-                                       &s_pid, &s_x, &s_y, &s_food, &s_gold) == 5)
-                            {
-                                fprintf(stderr, "Barco %d vivo (PID: %d) Ubicación: (%d, %d) Comida: %d Oro: %d\n",
-                                        launched_ships[i].id, s_pid, s_x, s_y, s_food, s_gold);
-                            }
-                            else
-                            {
-                                fprintf(stderr, "Estado del Barco %d: %s", launched_ships[i].id, resp_line);
-                            }
+                            fprintf(stderr, "Barco %d vivo (PID: %d) Ubicación: (%d, %d) Comida: %d Oro: %d\n",
+                                    ship->id, s_pid, s_x, s_y, s_food, s_gold);
+                        }
+                        else
+                        {
+                            fprintf(stderr, "Estado del Barco %d: %s", ship->id, resp_line);
                         }
                     }
                 }
-                fprintf(stderr, "Número de barcos vivos: %d\n", ships_count);
+                fprintf(stderr, "Número de barcos vivos: %d\n", fleet_count(&fleet));
+            }
+            else if (strcasecmp(cmd_line, "sea") == 0)
+            {
+                // Vista global de Ursula: todos los barcos de todos los capitanes, sin interrumpir a nadie
+                sea_report();
+            }
+            else if (strncasecmp(cmd_line, "query", 5) == 0)
+            {
+                // Consulta espacial a Ursula sobre todos los barcos del mar (ver ursula.h)
+                query_report(cmd_line + 5);
+            }
+            else if (strncasecmp(cmd_line, "all ", 4) == 0 || strncasecmp(cmd_line, "group ", 6) == 0 ||
+                     strncasecmp(cmd_line, "formation ", 10) == 0)
+            {
+                if (fleet_order(map, cmd_line) != 0)
+                {
+                    fprintf(stderr, "Uso: all <dir> | group <a>-<b> <dir> | group <a>-<b> goto <x> <y> | formation line|column\n");
+                }
+                fprintf(stderr, "Número de barcos vivos: %d\n", fleet_count(&fleet));
+            }
+            else if (strncasecmp(cmd_line, "near", 4) == 0)
+            {
+                // Barcos propios a distancia <= r de una celda, sin recorrer la flota
+                int qx, qy, qr;
+                if (sscanf(cmd_line + 4, "%d %d %d", &qx, &qy, &qr) == 3 && qr >= 0)
+                {
+                    ShipRecord* found[32];
+                    int n = fleet_query_radius(&fleet, qx, qy, qr, found, 32);
+                    for (int i = 0; i < n && i < 32; i++)
+                    {
+                        fprintf(stderr, "Barco %d (PID: %d) en (%d, %d)\n", found[i]->id, found[i]->pid,
+                                found[i]->x, found[i]->y);
+                    }
+                    if (n > 32) fprintf(stderr, "... y %d barcos más.\n", n - 32);
+                    fprintf(stderr, "%d barcos a distancia %d de (%d, %d).\n", n, qr, qx, qy);
+                }
+                else
+                {
+                    fprintf(stderr, "Uso: near <x> <y> <radio>\n");
+                }
             }
             else
             {
@@ -463,17 +1428,9 @@ int main(int argc, char* argv[])
                 char action[32];
                 if (sscanf(cmd_line, "%d %31s", &target_id, action) == 2)
                 {
-                    int found_idx = -1;
-                    for (int i = 0; i < 100; i++)
-                    {
-                        if (launched_ships[i].active && launched_ships[i].id == target_id)
-                        {
-                            found_idx = i;
-                            break;
-                        }
-                    }
+                    ShipRecord* target = fleet_find_id(&fleet, target_id);
 
-                    if (found_idx != -1)
+                    if (target)
                     {
                         if (strcasecmp(action, "exit") == 0)
                         {
@@ -481,7 +1438,8 @@ int main(int argc, char* argv[])
                             // La D de dprintf significa que escribe directamente en el descriptor.
                             // Esto está destinado a pipes anónimos, no se puede usar en Ursula ya que Ursula usa FIFOs
                             // (pipes con nombre)
-                            dprintf(launched_ships[found_idx].pipe_to_ship[1], "exit\n");
+                            if (target->channel) ring_command(target, RING_CMD_EXIT, 0, 0, NULL);
+                            else dprintf(target->pipe_to_ship[1], "exit\n");
                         }
                         else if (strcasecmp(action, "up") == 0 || strcasecmp(action, "down") == 0 ||
                             strcasecmp(action, "left") == 0 || strcasecmp(action, "right") == 0)
@@ -492,22 +1450,11 @@ int main(int argc, char* argv[])
                             if (strcasecmp(action, "left") == 0) dx = -1;
                             if (strcasecmp(action, "right") == 0) dx = 1;
 
-                            int new_x = launched_ships[found_idx].x + dx;
-                            int new_y = launched_ships[found_idx].y + dy;
+                            int new_x = target->x + dx;
+                            int new_y = target->y + dy;
 
-                            // Comprobar colisión con otros barcos
-                            int collision = 0;
-                            for (int i = 0; i < 100; i++)
-                            {
-                                if (launched_ships[i].active && launched_ships[i].id != target_id)
-                                {
-                                    if (launched_ships[i].x == new_x && launched_ships[i].y == new_y)
-                                    {
-                                        collision = 1;
-                                        break;
-                                    }
-                                }
-                            }
+                            // Comprobar colisión con otros barcos (tabla de ocupación, O(1))
+                            int collision = fleet_ship_at(&fleet, new_x, new_y) != NULL;
 
                             if (collision)
                             {
@@ -523,30 +1470,40 @@ int main(int argc, char* argv[])
                                 }
                                 else
                                 {
-                                    // Enviar Comando
-                                    dprintf(launched_ships[found_idx].pipe_to_ship[1], "%s\n", action);
-
-                                    // Esperar confirmación OK/NOK usando getline
-                                    ssize_t n = getline(&resp_line, &resp_len, launched_ships[found_idx].read_stream);
-
-                                    if (n > 0)
+                                    // Enviar Comando y esperar confirmación
+                                    int confirmed = -1; // -1 sin respuesta, 0 NOK, 1 OK
+                                    if (target->channel)
                                     {
-                                        // Recortar salto de línea
-                                        resp_line[strcspn(resp_line, "\n")] = 0;
-                                        if (strcmp(resp_line, "OK") == 0)
-                                        {
-                                            // Actualizar posición SOLO si es confirmado
-                                            launched_ships[found_idx].x = new_x;
-                                            launched_ships[found_idx].y = new_y;
-                                            fprintf(stderr, "Barco %d movido hacia %s a (%d, %d)\n", target_id, action, new_x,
-                                                    new_y);
-                                        }
-                                        else
+                                        RingRecord ack;
+                                        if (ring_command(target, RING_CMD_MOVE, dx, dy, &ack) == 0)
+                                            confirmed = ack.op == RING_ACK_OK;
+                                    }
+                                    else
+                                    {
+                                        dprintf(target->pipe_to_ship[1], "%s\n", action);
+
+                                        // Esperar confirmación OK/NOK usando getline
+                                        ssize_t n = getline(&resp_line, &resp_len, target->read_stream);
+                                        if (n > 0)
                                         {
-                                            fprintf(stderr, "Barco %d rechazó el movimiento\n",
-                                                    target_id);
+                                            // Recortar salto de línea
+                                            resp_line[strcspn(resp_line, "\n")] = 0;
+                                            confirmed = strcmp(resp_line, "OK") == 0;
                                         }
                                     }
+
+                                    if (confirmed == 1)
+                                    {
+                                        // Actualizar posición SOLO si es confirmado
+                                        fleet_move(&fleet, target, new_x, new_y);
+                                        fprintf(stderr, "Barco %d movido hacia %s a (%d, %d)\n", target_id, action, new_x,
+                                                new_y);
+                                    }
+                                    else if (confirmed == 0)
+                                    {
+                                        fprintf(stderr, "Barco %d rechazó el movimiento\n",
+                                                target_id);
+                                    }
                                 }
                             }
                         }
@@ -559,7 +1516,7 @@ int main(int argc, char* argv[])
                     {
                         fprintf(stderr, "Barco %d no encontrado o no está vivo.\n", target_id);
                     }
-                    fprintf(stderr, "Número de barcos vivos: %d\n", ships_count);
+                    fprintf(stderr, "Número de barcos vivos: %d\n", fleet_count(&fleet));
                 }
             }
         }
@@ -568,12 +1525,18 @@ int main(int argc, char* argv[])
     }
 
     fprintf(stderr, "[Capitán] Esperando a que los barcos terminen...\n");
-    while (ships_count > 0)
+    while (fleet_count(&fleet) > 0)
     {
-        pause();
+        sigsuspend(&wait_mask);
     }
 
     fprintf(stderr, "[Capitán] Todos los barcos han regresado. Terminando ejecución.\n");
     map_destroy(map);
+    fleet_destroy(&fleet);
+    for (int r = 0; r < region_count; r++)
+    {
+        world_detach(sea[r]);
+        if (query_stream[r]) fclose(query_stream[r]);
+    }
     return EXIT_SUCCESS;
 }
\ No newline at end of file
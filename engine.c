@@ -0,0 +1,708 @@
+#include <stdlib.h>
+#include <string.h>
+#include "engine.h"
+#include "grid.h"
+
+#define SHIP_WORDS ((ENGINE_MAX_SHIPS + 63) / 64)
+#define SHIP_SLOTS (SHIP_WORDS * 64)     // Ranuras de los arrays, redondeadas a bloques completos del mapa de bits
+#define QUERY_LIMIT (1L << 24)          // Cota de los números de una consulta: mayor que cualquier mar, pid o k útil
+
+// Tabla de barcos como estructura de arrays: cada recorrido lee sólo los campos que usa, en bloques contiguos
+// que el compilador puede vectorizar, y las ranuras libres se saltan de 64 en 64 con el mapa de bits.
+typedef struct {
+    uint64_t active[SHIP_WORDS];        // Bit i: ranura i ocupada (los bits de relleno nunca se activan)
+    int32_t pid[SHIP_SLOTS];
+    int32_t x[SHIP_SLOTS];
+    int32_t y[SHIP_SLOTS];
+    int32_t food[SHIP_SLOTS];
+    int32_t gold[SHIP_SLOTS];
+    int32_t owner[SHIP_SLOTS];          // Ranura del capitán dueño en la tabla de capitanes, -1 si no tiene
+} ShipTable;
+
+typedef struct {
+    int pid;
+    int active;
+} CaptainInfo;
+
+// Barco con su celda empaquetada en una sola clave: x en la parte alta, y en la baja (con el signo invertido
+// para que el orden sin signo de la clave sea el orden (x, y) con signo)
+typedef struct {
+    uint64_t cell;
+    int slot;
+} CellKey;
+
+struct Engine {
+    ShipTable ships;
+    CaptainInfo captains[ENGINE_MAX_CAPTAINS];
+    int captain_count;
+    int ever_had_captains;
+    int treasury;
+    Ledger *ledger;                     // Libro del tesoro común de una federación (NULL: el tesoro es local)
+    int account;                        // Cuenta de este motor en el libro
+    WorldState *world;                  // Estado compartido donde se publica cada cambio (NULL: no se publica)
+    Grid grid;                          // Índice espacial de los barcos activos, por ranura
+    SeaStats stats;                     // Agregados del mar y por capitán, y ranking por oro
+    int turns;                          // Combate por turnos: los MOVE sólo se anotan y engine_tick los resuelve
+    unsigned char moved[ENGINE_MAX_SHIPS];
+    unsigned int seed;                  // Generador propio: los combates se repiten con la misma semilla
+    int bankrupt;
+    EngineEvent *events;                // Eventos de salida pendientes de consumir
+    int event_count;
+    int event_capacity;
+    CellKey keys[ENGINE_MAX_SHIPS];     // Espacio de trabajo de engine_tick
+    int order[ENGINE_MAX_SHIPS];
+};
+
+// Operaciones del tesoro: locales, o sobre el libro común de la federación
+
+int engine_treasury(const Engine *e) {
+    return e->ledger ? ledger_balance(e->ledger) : e->treasury;
+}
+
+static void treasury_deposit(Engine *e, int amount) {
+    if (e->ledger) ledger_deposit(e->ledger, e->account, amount);
+    else e->treasury += amount;
+}
+
+/** @return 0 si el tesoro cubría amount y se ha retirado, -1 si no alcanza (no se retira nada). */
+static int treasury_withdraw(Engine *e, int amount) {
+    if (e->ledger) return ledger_withdraw(e->ledger, e->account, amount);
+    if (e->treasury < amount) return -1;
+    e->treasury -= amount;
+    return 0;
+}
+
+static inline int ship_active(const Engine *e, int idx) {
+    return (int)((e->ships.active[idx >> 6] >> (idx & 63)) & 1);
+}
+
+static inline void ship_set_active(Engine *e, int idx, int on) {
+    if (on) e->ships.active[idx >> 6] |= 1ull << (idx & 63);
+    else e->ships.active[idx >> 6] &= ~(1ull << (idx & 63));
+}
+
+/**
+ * @brief Ranuras activas del bloque w (64 ranuras) cuyo campo vale value, como máscara de bits. La comparación
+ * recorre el bloque entero sin saltos, para que se vectorice.
+ */
+static uint64_t ship_match(const Engine *e, const int32_t *field, int32_t value, int w) {
+    const int32_t *block = field + w * 64;
+    uint64_t mask = 0;
+    for (int j = 0; j < 64; j++) mask |= (uint64_t)(block[j] == value) << j;
+    return mask & e->ships.active[w];
+}
+
+/** @brief Añade un evento a la lista de salida. Sin memoria para crecer, el evento se pierde. */
+static void emit(Engine *e, const EngineEvent *ev) {
+    if (e->event_count == e->event_capacity) {
+        int capacity = e->event_capacity ? e->event_capacity * 2 : 64;
+        EngineEvent *grown = realloc(e->events, sizeof(EngineEvent) * capacity);
+        if (!grown) return;
+        e->events = grown;
+        e->event_capacity = capacity;
+    }
+    e->events[e->event_count++] = *ev;
+}
+
+/** @brief Evento de un barco con su estado actual. */
+static EngineEvent ship_event(const Engine *e, int type, int idx) {
+    EngineEvent ev = {0};
+    ev.type = type;
+    ev.pid = e->ships.pid[idx];
+    ev.slot = idx;
+    ev.x = e->ships.x[idx];
+    ev.y = e->ships.y[idx];
+    ev.food = e->ships.food[idx];
+    ev.gold = e->ships.gold[idx];
+    ev.treasury = engine_treasury(e);
+    return ev;
+}
+
+/**
+ * @brief Copia la ranura idx de la tabla de barcos al índice espacial, a los agregados y al estado compartido. Debe
+ * llamarse dentro de una sección de escritura (publish_begin/publish_end).
+ */
+static void publish_ship(Engine *e, int idx) {
+    if (ship_active(e, idx)) {
+        grid_place(&e->grid, idx, e->ships.x[idx], e->ships.y[idx]);
+        stats_update(&e->stats, idx, e->ships.owner[idx], e->ships.food[idx], e->ships.gold[idx]);
+    } else {
+        grid_remove(&e->grid, idx);
+        stats_remove(&e->stats, idx, 0);
+    }
+
+    if (!e->world) return;
+    if (ship_active(e, idx)) {
+        world_set_ship(e->world, idx, e->ships.pid[idx], e->ships.x[idx], e->ships.y[idx], e->ships.food[idx],
+                       e->ships.gold[idx]);
+    } else {
+        world_clear_ship(e->world, idx);
+    }
+}
+
+// Cada operación se publica de forma atómica para los lectores del estado compartido
+static void publish_begin(Engine *e) {
+    if (e->world) world_write_begin(e->world);
+}
+
+static void publish_end(Engine *e) {
+    if (!e->world) return;
+    e->world->treasury = engine_treasury(e);
+    e->world->captain_count = e->captain_count;
+    e->world->food_at_sea = (int32_t)e->stats.sea.food;
+    e->world->gold_at_sea = (int32_t)e->stats.sea.gold;
+    world_write_end(e->world);
+}
+
+/**
+ * @brief Crea un motor vacío.
+ * @param treasury Tesoro inicial de Ursula.
+ * @param seed Semilla del generador con el que se escogen los ganadores.
+ * @return El motor, o NULL si no hay memoria.
+ */
+Engine* engine_create(int treasury, unsigned int seed) {
+    Engine *e = malloc(sizeof(Engine));
+    if (!e) return NULL;
+    memset(e->ships.active, 0, sizeof(e->ships.active));
+    e->events = NULL;
+    e->event_capacity = 0;
+    e->world = NULL;
+    e->ledger = NULL;
+    e->account = 0;
+    e->turns = 0;
+    grid_init(&e->grid);
+    stats_init(&e->stats);
+    engine_reset(e, treasury, seed);
+    return e;
+}
+
+/**
+ * @brief Vacía el mar (barcos, capitanes, agregados, eventos) conservando la configuración y la memoria. Sólo se
+ * deshace lo que tocaron los barcos que quedan, sin recorrer el índice ni los agregados enteros: así un simulador
+ * puede jugar muchas partidas cortas con el mismo motor.
+ */
+void engine_reset(Engine *e, int treasury, unsigned int seed) {
+    publish_begin(e);
+    for (int w = 0; w < SHIP_WORDS; w++) {
+        for (uint64_t bits = e->ships.active[w]; bits; bits &= bits - 1) {
+            int i = w * 64 + __builtin_ctzll(bits);
+            ship_set_active(e, i, 0);
+            publish_ship(e, i);
+        }
+    }
+    memset(&e->stats.sea, 0, sizeof(e->stats.sea));
+    memset(e->stats.groups, 0, sizeof(e->stats.groups));
+    memset(e->captains, 0, sizeof(e->captains));
+    e->captain_count = 0;
+    e->ever_had_captains = 0;
+    e->treasury = treasury;
+    e->seed = seed;
+    e->bankrupt = 0;
+    e->event_count = 0;
+    publish_end(e);
+}
+
+void engine_destroy(Engine *e) {
+    if (!e) return;
+    free(e->events);
+    free(e);
+}
+
+void engine_set_world(Engine *e, WorldState *world) {
+    e->world = world;
+    if (world) world->treasury = engine_treasury(e);
+}
+
+/** @brief Lleva el tesoro en la cuenta account del libro común de una federación en vez de en el propio motor. */
+void engine_set_ledger(Engine *e, Ledger *ledger, int account) {
+    e->ledger = ledger;
+    e->account = account;
+}
+
+/** @brief Activa (turns != 0) el combate por turnos: los combates se resuelven en engine_tick. */
+void engine_set_turns(Engine *e, int turns) {
+    e->turns = turns;
+}
+
+/** @return La ranura del barco activo con ese PID, o -1 si no está registrado. */
+int engine_find_ship(const Engine *e, int pid) {
+    for (int w = 0; w < SHIP_WORDS; w++) {
+        if (!e->ships.active[w]) continue;
+        uint64_t hit = ship_match(e, e->ships.pid, pid, w);
+        if (hit) return w * 64 + __builtin_ctzll(hit);
+    }
+    return -1;
+}
+
+static int find_captain(const Engine *e, int pid) {
+    for (int i = 0; i < ENGINE_MAX_CAPTAINS; i++) {
+        if (e->captains[i].active && e->captains[i].pid == pid) return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Da de alta un barco en la primera ranura libre (la búsqueda salta de 64 en 64 las ranuras ocupadas).
+ * @param owner Ranura del capitán dueño, o -1 si no tiene.
+ * @return La ranura, o -1 si la tabla está llena.
+ */
+static int add_ship(Engine *e, int pid, int x, int y, int food, int gold, int owner) {
+    for (int w = 0; w < SHIP_WORDS; w++) {
+        if (e->ships.active[w] == ~0ull) continue;
+        int i = w * 64 + __builtin_ctzll(~e->ships.active[w]);
+        if (i >= ENGINE_MAX_SHIPS) break;
+        e->ships.pid[i] = pid;
+        e->ships.x[i] = x;
+        e->ships.y[i] = y;
+        e->ships.food[i] = food;
+        e->ships.gold[i] = gold;
+        e->ships.owner[i] = owner;
+        ship_set_active(e, i, 1);
+        e->moved[i] = 0;
+        publish_ship(e, i);
+        EngineEvent ev = ship_event(e, ENGINE_EV_SHIP_JOINED, i);
+        emit(e, &ev);
+        return i;
+    }
+    return -1;
+}
+
+/** @brief Da de baja la ranura idx. banked: el barco vuelve a puerto y su oro cuenta para el marcador de su capitán. */
+static void remove_ship(Engine *e, int idx, int banked) {
+    EngineEvent ev = ship_event(e, ENGINE_EV_SHIP_LEFT, idx);
+    if (banked) stats_remove(&e->stats, idx, 1);
+    ship_set_active(e, idx, 0);
+    publish_ship(e, idx);
+    emit(e, &ev);
+}
+
+/**
+ * @brief Resuelve el combate entre los barcos dados, todos en las coordenadas (x, y).
+ * Selecciona aleatoriamente a un ganador entre ellos, y procesa a los perdedores decrementando su comida y oro. El
+ * botín de los perdedores se junta en un pozo, y el ganador es recompensado con oro de este pozo. Si el pozo es
+ * insuficiente para recompensar al ganador, Ursula subsidia la diferencia de su tesoro. Si el tesoro no puede cubrir
+ * el subsidio, el motor queda en bancarrota (ENGINE_EV_BANKRUPT) y no resuelve más combates.
+ * @param combatants Índices de los barcos, en el orden de la tabla de barcos.
+ * @param count Número de barcos (al menos 2).
+ */
+static void fight(Engine *e, const int *combatants, int count, int x, int y) {
+    EngineEvent ev = {0};
+    ev.type = ENGINE_EV_COMBAT;
+    ev.slot = -1;
+    ev.x = x;
+    ev.y = y;
+    ev.amount = count;
+    ev.treasury = engine_treasury(e);
+    emit(e, &ev);
+
+    // Escoger un ganador
+    int winner_pos = rand_r(&e->seed) % count;
+    int winner = combatants[winner_pos];
+    int loot_pool = 0;
+
+    // Procesar Perdedores
+    for (int i = 0; i < count; i++) {
+        if (i == winner_pos) continue;
+        int loser = combatants[i];
+        int food_before = e->ships.food[loser], gold_before = e->ships.gold[loser];
+
+        e->ships.food[loser] = food_before >= ENGINE_LOSS ? food_before - ENGINE_LOSS : 0;
+        // El oro perdido va al pozo (si no llega a ENGINE_LOSS, todo lo que tenga)
+        int taken = gold_before >= ENGINE_LOSS ? ENGINE_LOSS : gold_before;
+        e->ships.gold[loser] -= taken;
+        loot_pool += taken;
+        publish_ship(e, loser);
+
+        ev = ship_event(e, ENGINE_EV_LOSS, loser);
+        ev.dfood = e->ships.food[loser] - food_before;
+        ev.dgold = -taken;
+        emit(e, &ev);
+    }
+
+    // Recompensar Ganador
+    e->ships.gold[winner] += ENGINE_REWARD;
+    publish_ship(e, winner);
+
+    // Si el pozo tiene suficiente, el ganador toma su parte y el resto va a Ursula; si no, Ursula paga la diferencia
+    int subsidy = ENGINE_REWARD - loot_pool;
+    if (subsidy <= 0) {
+        treasury_deposit(e, -subsidy);
+    } else if (treasury_withdraw(e, subsidy) != 0) {
+        e->bankrupt = 1;
+        ev = ship_event(e, ENGINE_EV_BANKRUPT, winner);
+        ev.dgold = ENGINE_REWARD;
+        ev.amount = subsidy;
+        emit(e, &ev);
+        return;
+    }
+    ev = ship_event(e, ENGINE_EV_WIN, winner);
+    ev.dgold = ENGINE_REWARD;
+    ev.amount = -subsidy;
+    emit(e, &ev);
+}
+
+static int compare_int(const void *a, const void *b) {
+    return *(const int *)a - *(const int *)b;
+}
+
+static uint64_t cell_key(int x, int y) {
+    return ((uint64_t)((uint32_t)x ^ 0x80000000u) << 32) | ((uint32_t)y ^ 0x80000000u);
+}
+
+// Orden de los barcos por celda (x, y) y, dentro de la celda, por ranura
+static int compare_cell(const void *a, const void *b) {
+    const CellKey *ka = a, *kb = b;
+    if (ka->cell != kb->cell) return ka->cell < kb->cell ? -1 : 1;
+    return (ka->slot > kb->slot) - (ka->slot < kb->slot);
+}
+
+/**
+ * @brief Resuelve el combate en la celda (x, y) tras un movimiento. Con turnos sólo anota al barco idx, y el combate
+ * se resuelve en engine_tick.
+ */
+static void resolve_combat(Engine *e, int idx, int x, int y) {
+    int combatants[ENGINE_MAX_SHIPS];
+
+    if (e->turns) {
+        e->moved[idx] = 1;
+        return;
+    }
+    if (e->bankrupt) return;
+
+    // Identificar barcos en esta ubicación (índice espacial), en el orden de la tabla de barcos
+    int count = grid_query_rect(&e->grid, x, y, x, y, combatants, ENGINE_MAX_SHIPS);
+    if (count < 2) return; // No se necesita pelear
+    qsort(combatants, count, sizeof(int), compare_int);
+    fight(e, combatants, count, x, y);
+}
+
+/**
+ * @brief Cierra un turno de combate: ordena los barcos activos por celda y, en una sola pasada, resuelve cada celda
+ * ocupada por varios barcos en la que alguno se haya movido durante el turno. El resultado depende sólo de las
+ * posiciones al cerrar el turno, no del orden en que llegaron los movimientos; las celdas se resuelven en orden (x, y).
+ * @return Número de combates resueltos.
+ */
+int engine_tick(Engine *e) {
+    int n = 0, combats = 0;
+
+    // Sólo se recorren los bits activos; la ordenación compara claves, sin volver a la tabla
+    for (int w = 0; w < SHIP_WORDS; w++) {
+        for (uint64_t bits = e->ships.active[w]; bits; bits &= bits - 1) {
+            int i = w * 64 + __builtin_ctzll(bits);
+            e->keys[n].cell = cell_key(e->ships.x[i], e->ships.y[i]);
+            e->keys[n++].slot = i;
+        }
+    }
+    qsort(e->keys, n, sizeof(CellKey), compare_cell);
+    for (int i = 0; i < n; i++) e->order[i] = e->keys[i].slot;
+
+    publish_begin(e);
+    for (int start = 0, end; start < n && !e->bankrupt; start = end) {
+        int contested = 0;
+        for (end = start; end < n && e->keys[end].cell == e->keys[start].cell; end++) {
+            contested |= e->moved[e->order[end]];
+        }
+        if (contested && end - start >= 2) {
+            fight(e, e->order + start, end - start, e->ships.x[e->order[start]], e->ships.y[e->order[start]]);
+            combats++;
+        }
+    }
+    for (int i = 0; i < n; i++) e->moved[e->order[i]] = 0;     // Las ranuras libres se limpian en add_ship
+    publish_end(e);
+    return combats;
+}
+
+/** @return La ranura del capitán, o -1 si la tabla de capitanes está llena. */
+int engine_captain_join(Engine *e, int pid) {
+    for (int i = 0; i < ENGINE_MAX_CAPTAINS; i++) {
+        if (e->captains[i].active) continue;
+        publish_begin(e);
+        e->captains[i].pid = pid;
+        e->captains[i].active = 1;
+        e->captain_count++;
+        e->ever_had_captains = 1;
+        publish_end(e);
+        EngineEvent ev = {0};
+        ev.type = ENGINE_EV_CAPTAIN_JOINED;
+        ev.pid = pid;
+        ev.slot = i;
+        ev.treasury = engine_treasury(e);
+        emit(e, &ev);
+        return i;
+    }
+    return -1;
+}
+
+/**
+ * @brief Desconecta un capitán: sus barcos a flote quedan sin dueño y su ranura queda libre para otro. El evento
+ * ENGINE_EV_CAPTAIN_LEFT lleva su marcador final.
+ * @return La ranura que ocupaba, o -1 si no estaba registrado.
+ */
+int engine_captain_leave(Engine *e, int pid) {
+    int idx = find_captain(e, pid);
+    if (idx == -1) return -1;
+
+    StatsTotals *fleet = &e->stats.groups[idx];
+    EngineEvent ev = {0};
+    ev.type = ENGINE_EV_CAPTAIN_LEFT;
+    ev.pid = pid;
+    ev.slot = idx;
+    ev.amount = fleet->ships;
+    ev.gold = (int)fleet->gold;
+    ev.food = (int)fleet->food;
+    ev.banked = fleet->banked;
+
+    publish_begin(e);
+    e->captains[idx].active = 0;
+    e->captain_count--;
+    for (int w = 0; fleet->ships > 0 && w < SHIP_WORDS; w++) {
+        for (uint64_t hit = ship_match(e, e->ships.owner, idx, w); hit; hit &= hit - 1) {
+            int i = w * 64 + __builtin_ctzll(hit);
+            e->ships.owner[i] = -1;
+            publish_ship(e, i);
+        }
+    }
+    stats_reset_group(&e->stats, idx);
+    publish_end(e);
+
+    ev.treasury = engine_treasury(e);
+    emit(e, &ev);
+    return idx;
+}
+
+/**
+ * @brief Alta de un barco (INIT). Un INIT repetido no cambia nada.
+ * @param owner PID del capitán dueño (0 o desconocido: sin dueño).
+ * @return La ranura del barco, o -1 si la tabla está llena.
+ */
+int engine_apply_init(Engine *e, int pid, int x, int y, int food, int gold, int owner) {
+    int idx = engine_find_ship(e, pid);
+    if (idx != -1) return idx;
+    publish_begin(e);
+    idx = add_ship(e, pid, x, y, food, gold, find_captain(e, owner));
+    publish_end(e);
+    return idx;
+}
+
+/**
+ * @brief Movimiento de un barco (MOVE): actualiza su posición y recursos y resuelve el combate en su nueva celda
+ * (o lo anota para el turno). Un barco no registrado se da de alta sin dueño y sin combate.
+ * @return La ranura del barco, o -1 si no estaba registrado y la tabla está llena.
+ */
+int engine_apply_move(Engine *e, int pid, int x, int y, int food, int gold) {
+    int idx = engine_find_ship(e, pid);
+    publish_begin(e);
+    if (idx == -1) {
+        idx = add_ship(e, pid, x, y, food, gold, -1);
+    } else {
+        e->ships.x[idx] = x;
+        e->ships.y[idx] = y;
+        e->ships.food[idx] = food;
+        e->ships.gold[idx] = gold;
+        publish_ship(e, idx);
+        resolve_combat(e, idx, x, y);
+    }
+    publish_end(e);
+    return idx;
+}
+
+/**
+ * @brief Traspaso desde otra región (ARRIVE): el barco trae su posición y recursos, y combate como tras un MOVE.
+ * @return La ranura del barco, o -1 si la tabla está llena.
+ */
+int engine_apply_arrive(Engine *e, int pid, int x, int y, int food, int gold, int owner) {
+    int idx = engine_find_ship(e, pid);
+    int captain = find_captain(e, owner);
+    publish_begin(e);
+    if (idx == -1) idx = add_ship(e, pid, x, y, food, gold, captain);
+    if (idx != -1) {
+        if (captain != -1) e->ships.owner[idx] = captain;
+        e->ships.x[idx] = x;
+        e->ships.y[idx] = y;
+        e->ships.food[idx] = food;
+        e->ships.gold[idx] = gold;
+        publish_ship(e, idx);
+        resolve_combat(e, idx, x, y);
+    }
+    publish_end(e);
+    return idx;
+}
+
+/** @brief El barco vuelve a puerto (TERMINATE). @return La ranura que ocupaba, o -1 si no estaba registrado. */
+int engine_apply_terminate(Engine *e, int pid) {
+    int idx = engine_find_ship(e, pid);
+    if (idx == -1) return -1;
+    publish_begin(e);
+    remove_ship(e, idx, 1);
+    publish_end(e);
+    return idx;
+}
+
+/** @brief El barco pasa a otra región (LEAVE). @return La ranura que ocupaba, o -1 si no estaba registrado. */
+int engine_apply_leave(Engine *e, int pid) {
+    int idx = engine_find_ship(e, pid);
+    if (idx == -1) return -1;
+    publish_begin(e);
+    remove_ship(e, idx, 0);
+    publish_end(e);
+    return idx;
+}
+
+/**
+ * @brief El barco murió sin despedirse (LOST): sale del mar sin llevar su oro a puerto.
+ * @return La ranura que ocupaba, o -1 si no estaba registrado (ya se había despedido).
+ */
+int engine_apply_lost(Engine *e, int pid) {
+    int idx = engine_find_ship(e, pid);
+    if (idx == -1) return -1;
+    publish_begin(e);
+    remove_ship(e, idx, 0);
+    publish_end(e);
+    return idx;
+}
+
+/**
+ * @brief Aplica un evento del protocolo de Ursula con la función apply que le corresponde.
+ * @return La ranura afectada (de barco o de capitán), o -1 si el evento no tuvo efecto.
+ */
+int engine_apply(Engine *e, const UrsulaEvent *ev) {
+    switch (ev->type) {
+        case URSULA_INIT_CAPT: return engine_captain_join(e, ev->pid);
+        case URSULA_END_CAPT: return engine_captain_leave(e, ev->pid);
+        case URSULA_INIT: return engine_apply_init(e, ev->pid, ev->x, ev->y, ev->food, ev->gold, ev->owner);
+        case URSULA_MOVE: return engine_apply_move(e, ev->pid, ev->x, ev->y, ev->food, ev->gold);
+        case URSULA_ARRIVE: return engine_apply_arrive(e, ev->pid, ev->x, ev->y, ev->food, ev->gold, ev->owner);
+        case URSULA_TERMINATE: return engine_apply_terminate(e, ev->pid);
+        case URSULA_LEAVE: return engine_apply_leave(e, ev->pid);
+        case URSULA_LOST: return engine_apply_lost(e, ev->pid);
+        default: return -1;
+    }
+}
+
+/**
+ * @brief Eventos de salida acumulados desde el último engine_clear_events, en el orden en que ocurrieron.
+ * @return Número de eventos.
+ */
+int engine_events(const Engine *e, const EngineEvent **events) {
+    *events = e->events;
+    return e->event_count;
+}
+
+void engine_clear_events(Engine *e) {
+    e->event_count = 0;
+}
+
+/** @return 1 y el estado del barco en out si la ranura está ocupada, 0 si no. */
+int engine_ship(const Engine *e, int slot, EngineShip *out) {
+    if (slot < 0 || slot >= ENGINE_MAX_SHIPS || !ship_active(e, slot)) return 0;
+    int owner = e->ships.owner[slot];
+    out->pid = e->ships.pid[slot];
+    out->x = e->ships.x[slot];
+    out->y = e->ships.y[slot];
+    out->food = e->ships.food[slot];
+    out->gold = e->ships.gold[slot];
+    out->owner = owner >= 0 && e->captains[owner].active ? e->captains[owner].pid : 0;
+    return 1;
+}
+
+/** @return Número de capitanes conectados; sus PID (hasta max) quedan en pids. */
+int engine_captains(const Engine *e, int *pids, int max) {
+    int n = 0;
+    for (int i = 0; i < ENGINE_MAX_CAPTAINS; i++) {
+        if (!e->captains[i].active) continue;
+        if (n < max) pids[n] = e->captains[i].pid;
+        n++;
+    }
+    return n;
+}
+
+/** @brief Totales del mar: barcos, comida y oro a flote, y oro llevado a puerto. */
+const StatsTotals* engine_totals(const Engine *e) {
+    return &e->stats.sea;
+}
+
+int engine_bankrupt(const Engine *e) {
+    return e->bankrupt;
+}
+
+/** @return 1 si hubo capitanes y ya se han ido todos y no queda ningún barco: el mar está en silencio. */
+int engine_finished(const Engine *e) {
+    return e->ever_had_captains && e->captain_count == 0 && e->stats.sea.ships == 0;
+}
+
+// Una fila de agregados de la respuesta a STATS o CAPTAIN
+static void query_totals(const char *who, const StatsTotals *t, FILE *out) {
+    fprintf(out, "%s,%d,%ld,%ld,%ld\n", who, t->ships, t->food, t->gold, t->banked);
+}
+
+/**
+ * @brief Responde a una consulta espacial. Peticiones (una por línea):
+ *   RADIUS <x> <y> <r>          barcos a distancia euclídea <= r de (x, y)
+ *   RECT <x0> <y0> <x1> <y1>    barcos dentro del rectángulo (bordes incluidos)
+ *   KNN <x> <y> <k>             los k barcos más cercanos, del más cercano al más lejano
+ *   TOP <k>                     los k barcos con más oro, del más rico al menos
+ * Respuesta: una línea con el número de barcos n, seguida de n líneas "<pid>,<x>,<y>,<comida>,<oro>",
+ * o una única línea "ERR <motivo>".
+ * Agregados (sin recorrer la tabla de barcos):
+ *   STATS                       totales del mar y de cada capitán
+ *   CAPTAIN <pid>               totales de un capitán
+ * Respuesta: una línea con el número de filas n, seguida de n líneas "<quién>,<barcos>,<comida>,<oro>,<en puerto>",
+ * donde quién es "*" para el mar entero o el PID del capitán.
+ * @param request Línea de la petición, sin salto de línea.
+ * @param out Flujo donde se escribe la respuesta.
+ */
+void engine_query(const Engine *e, const char *request, FILE *out) {
+    int found[ENGINE_MAX_SHIPS];
+    char kind[16];
+    long arg[4] = {0};
+    int n = -1;
+
+    // Se leen en long y se recortan: x ± r y r² no pueden desbordar un int en el índice espacial
+    int fields = sscanf(request, "%15s %ld %ld %ld %ld", kind, &arg[0], &arg[1], &arg[2], &arg[3]);
+    for (int i = 0; i < 4 && i < fields - 1; i++) {
+        if (arg[i] < -QUERY_LIMIT) arg[i] = -QUERY_LIMIT;
+        if (arg[i] > QUERY_LIMIT) arg[i] = QUERY_LIMIT;
+    }
+    int a = (int)arg[0], b = (int)arg[1], c = (int)arg[2], d = (int)arg[3];
+    if (fields == 4 && strcasecmp(kind, "RADIUS") == 0 && c >= 0) {
+        n = grid_query_radius(&e->grid, a, b, c, found, ENGINE_MAX_SHIPS);
+    } else if (fields == 5 && strcasecmp(kind, "RECT") == 0) {
+        n = grid_query_rect(&e->grid, a, b, c, d, found, ENGINE_MAX_SHIPS);
+    } else if (fields == 4 && strcasecmp(kind, "KNN") == 0 && c >= 0) {
+        n = grid_query_knn(&e->grid, a, b, c > ENGINE_MAX_SHIPS ? ENGINE_MAX_SHIPS : c, found);
+    } else if (fields == 2 && strcasecmp(kind, "TOP") == 0 && a >= 0) {
+        n = stats_top_gold(&e->stats, a > ENGINE_MAX_SHIPS ? ENGINE_MAX_SHIPS : a, found);
+    } else if (fields == 1 && strcasecmp(kind, "STATS") == 0) {
+        fprintf(out, "%d\n", 1 + e->captain_count);
+        query_totals("*", &e->stats.sea, out);
+        for (int i = 0; i < ENGINE_MAX_CAPTAINS; i++) {
+            if (!e->captains[i].active) continue;
+            char who[16];
+            snprintf(who, sizeof(who), "%d", e->captains[i].pid);
+            query_totals(who, &e->stats.groups[i], out);
+        }
+        return;
+    } else if (fields == 2 && strcasecmp(kind, "CAPTAIN") == 0) {
+        int idx = find_captain(e, a);
+        if (idx == -1) {
+            fprintf(out, "ERR capitán %d no registrado\n", a);
+        } else {
+            char who[16];
+            snprintf(who, sizeof(who), "%d", a);
+            fprintf(out, "1\n");
+            query_totals(who, &e->stats.groups[idx], out);
+        }
+        return;
+    }
+
+    if (n < 0) {
+        fprintf(out, "ERR consulta no válida: use RADIUS x y r | RECT x0 y0 x1 y1 | KNN x y k | TOP k | STATS | CAPTAIN pid\n");
+        return;
+    }
+    if (n > ENGINE_MAX_SHIPS) n = ENGINE_MAX_SHIPS;
+    fprintf(out, "%d\n", n);
+    for (int i = 0; i < n; i++) {
+        int s = found[i];
+        fprintf(out, "%d,%d,%d,%d,%d\n", e->ships.pid[s], e->ships.x[s], e->ships.y[s], e->ships.food[s], e->ships.gold[s]);
+    }
+}
@@ -0,0 +1,96 @@
+/**
+ * @file engine.h
+ * @brief Motor del mar de Ursula (libursula): registro de barcos y capitanes, combate, tesoro y agregados, sin
+ * procesos, señales ni transporte.
+ *
+ * Un Engine es un objeto explícito que se alimenta con funciones apply (o con engine_apply y un UrsulaEvent ya
+ * decodificado) y devuelve lo que ha pasado como una lista de eventos (combates, resultados de cada barco, altas y
+ * bajas, bancarrota) que el llamante consume con engine_events. El binario ursula es una capa de transporte sobre el
+ * motor (FIFO, anillo, consultas, pidfd, señales); los simuladores y bancos de pruebas lo pueden usar en el mismo
+ * proceso a velocidad de memoria. El motor no es seguro entre hilos: el llamante serializa las llamadas.
+ */
+
+#ifndef ENGINE_H
+#define ENGINE_H
+
+#include <stdio.h>
+#include "world.h"
+#include "ledger.h"
+#include "stats.h"
+#include "ursula.h"
+
+#define ENGINE_MAX_SHIPS WORLD_MAX_SHIPS
+#define ENGINE_MAX_CAPTAINS STATS_MAX_GROUPS
+#define ENGINE_REWARD 10            // Oro del ganador de un combate
+#define ENGINE_LOSS 10              // Comida y oro que pierde cada perdedor
+
+typedef struct Engine Engine;
+
+// Tipos de los eventos de salida
+enum {
+    ENGINE_EV_SHIP_JOINED = 1,      // Barco dado de alta en slot (INIT, ARRIVE o MOVE sin INIT)
+    ENGINE_EV_SHIP_LEFT,            // Barco dado de baja de slot (TERMINATE, LEAVE o LOST)
+    ENGINE_EV_CAPTAIN_JOINED,       // Capitán registrado en slot
+    ENGINE_EV_CAPTAIN_LEFT,         // Capitán desconectado: amount barcos a flote con gold de oro, banked en puerto
+    ENGINE_EV_COMBAT,               // Combate en (x, y) entre amount barcos
+    ENGINE_EV_LOSS,                 // Un perdedor: dfood, dgold negativos; food, gold tras el combate
+    ENGINE_EV_WIN,                  // El ganador: dgold = ENGINE_REWARD; amount = impuesto (>= 0) o -subsidio
+    ENGINE_EV_BANKRUPT              // El tesoro no cubre el subsidio amount del ganador pid (que ya cobró dgold)
+};
+
+typedef struct {
+    int type;
+    int pid;
+    int slot;                       // Ranura del barco (o del capitán en los eventos de capitán)
+    int x;
+    int y;
+    int food;                       // Valores del barco tras el evento
+    int gold;
+    int dfood;                      // Variación por el combate: lo que hay que notificar al barco
+    int dgold;
+    int amount;
+    int treasury;                   // Tesoro tras el evento
+    long banked;
+} EngineEvent;
+
+// Estado de un barco, para los usuarios del motor
+typedef struct {
+    int pid;
+    int x;
+    int y;
+    int food;
+    int gold;
+    int owner;                      // PID del capitán dueño, 0 si no tiene
+} EngineShip;
+
+Engine* engine_create(int treasury, unsigned int seed);
+void engine_reset(Engine *engine, int treasury, unsigned int seed);
+void engine_destroy(Engine *engine);
+void engine_set_world(Engine *engine, WorldState *world);
+void engine_set_ledger(Engine *engine, Ledger *ledger, int account);
+void engine_set_turns(Engine *engine, int turns);
+
+int engine_captain_join(Engine *engine, int pid);
+int engine_captain_leave(Engine *engine, int pid);
+int engine_apply_init(Engine *engine, int pid, int x, int y, int food, int gold, int owner);
+int engine_apply_move(Engine *engine, int pid, int x, int y, int food, int gold);
+int engine_apply_arrive(Engine *engine, int pid, int x, int y, int food, int gold, int owner);
+int engine_apply_terminate(Engine *engine, int pid);
+int engine_apply_leave(Engine *engine, int pid);
+int engine_apply_lost(Engine *engine, int pid);
+int engine_apply(Engine *engine, const UrsulaEvent *ev);
+int engine_tick(Engine *engine);
+
+int engine_events(const Engine *engine, const EngineEvent **events);
+void engine_clear_events(Engine *engine);
+
+int engine_find_ship(const Engine *engine, int pid);
+int engine_ship(const Engine *engine, int slot, EngineShip *out);
+int engine_captains(const Engine *engine, int *pids, int max);
+int engine_treasury(const Engine *engine);
+const StatsTotals* engine_totals(const Engine *engine);
+int engine_bankrupt(const Engine *engine);
+int engine_finished(const Engine *engine);
+void engine_query(const Engine *engine, const char *request, FILE *out);
+
+#endif
@@ -0,0 +1,499 @@
+#include <stdlib.h>
+#include <string.h>
+#include "fleet.h"
+
+#define SLOT_EMPTY (-1)
+#define SLOT_DELETED (-2)
+
+static unsigned int hash_int(int key)
+{
+    unsigned int h = (unsigned int)key;
+    h ^= h >> 16;
+    h *= 0x7feb352dU;
+    h ^= h >> 15;
+    h *= 0x846ca68bU;
+    h ^= h >> 16;
+    return h;
+}
+
+static int key_id(Fleet* fleet, int idx)
+{
+    return fleet->records[idx].id;
+}
+
+static int key_pid(Fleet* fleet, int idx)
+{
+    return (int)fleet->records[idx].pid;
+}
+
+/**
+ * @brief Busca la ranura de la tabla hash que contiene key, o -1 si no está.
+ */
+static int index_lookup(Fleet* fleet, int* table, int (*key_of)(Fleet*, int), int key)
+{
+    if (!table) return -1;
+    unsigned int mask = (unsigned int)fleet->index_capacity - 1;
+    unsigned int i = hash_int(key) & mask;
+    while (table[i] != SLOT_EMPTY)
+    {
+        if (table[i] >= 0 && key_of(fleet, table[i]) == key) return (int)i;
+        i = (i + 1) & mask;
+    }
+    return -1;
+}
+
+static void index_insert(Fleet* fleet, int* table, int key, int idx)
+{
+    unsigned int mask = (unsigned int)fleet->index_capacity - 1;
+    unsigned int i = hash_int(key) & mask;
+    while (table[i] >= 0) i = (i + 1) & mask;
+    table[i] = idx;
+}
+
+/**
+ * @brief Reconstruye ambos índices con la capacidad dada, descartando las ranuras borradas.
+ */
+static int index_rebuild(Fleet* fleet, int capacity)
+{
+    int* by_id = malloc(sizeof(int) * capacity);
+    int* by_pid = malloc(sizeof(int) * capacity);
+    if (!by_id || !by_pid)
+    {
+        free(by_id);
+        free(by_pid);
+        return -1;
+    }
+    memset(by_id, 0xff, sizeof(int) * capacity); // SLOT_EMPTY
+    memset(by_pid, 0xff, sizeof(int) * capacity);
+
+    free(fleet->by_id);
+    free(fleet->by_pid);
+    fleet->by_id = by_id;
+    fleet->by_pid = by_pid;
+    fleet->index_capacity = capacity;
+    fleet->index_used = fleet->active_count;
+
+    for (int i = 0; i < fleet->active_count; i++)
+    {
+        int idx = fleet->active[i];
+        index_insert(fleet, by_id, fleet->records[idx].id, idx);
+        index_insert(fleet, by_pid, (int)fleet->records[idx].pid, idx);
+    }
+    return 0;
+}
+
+static uint64_t cell_key(int x, int y)
+{
+    // +1 para que 0 signifique ranura libre
+    return (((uint64_t)(uint32_t)y << 32) | (uint32_t)x) + 1;
+}
+
+static unsigned int hash_cell(uint64_t key)
+{
+    return (unsigned int)((key * 0x9E3779B97F4A7C15ULL) >> 32);
+}
+
+/**
+ * @brief Reconstruye la tabla de ocupación con la capacidad dada, descartando las celdas que quedaron vacías.
+ */
+static int cell_rebuild(Fleet* fleet, int capacity)
+{
+    uint64_t* keys = calloc(capacity, sizeof(uint64_t));
+    int* heads = malloc(sizeof(int) * capacity);
+    if (!keys || !heads)
+    {
+        free(keys);
+        free(heads);
+        return -1;
+    }
+
+    int used = 0;
+    unsigned int mask = (unsigned int)capacity - 1;
+    for (int i = 0; i < fleet->cell_capacity; i++)
+    {
+        if (fleet->cell_keys[i] == 0 || fleet->cell_heads[i] < 0) continue;
+        unsigned int j = hash_cell(fleet->cell_keys[i]) & mask;
+        while (keys[j] != 0) j = (j + 1) & mask;
+        keys[j] = fleet->cell_keys[i];
+        heads[j] = fleet->cell_heads[i];
+        used++;
+    }
+
+    free(fleet->cell_keys);
+    free(fleet->cell_heads);
+    fleet->cell_keys = keys;
+    fleet->cell_heads = heads;
+    fleet->cell_capacity = capacity;
+    fleet->cell_used = used;
+    return 0;
+}
+
+/**
+ * @brief Ranura de la tabla de ocupación para la celda (x, y), creándola si create es distinto de cero.
+ * Una celda que se vacía conserva su ranura (cabeza -1) hasta la siguiente reconstrucción.
+ * @return Índice de la ranura, o -1 si la celda no está en la tabla (o no hay memoria para añadirla).
+ */
+static int cell_slot(Fleet* fleet, int x, int y, int create)
+{
+    uint64_t key = cell_key(x, y);
+    unsigned int mask = (unsigned int)fleet->cell_capacity - 1;
+    unsigned int i = hash_cell(key) & mask;
+    while (fleet->cell_keys[i] != 0)
+    {
+        if (fleet->cell_keys[i] == key) return (int)i;
+        i = (i + 1) & mask;
+    }
+    if (!create) return -1;
+
+    if ((fleet->cell_used + 1) * 2 > fleet->cell_capacity)
+    {
+        int capacity = fleet->cell_capacity;
+        while ((fleet->active_count + 1) * 4 > capacity) capacity *= 2;
+        if (cell_rebuild(fleet, capacity) != 0) return -1;
+        return cell_slot(fleet, x, y, 1);
+    }
+
+    fleet->cell_keys[i] = key;
+    fleet->cell_heads[i] = -1;
+    fleet->cell_used++;
+    return (int)i;
+}
+
+static int cell_link(Fleet* fleet, int idx)
+{
+    ShipRecord* ship = &fleet->records[idx];
+    int slot = cell_slot(fleet, ship->x, ship->y, 1);
+    if (slot < 0) return -1;
+
+    ship->cell_prev = -1;
+    ship->cell_next = fleet->cell_heads[slot];
+    if (ship->cell_next >= 0) fleet->records[ship->cell_next].cell_prev = idx;
+    fleet->cell_heads[slot] = idx;
+    return 0;
+}
+
+/**
+ * @brief Saca un barco de la lista de su celda. No reserva memoria, así que es seguro desde handle_sigchld.
+ */
+static void cell_unlink(Fleet* fleet, int idx)
+{
+    ShipRecord* ship = &fleet->records[idx];
+    if (ship->cell_prev >= 0)
+    {
+        fleet->records[ship->cell_prev].cell_next = ship->cell_next;
+    }
+    else
+    {
+        int slot = cell_slot(fleet, ship->x, ship->y, 0);
+        if (slot >= 0 && fleet->cell_heads[slot] == idx) fleet->cell_heads[slot] = ship->cell_next;
+    }
+    if (ship->cell_next >= 0) fleet->records[ship->cell_next].cell_prev = ship->cell_prev;
+    ship->cell_prev = -1;
+    ship->cell_next = -1;
+}
+
+/**
+ * @brief Inicializa un registro de flota vacío.
+ * @return 0 en caso de éxito, -1 si no hay memoria.
+ */
+int fleet_init(Fleet* fleet)
+{
+    memset(fleet, 0, sizeof(*fleet));
+    if (index_rebuild(fleet, 64) != 0) return -1;
+    return cell_rebuild(fleet, 64);
+}
+
+void fleet_destroy(Fleet* fleet)
+{
+    free(fleet->records);
+    free(fleet->free_slots);
+    free(fleet->active);
+    free(fleet->by_id);
+    free(fleet->by_pid);
+    free(fleet->cell_keys);
+    free(fleet->cell_heads);
+    memset(fleet, 0, sizeof(*fleet));
+}
+
+/**
+ * @brief Da de alta un barco vivo en la celda (x, y). No hay límite de tamaño: los arrays crecen al doble
+ * cuando se llenan.
+ * @return El registro del barco, o NULL si no hay memoria.
+ */
+ShipRecord* fleet_add(Fleet* fleet, int id, pid_t pid, int x, int y)
+{
+    if (fleet->used == fleet->capacity && fleet->free_count == 0)
+    {
+        int capacity = fleet->capacity ? fleet->capacity * 2 : 64;
+        ShipRecord* records = realloc(fleet->records, sizeof(ShipRecord) * capacity);
+        if (!records) return NULL;
+        fleet->records = records;
+        int* free_slots = realloc(fleet->free_slots, sizeof(int) * capacity);
+        if (!free_slots) return NULL;
+        fleet->free_slots = free_slots;
+        int* active = realloc(fleet->active, sizeof(int) * capacity);
+        if (!active) return NULL;
+        fleet->active = active;
+        fleet->capacity = capacity;
+    }
+
+    // Mantenemos los índices por debajo de la mitad de ocupación (contando ranuras borradas)
+    if ((fleet->index_used + 1) * 2 > fleet->index_capacity)
+    {
+        int capacity = fleet->index_capacity;
+        while ((fleet->active_count + 1) * 4 > capacity) capacity *= 2;
+        if (index_rebuild(fleet, capacity) != 0) return NULL;
+    }
+
+    int idx = fleet->free_count > 0 ? fleet->free_slots[--fleet->free_count] : fleet->used++;
+    ShipRecord* ship = &fleet->records[idx];
+    memset(ship, 0, sizeof(*ship));
+    ship->id = id;
+    ship->pid = pid;
+    ship->x = x;
+    ship->y = y;
+    ship->active = 1;
+    ship->cell_prev = -1;
+    ship->cell_next = -1;
+    ship->active_pos = fleet->active_count;
+    fleet->active[fleet->active_count++] = idx;
+
+    index_insert(fleet, fleet->by_id, id, idx);
+    index_insert(fleet, fleet->by_pid, (int)pid, idx);
+    fleet->index_used++;
+
+    if (cell_link(fleet, idx) != 0)
+    {
+        fleet_remove(fleet, ship);
+        return NULL;
+    }
+    return ship;
+}
+
+/**
+ * @brief Da de baja un barco en O(1): lo borra de ambos índices y de la lista densa intercambiándolo con el último.
+ * No cierra sus descriptores; eso es responsabilidad de quien lo llama.
+ */
+void fleet_remove(Fleet* fleet, ShipRecord* ship)
+{
+    if (!ship || !ship->active) return;
+    int idx = (int)(ship - fleet->records);
+
+    int slot = index_lookup(fleet, fleet->by_id, key_id, ship->id);
+    if (slot >= 0) fleet->by_id[slot] = SLOT_DELETED;
+    slot = index_lookup(fleet, fleet->by_pid, key_pid, (int)ship->pid);
+    if (slot >= 0) fleet->by_pid[slot] = SLOT_DELETED;
+
+    cell_unlink(fleet, idx);
+
+    int last = fleet->active[--fleet->active_count];
+    fleet->active[ship->active_pos] = last;
+    fleet->records[last].active_pos = ship->active_pos;
+
+    ship->active = 0;
+    ship->pid = 0;
+    fleet->free_slots[fleet->free_count++] = idx;
+}
+
+ShipRecord* fleet_find_id(Fleet* fleet, int id)
+{
+    int slot = index_lookup(fleet, fleet->by_id, key_id, id);
+    return slot >= 0 ? &fleet->records[fleet->by_id[slot]] : NULL;
+}
+
+ShipRecord* fleet_find_pid(Fleet* fleet, pid_t pid)
+{
+    int slot = index_lookup(fleet, fleet->by_pid, key_pid, (int)pid);
+    return slot >= 0 ? &fleet->records[fleet->by_pid[slot]] : NULL;
+}
+
+/**
+ * @brief Actualiza la posición de un barco (tras un movimiento confirmado) y su celda en la tabla de ocupación.
+ * @return 0 en caso de éxito, -1 si no hay memoria (el barco conserva su posición anterior).
+ */
+int fleet_move(Fleet* fleet, ShipRecord* ship, int x, int y)
+{
+    int idx = (int)(ship - fleet->records);
+    int old_x = ship->x;
+    int old_y = ship->y;
+
+    cell_unlink(fleet, idx);
+    ship->x = x;
+    ship->y = y;
+    if (cell_link(fleet, idx) == 0) return 0;
+
+    ship->x = old_x;
+    ship->y = old_y;
+    // La ranura de la celda anterior sigue en la tabla, así que volver a enlazar no reserva memoria
+    cell_link(fleet, idx);
+    return -1;
+}
+
+/**
+ * @brief Barco de la flota situado en (x, y), o NULL si la celda está libre. O(1).
+ */
+ShipRecord* fleet_ship_at(Fleet* fleet, int x, int y)
+{
+    int slot = cell_slot(fleet, x, y, 0);
+    if (slot < 0 || fleet->cell_heads[slot] < 0) return NULL;
+    return &fleet->records[fleet->cell_heads[slot]];
+}
+
+/**
+ * @brief Barcos de la flota a distancia euclídea <= r de (x, y).
+ * Recorre las celdas del cuadrado que rodea al círculo si es más pequeño que la flota; si no, la lista de barcos vivos.
+ * @param out Array donde se guardan hasta max barcos encontrados.
+ * @return Número total de barcos encontrados (puede ser mayor que max).
+ */
+int fleet_query_radius(Fleet* fleet, int x, int y, int r, ShipRecord** out, int max)
+{
+    if (r < 0) return 0;
+    long r2 = (long)r * r;
+    long side = 2L * r + 1;
+    int found = 0;
+
+    if (side * side <= fleet->active_count)
+    {
+        for (int dy = -r; dy <= r; dy++)
+        {
+            for (int dx = -r; dx <= r; dx++)
+            {
+                if ((long)dx * dx + (long)dy * dy > r2) continue;
+                int slot = cell_slot(fleet, x + dx, y + dy, 0);
+                if (slot < 0) continue;
+                for (int idx = fleet->cell_heads[slot]; idx >= 0; idx = fleet->records[idx].cell_next)
+                {
+                    if (found < max) out[found] = &fleet->records[idx];
+                    found++;
+                }
+            }
+        }
+        return found;
+    }
+
+    for (int i = 0; i < fleet->active_count; i++)
+    {
+        ShipRecord* ship = fleet_at(fleet, i);
+        long dx = ship->x - x;
+        long dy = ship->y - y;
+        if (dx * dx + dy * dy > r2) continue;
+        if (found < max) out[found] = ship;
+        found++;
+    }
+    return found;
+}
+
+// Estado de un barco durante fleet_plan
+enum
+{
+    PLAN_UNKNOWN = 0,
+    PLAN_VISITING,
+    PLAN_MOVES,
+    PLAN_STAYS
+};
+
+typedef struct
+{
+    ShipRecord** ships;
+    int* dx;
+    int* dy;
+    int* target;            // Índice de registro -> posición en ships, -1 si el barco no recibe orden
+    unsigned char* state;   // Por posición en ships
+    uint64_t* claims;       // Celdas de destino ya reservadas (tabla hash, 0 = libre)
+    unsigned int claim_mask;
+} Plan;
+
+/** @return 0 si la celda (x, y) queda reservada, -1 si ya la había reservado otro barco. */
+static int plan_claim(Plan* plan, int x, int y)
+{
+    uint64_t key = cell_key(x, y);
+    unsigned int i = hash_cell(key) & plan->claim_mask;
+    while (plan->claims[i] != 0)
+    {
+        if (plan->claims[i] == key) return -1;
+        i = (i + 1) & plan->claim_mask;
+    }
+    plan->claims[i] = key;
+    return 0;
+}
+
+/**
+ * @brief Decide si el barco i de la orden puede moverse: su destino debe quedar libre, es decir, todos sus ocupantes
+ * actuales deben moverse a su vez (se resuelven antes, en profundidad) y ningún otro barco debe haberlo reservado.
+ * Cada barco se resuelve una sola vez; los ciclos (barcos que rotan entre sí) se quedan quietos.
+ */
+static int plan_resolve(Fleet* fleet, Plan* plan, int i)
+{
+    if (plan->state[i] == PLAN_MOVES || plan->state[i] == PLAN_STAYS) return plan->state[i];
+    if (plan->state[i] == PLAN_VISITING) return PLAN_STAYS;
+
+    ShipRecord* ship = plan->ships[i];
+    int result = PLAN_STAYS;
+    if (plan->dx[i] != 0 || plan->dy[i] != 0)
+    {
+        int nx = ship->x + plan->dx[i];
+        int ny = ship->y + plan->dy[i];
+        int slot = cell_slot(fleet, nx, ny, 0);
+
+        plan->state[i] = PLAN_VISITING;
+        result = PLAN_MOVES;
+        for (int idx = slot >= 0 ? fleet->cell_heads[slot] : -1; idx >= 0 && result == PLAN_MOVES;
+             idx = fleet->records[idx].cell_next)
+        {
+            int j = plan->target[idx];
+            if (j < 0 || plan_resolve(fleet, plan, j) != PLAN_MOVES) result = PLAN_STAYS;
+        }
+        if (result == PLAN_MOVES && plan_claim(plan, nx, ny) != 0) result = PLAN_STAYS;
+    }
+
+    plan->state[i] = result;
+    if (result == PLAN_STAYS)
+    {
+        plan->dx[i] = 0;
+        plan->dy[i] = 0;
+    }
+    return result;
+}
+
+/**
+ * @brief Resuelve en una pasada las colisiones internas de una orden a varios barcos. Cada barco da el paso
+ * (dx[i], dy[i]); los pasos que llevarían a dos barcos a la misma celda, o a una celda cuyo ocupante no se mueve,
+ * se anulan (quedan a 0). Un barco puede entrar en la celda que deja otro de la misma orden, así que una fila que
+ * avanza en bloque se mueve entera. Las celdas del mapa no se comprueban aquí.
+ * @param ships Barcos que reciben la orden (sin repetir).
+ * @param dx, dy Paso de cada barco; se modifican.
+ * @param n Número de barcos.
+ * @return Número de barcos que se moverán, o -1 si no hay memoria (no se anula ningún paso).
+ */
+int fleet_plan(Fleet* fleet, ShipRecord** ships, int* dx, int* dy, int n)
+{
+    Plan plan = {ships, dx, dy, NULL, NULL, NULL, 0};
+    unsigned int capacity = 16;
+    while (capacity < (unsigned int)n * 2) capacity *= 2;
+
+    plan.target = malloc(sizeof(int) * (fleet->used > 0 ? fleet->used : 1));
+    plan.state = calloc(n > 0 ? n : 1, 1);
+    plan.claims = calloc(capacity, sizeof(uint64_t));
+    plan.claim_mask = capacity - 1;
+    if (!plan.target || !plan.state || !plan.claims)
+    {
+        free(plan.target);
+        free(plan.state);
+        free(plan.claims);
+        return -1;
+    }
+
+    for (int idx = 0; idx < fleet->used; idx++) plan.target[idx] = -1;
+    for (int i = 0; i < n; i++) plan.target[ships[i] - fleet->records] = i;
+
+    int moving = 0;
+    for (int i = 0; i < n; i++)
+    {
+        if (plan_resolve(fleet, &plan, i) == PLAN_MOVES) moving++;
+    }
+
+    free(plan.target);
+    free(plan.state);
+    free(plan.claims);
+    return moving;
+}
@@ -0,0 +1,93 @@
+/**
+ * @file fleet.h
+ * @brief Registro dinámico de la flota del capitán con búsqueda O(1) por ID de barco, por PID y por celda.
+ */
+
+#ifndef FLEET_H
+#define FLEET_H
+
+#include <stdio.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include "ring.h"
+#include "telemetry.h"
+
+/**
+ * @brief Estructura para rastrear barcos lanzados y sus canales de comunicación
+ */
+typedef struct
+{
+    int id;
+    pid_t pid;
+    // Capitán escribe en [1], Barco lee de [0] (stdin)
+    int pipe_to_ship[2];
+    // Barco escribe en [1] (stdout), Capitán lee de [0]
+    int pipe_from_ship[2];
+    // Wrapper FILE* para pipe_from_ship[0] para el uso de getline
+    FILE* read_stream;
+    // Canal en memoria compartida para los comandos (modo --rings), NULL si se usan las tuberías
+    ShipChannel* channel;
+    // pidfd del proceso, para detectar su fin sin depender de SIGCHLD (-1 si no se pudo abrir)
+    int pidfd;
+    // Página de telemetría que publica el barco (NULL si no se pudo crear: status recurre a SIGTSTP)
+    ShipTelemetry* telemetry;
+    // Rastrear posición para detección de colisiones
+    int x, y;
+    // 1 si está vivo, 0 si terminó
+    int active;
+    // Posición en la lista densa de barcos vivos
+    int active_pos;
+    // Lista doblemente enlazada de barcos en la misma celda (índices de registro, -1 = fin)
+    int cell_prev, cell_next;
+} ShipRecord;
+
+/**
+ * @brief Registro de la flota. Los registros viven en un array que crece bajo demanda; dos tablas hash
+ * (direccionamiento abierto) indexan por ID y por PID, y una lista densa guarda los barcos vivos para iterar.
+ * Además mantiene la ocupación del mar: una tabla hash celda -> primer barco de la celda, de modo que
+ * comprobar colisiones o consultar un área no recorre la flota entera.
+ * Los punteros a ShipRecord dejan de ser válidos tras fleet_add (el array puede realojarse).
+ */
+typedef struct
+{
+    ShipRecord* records;
+    int capacity;
+    int used;
+    int* free_slots;
+    int free_count;
+    int* active;
+    int active_count;
+    int* by_id;
+    int* by_pid;
+    int index_capacity;
+    int index_used;
+    uint64_t* cell_keys;
+    int* cell_heads;
+    int cell_capacity;
+    int cell_used;
+} Fleet;
+
+int fleet_init(Fleet* fleet);
+void fleet_destroy(Fleet* fleet);
+ShipRecord* fleet_add(Fleet* fleet, int id, pid_t pid, int x, int y);
+void fleet_remove(Fleet* fleet, ShipRecord* ship);
+ShipRecord* fleet_find_id(Fleet* fleet, int id);
+ShipRecord* fleet_find_pid(Fleet* fleet, pid_t pid);
+int fleet_move(Fleet* fleet, ShipRecord* ship, int x, int y);
+ShipRecord* fleet_ship_at(Fleet* fleet, int x, int y);
+int fleet_query_radius(Fleet* fleet, int x, int y, int r, ShipRecord** out, int max);
+int fleet_plan(Fleet* fleet, ShipRecord** ships, int* dx, int* dy, int n);
+
+/** @brief Número de barcos vivos. */
+static inline int fleet_count(const Fleet* fleet)
+{
+    return fleet->active_count;
+}
+
+/** @brief i-ésimo barco vivo (0 <= i < fleet_count). */
+static inline ShipRecord* fleet_at(Fleet* fleet, int i)
+{
+    return &fleet->records[fleet->active[i]];
+}
+
+#endif
@@ -0,0 +1,248 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include "grid.h"
+
+typedef struct {
+    unsigned long long dist2;
+    int item;
+} GridCandidate;
+
+static unsigned int bucket_hash(int bx, int by) {
+    return ((unsigned int)bx * 73856093u) ^ ((unsigned int)by * 19349663u);
+}
+
+// Ranura de la cubeta (bx, by), o -1 si no existe
+static int bucket_find(const Grid *grid, int bx, int by) {
+    unsigned int mask = GRID_BUCKETS - 1;
+    unsigned int i = bucket_hash(bx, by) & mask;
+    while (grid->buckets[i].used) {
+        if (grid->buckets[i].bx == bx && grid->buckets[i].by == by) return (int)i;
+        i = (i + 1) & mask;
+    }
+    return -1;
+}
+
+static void item_link(Grid *grid, int item, int b) {
+    grid->bucket[item] = b;
+    grid->prev[item] = -1;
+    grid->next[item] = grid->buckets[b].head;
+    if (grid->buckets[b].head >= 0) grid->prev[grid->buckets[b].head] = item;
+    grid->buckets[b].head = item;
+}
+
+static void item_unlink(Grid *grid, int item) {
+    int b = grid->bucket[item];
+    if (grid->prev[item] >= 0) grid->next[grid->prev[item]] = grid->next[item];
+    else grid->buckets[b].head = grid->next[item];
+    if (grid->next[item] >= 0) grid->prev[grid->next[item]] = grid->prev[item];
+}
+
+static int bucket_insert(Grid *grid, int bx, int by) {
+    unsigned int mask = GRID_BUCKETS - 1;
+    unsigned int i = bucket_hash(bx, by) & mask;
+    while (grid->buckets[i].used) i = (i + 1) & mask;
+    grid->buckets[i].bx = bx;
+    grid->buckets[i].by = by;
+    grid->buckets[i].head = -1;
+    grid->buckets[i].used = 1;
+    grid->bucket_used++;
+    return (int)i;
+}
+
+// Vacía la tabla de cubetas y vuelve a enlazar los elementos presentes, descartando las cubetas vacías
+static void buckets_rebuild(Grid *grid) {
+    memset(grid->buckets, 0, sizeof(grid->buckets));
+    grid->bucket_used = 0;
+    for (int item = 0; item < GRID_MAX_ITEMS; item++) {
+        if (!grid->present[item]) continue;
+        int bx = grid->x[item] >> GRID_SHIFT, by = grid->y[item] >> GRID_SHIFT;
+        int b = bucket_find(grid, bx, by);
+        if (b < 0) b = bucket_insert(grid, bx, by);
+        item_link(grid, item, b);
+    }
+}
+
+void grid_init(Grid *grid) {
+    memset(grid, 0, sizeof(*grid));
+}
+
+/**
+ * @brief Coloca item en (x, y): lo inserta si no estaba o lo mueve de cubeta si cambió de zona.
+ */
+void grid_place(Grid *grid, int item, int x, int y) {
+    if (item < 0 || item >= GRID_MAX_ITEMS) return;
+    int bx = x >> GRID_SHIFT, by = y >> GRID_SHIFT;
+
+    if (grid->present[item]) {
+        GridBucket *cur = &grid->buckets[grid->bucket[item]];
+        grid->x[item] = x;
+        grid->y[item] = y;
+        if (cur->bx == bx && cur->by == by) return; // Misma cubeta: sólo cambia la posición
+        item_unlink(grid, item);
+    } else {
+        grid->present[item] = 1;
+        grid->count++;
+        grid->x[item] = x;
+        grid->y[item] = y;
+    }
+
+    int b = bucket_find(grid, bx, by);
+    if (b < 0) {
+        if ((grid->bucket_used + 1) * 4 > GRID_BUCKETS * 3) {
+            // La reconstrucción enlaza también item (ya marcado como presente)
+            grid->present[item] = 0;
+            buckets_rebuild(grid);
+            grid->present[item] = 1;
+            b = bucket_find(grid, bx, by);
+        }
+        if (b < 0) b = bucket_insert(grid, bx, by);
+    }
+    item_link(grid, item, b);
+}
+
+void grid_remove(Grid *grid, int item) {
+    if (item < 0 || item >= GRID_MAX_ITEMS || !grid->present[item]) return;
+    item_unlink(grid, item);
+    grid->present[item] = 0;
+    grid->count--;
+}
+
+/**
+ * @brief Distancia² entre (x0, y0) y (x1, y1) sin desbordar con ninguna coordenada int: cada cuadrado cabe en un
+ * unsigned long long y la suma se satura (sólo ocurre entre extremos opuestos del rango de int).
+ */
+static unsigned long long squared_distance(int x0, int y0, int x1, int y1) {
+    long long dx = (long long)x0 - x1, dy = (long long)y0 - y1;
+    unsigned long long sx = (unsigned long long)(dx < 0 ? -dx : dx), sy = (unsigned long long)(dy < 0 ? -dy : dy);
+    unsigned long long d2 = sx * sx + sy * sy;
+    return d2 < sx * sx ? ULLONG_MAX : d2;
+}
+
+/** @brief Recorta a int un extremo calculado en long long (x ± r cerca de INT_MAX o INT_MIN). */
+static int clamp_int(long long v) {
+    return v < INT_MIN ? INT_MIN : v > INT_MAX ? INT_MAX : (int)v;
+}
+
+/**
+ * @brief Recorre los elementos del rectángulo [x0, x1] x [y0, y1] que además estén a distancia² <= r2 de (cx, cy)
+ * (r2 < 0 desactiva el filtro). Si el rectángulo cubre más cubetas que elementos hay, recorre los elementos.
+ */
+static int scan(const Grid *grid, int x0, int y0, int x1, int y1, int cx, int cy, long long r2, int *out, int max) {
+    int found = 0;
+    int bx0 = x0 >> GRID_SHIFT, bx1 = x1 >> GRID_SHIFT;
+    int by0 = y0 >> GRID_SHIFT, by1 = y1 >> GRID_SHIFT;
+    long span = ((long)bx1 - bx0 + 1) * ((long)by1 - by0 + 1);
+
+    if (span > grid->count) {
+        for (int item = 0; item < GRID_MAX_ITEMS; item++) {
+            if (!grid->present[item]) continue;
+            int x = grid->x[item], y = grid->y[item];
+            if (x < x0 || x > x1 || y < y0 || y > y1) continue;
+            if (r2 >= 0 && squared_distance(x, y, cx, cy) > (unsigned long long)r2) continue;
+            if (found < max) out[found] = item;
+            found++;
+        }
+        return found;
+    }
+
+    for (int by = by0; by <= by1; by++) {
+        for (int bx = bx0; bx <= bx1; bx++) {
+            int b = bucket_find(grid, bx, by);
+            if (b < 0) continue;
+            for (int item = grid->buckets[b].head; item >= 0; item = grid->next[item]) {
+                int x = grid->x[item], y = grid->y[item];
+                if (x < x0 || x > x1 || y < y0 || y > y1) continue;
+                if (r2 >= 0 && squared_distance(x, y, cx, cy) > (unsigned long long)r2) continue;
+                if (found < max) out[found] = item;
+                found++;
+            }
+        }
+    }
+    return found;
+}
+
+/**
+ * @brief Elementos a distancia euclídea <= r de (x, y).
+ * @param out Array donde se guardan hasta max elementos encontrados.
+ * @return Número total de elementos encontrados (puede ser mayor que max).
+ */
+int grid_query_radius(const Grid *grid, int x, int y, int r, int *out, int max) {
+    if (r < 0) return 0;
+    return scan(grid, clamp_int((long long)x - r), clamp_int((long long)y - r), clamp_int((long long)x + r),
+                clamp_int((long long)y + r), x, y, (long long)r * r, out, max);
+}
+
+/**
+ * @brief Elementos dentro del rectángulo de esquinas (x0, y0) y (x1, y1), ambas incluidas y en cualquier orden.
+ * @return Número total de elementos encontrados (puede ser mayor que max).
+ */
+int grid_query_rect(const Grid *grid, int x0, int y0, int x1, int y1, int *out, int max) {
+    if (x0 > x1) { int t = x0; x0 = x1; x1 = t; }
+    if (y0 > y1) { int t = y0; y0 = y1; y1 = t; }
+    return scan(grid, x0, y0, x1, y1, 0, 0, -1, out, max);
+}
+
+static int candidate_cmp(const void *a, const void *b) {
+    const GridCandidate *ca = a, *cb = b;
+    if (ca->dist2 != cb->dist2) return ca->dist2 < cb->dist2 ? -1 : 1;
+    return ca->item - cb->item;
+}
+
+static int add_bucket(const Grid *grid, int bx, int by, int x, int y, GridCandidate *cand, int n) {
+    int b = bucket_find(grid, bx, by);
+    if (b < 0) return n;
+    for (int item = grid->buckets[b].head; item >= 0; item = grid->next[item]) {
+        cand[n].dist2 = squared_distance(grid->x[item], grid->y[item], x, y);
+        cand[n].item = item;
+        n++;
+    }
+    return n;
+}
+
+/**
+ * @brief Los k elementos más cercanos a (x, y), ordenados por distancia (los empates, por número de elemento).
+ * Recorre anillos de cubetas alrededor de (x, y) hasta que ningún anillo posterior pueda mejorar el k-ésimo;
+ * si los elementos están tan dispersos que los anillos salen caros, los ordena todos.
+ * @param out Array con espacio para k elementos.
+ * @return Número de elementos devueltos (min(k, elementos presentes)).
+ */
+int grid_query_knn(const Grid *grid, int x, int y, int k, int *out) {
+    static GridCandidate cand[GRID_MAX_ITEMS];
+    int n = 0;
+    if (k <= 0 || grid->count == 0) return 0;
+    if (k > grid->count) k = grid->count;
+
+    int bx = x >> GRID_SHIFT, by = y >> GRID_SHIFT;
+    for (long d = 0; ; d++) {
+        if ((2 * d + 1) * (2 * d + 1) > 4L * grid->count + 16) {
+            n = 0;
+            for (int item = 0; item < GRID_MAX_ITEMS; item++) {
+                if (!grid->present[item]) continue;
+                cand[n].dist2 = squared_distance(grid->x[item], grid->y[item], x, y);
+                cand[n].item = item;
+                n++;
+            }
+            qsort(cand, n, sizeof(GridCandidate), candidate_cmp);
+            break;
+        }
+
+        // Anillo de cubetas a distancia de Chebyshev d de la cubeta de (x, y)
+        for (long dy = -d; dy <= d; dy++) {
+            long step = (dy == -d || dy == d) ? 1 : 2 * d;
+            for (long dx = -d; dx <= d; dx += step) {
+                n = add_bucket(grid, (int)(bx + dx), (int)(by + dy), x, y, cand, n);
+            }
+        }
+
+        if (n >= k) {
+            // Todo elemento de un anillo posterior está al menos a d * GRID_SIZE + 1 en algún eje
+            qsort(cand, n, sizeof(GridCandidate), candidate_cmp);
+            long bound = d * GRID_SIZE + 1;
+            if (cand[k - 1].dist2 <= (unsigned long long)(bound * bound)) break;
+        }
+    }
+
+    for (int i = 0; i < k; i++) out[i] = cand[i].item;
+    return k;
+}
@@ -0,0 +1,46 @@
+/**
+ * @file grid.h
+ * @brief Índice espacial de Ursula: rejilla uniforme de cubetas de GRID_SIZE x GRID_SIZE celdas.
+ *
+ * Cada barco (identificado por su ranura en la tabla de Ursula) está enlazado en la lista de su cubeta; las
+ * cubetas viven en una tabla hash, así que el mapa puede ser arbitrariamente grande. Mover un barco cuesta O(1)
+ * y las consultas sólo recorren las cubetas que tocan el área pedida.
+ */
+
+#ifndef GRID_H
+#define GRID_H
+
+#include "world.h"
+
+#define GRID_SHIFT 3                    // Cubetas de 8x8 celdas
+#define GRID_SIZE (1 << GRID_SHIFT)
+#define GRID_MAX_ITEMS WORLD_MAX_SHIPS
+#define GRID_BUCKETS 4096               // Potencia de dos, holgada respecto a GRID_MAX_ITEMS
+
+typedef struct {
+    int bx;
+    int by;
+    int head;       // Primer elemento de la cubeta, -1 si está vacía
+    int used;       // Ranura ocupada (una cubeta vaciada conserva su ranura hasta la siguiente reconstrucción)
+} GridBucket;
+
+typedef struct {
+    GridBucket buckets[GRID_BUCKETS];
+    int bucket_used;
+    int count;
+    int present[GRID_MAX_ITEMS];
+    int x[GRID_MAX_ITEMS];
+    int y[GRID_MAX_ITEMS];
+    int bucket[GRID_MAX_ITEMS];
+    int next[GRID_MAX_ITEMS];
+    int prev[GRID_MAX_ITEMS];
+} Grid;
+
+void grid_init(Grid *grid);
+void grid_place(Grid *grid, int item, int x, int y);
+void grid_remove(Grid *grid, int item);
+int grid_query_radius(const Grid *grid, int x, int y, int r, int *out, int max);
+int grid_query_rect(const Grid *grid, int x0, int y0, int x1, int y1, int *out, int max);
+int grid_query_knn(const Grid *grid, int x, int y, int k, int *out);
+
+#endif
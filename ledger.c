@@ -0,0 +1,131 @@
+#include <stdio.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "ledger.h"
+#include "world.h"
+
+#define LEDGER_OPEN_RETRIES 1000
+
+// Nombre del segmento del libro: el del estado compartido del fichero de federación, con sufijo
+static int ledger_name(const char *federation, char *name, int len) {
+    if (world_shm_name(federation, name, len) != 0) return -1;
+    size_t n = strlen(name);
+    if (n + sizeof(".ledger") > (size_t)len) return -1;
+    strcpy(name + n, ".ledger");
+    return 0;
+}
+
+// 1 si alguna cuenta pertenece a una Ursula viva distinta de la llamante
+static int has_live_members(const Ledger *ledger) {
+    for (int i = 0; i < LEDGER_MAX_ACCOUNTS; i++) {
+        pid_t pid = __atomic_load_n(&ledger->accounts[i].ursula_pid, __ATOMIC_ACQUIRE);
+        if (pid <= 0 || pid == getpid()) continue;
+        if (kill(pid, 0) == 0 || errno != ESRCH) return 1;
+    }
+    return 0;
+}
+
+/**
+ * @brief Se adhiere al libro de la federación, creándolo con saldo initial si es la primera Ursula.
+ * Un libro abandonado por una federación anterior (ninguna de sus Ursulas sigue viva) se reinicia.
+ * @param federation Ruta del fichero de federación (da nombre al segmento).
+ * @param account Cuenta de la región de la llamante (su posición en el fichero de federación).
+ * @return El libro proyectado, o NULL en caso de error.
+ */
+Ledger* ledger_join(const char *federation, int account, int initial) {
+    char name[NAME_MAX];
+    struct stat st;
+    if (account < 0 || account >= LEDGER_MAX_ACCOUNTS) return NULL;
+    if (ledger_name(federation, name, sizeof(name)) != 0 || strlen(name) >= sizeof(((Ledger *)0)->name)) return NULL;
+
+    int created = 1;
+    int fd = shm_open(name, O_CREAT | O_EXCL | O_RDWR, 0666);
+    if (fd == -1 && errno == EEXIST) {
+        created = 0;
+        fd = shm_open(name, O_RDWR, 0);
+    }
+    if (fd == -1) return NULL;
+
+    if (created && ftruncate(fd, sizeof(Ledger)) == -1) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    // Quien lo crea puede no haber fijado aún el tamaño: se espera un poco antes de proyectarlo
+    for (int i = 0; !created && i < LEDGER_OPEN_RETRIES; i++) {
+        if (fstat(fd, &st) == 0 && (size_t)st.st_size >= sizeof(Ledger)) break;
+        sched_yield();
+    }
+
+    Ledger *ledger = mmap(NULL, sizeof(Ledger), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ledger == MAP_FAILED) return NULL;
+
+    if (created) {
+        ledger->balance = initial;
+        ledger->initial = initial;
+        strcpy(ledger->name, name);
+        __atomic_store_n(&ledger->magic, LEDGER_MAGIC, __ATOMIC_RELEASE);
+    } else {
+        for (int i = 0; i < LEDGER_OPEN_RETRIES && __atomic_load_n(&ledger->magic, __ATOMIC_ACQUIRE) != LEDGER_MAGIC; i++) {
+            sched_yield();
+        }
+        if (__atomic_load_n(&ledger->magic, __ATOMIC_ACQUIRE) != LEDGER_MAGIC) {
+            munmap(ledger, sizeof(Ledger));
+            return NULL;
+        }
+        if (!has_live_members(ledger)) {
+            // Restos de una federación que terminó mal: se abre un libro nuevo
+            memset(ledger->accounts, 0, sizeof(ledger->accounts));
+            __atomic_store_n(&ledger->members, 0, __ATOMIC_RELAXED);
+            __atomic_store_n(&ledger->balance, initial, __ATOMIC_RELEASE);
+            ledger->initial = initial;
+        }
+    }
+
+    LedgerAccount *acc = &ledger->accounts[account];
+    acc->deposits = 0;
+    acc->withdrawals = 0;
+    __atomic_store_n(&acc->ursula_pid, getpid(), __ATOMIC_RELEASE);
+    __atomic_add_fetch(&ledger->members, 1, __ATOMIC_ACQ_REL);
+    return ledger;
+}
+
+/** @brief Abandona el libro; la última Ursula en salir retira el segmento. */
+void ledger_leave(Ledger *ledger, int account) {
+    if (!ledger) return;
+    __atomic_store_n(&ledger->accounts[account].ursula_pid, 0, __ATOMIC_RELEASE);
+    if (__atomic_sub_fetch(&ledger->members, 1, __ATOMIC_ACQ_REL) == 0) shm_unlink(ledger->name);
+    munmap(ledger, sizeof(Ledger));
+}
+
+/** @brief Ingresa amount en el tesoro común a cuenta de la región account. */
+void ledger_deposit(Ledger *ledger, int account, int amount) {
+    __atomic_add_fetch(&ledger->accounts[account].deposits, amount, __ATOMIC_RELAXED);
+    __atomic_add_fetch(&ledger->balance, amount, __ATOMIC_ACQ_REL);
+}
+
+/**
+ * @brief Retira amount del tesoro común a cuenta de la región account, sólo si el saldo lo cubre.
+ * @return 0 en caso de éxito, -1 si el saldo es insuficiente (no se retira nada).
+ */
+int ledger_withdraw(Ledger *ledger, int account, int amount) {
+    int32_t balance = __atomic_load_n(&ledger->balance, __ATOMIC_ACQUIRE);
+    do {
+        if (balance < amount) return -1;
+    } while (!__atomic_compare_exchange_n(&ledger->balance, &balance, balance - amount, 1, __ATOMIC_ACQ_REL,
+                                          __ATOMIC_ACQUIRE));
+    __atomic_add_fetch(&ledger->accounts[account].withdrawals, amount, __ATOMIC_RELAXED);
+    return 0;
+}
+
+int ledger_balance(const Ledger *ledger) {
+    return __atomic_load_n(&ledger->balance, __ATOMIC_ACQUIRE);
+}
@@ -0,0 +1,40 @@
+/**
+ * @file ledger.h
+ * @brief Tesoro común de una federación de Ursulas, en memoria compartida.
+ *
+ * Cada Ursula de la federación anota en su propia cuenta lo que ingresa (impuestos) y lo que paga (subsidios),
+ * y el saldo común se actualiza con operaciones atómicas: un subsidio sólo se cobra si el saldo lo cubre,
+ * sin cerrojos entre regiones.
+ */
+
+#ifndef LEDGER_H
+#define LEDGER_H
+
+#include <stdint.h>
+
+#define LEDGER_MAGIC 0x4c454447u  // "LEDG"
+#define LEDGER_MAX_ACCOUNTS 16
+
+typedef struct {
+    int32_t ursula_pid;         // 0 si la cuenta no está en uso
+    int32_t deposits;
+    int32_t withdrawals;
+    int32_t reserved;
+} LedgerAccount;
+
+typedef struct {
+    uint32_t magic;
+    int32_t members;            // Ursulas adheridas; la última en salir retira el segmento
+    int32_t balance;            // Saldo común del tesoro
+    int32_t initial;            // Saldo con el que se abrió el libro
+    char name[240];
+    LedgerAccount accounts[LEDGER_MAX_ACCOUNTS];
+} Ledger;
+
+Ledger* ledger_join(const char *federation, int account, int initial);
+void ledger_leave(Ledger *ledger, int account);
+void ledger_deposit(Ledger *ledger, int account, int amount);
+int ledger_withdraw(Ledger *ledger, int account, int amount);
+int ledger_balance(const Ledger *ledger);
+
+#endif
@@ -1,20 +1,148 @@
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
 #include "map.h"
 
+#define MAP_TILE_VERSION 1
+#define MAP_TILE_ALIGN 4096
+
+// Cabecera en disco del formato teselado. Le sigue (en index_offset) una tabla de
+// tiles_x * tiles_y desplazamientos de 64 bits, uno por tesela en orden de filas.
+// Cada tesela son tile_size * tile_size bytes con la misma leyenda que el mapa de texto.
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t tile_size;
+    uint32_t tiles_x;
+    uint32_t tiles_y;
+    uint32_t reserved;
+    uint64_t index_offset;
+} MapTileHeader;
+
+#define MAP_BIN_VERSION 1
+#define MAP_BIN_MAX_LAYERS 4
+
+// Capas del formato binario
+enum {
+    MAP_LAYER_PACKED = 1,   // 2 bits por celda, filas de (width + 3) / 4 bytes
+    MAP_LAYER_ROWS = 2,     // RLE: height + 1 índices (uint64) al primer tramo de cada fila
+    MAP_LAYER_RUNS = 3      // RLE: tramos uint32 (columna_inicial << 2 | código)
+};
+
+typedef struct {
+    uint32_t kind;
+    uint32_t reserved;
+    uint64_t offset;
+    uint64_t size;
+} MapBinLayer;
+
+// Cabecera en disco del formato binario (.mapb). El checksum es FNV-1a de las capas en el orden de la tabla.
+typedef struct {
+    char magic[4];
+    uint32_t version;
+    uint32_t width;
+    uint32_t height;
+    uint32_t flags;
+    uint32_t layer_count;
+    uint64_t checksum;
+    MapBinLayer layers[MAP_BIN_MAX_LAYERS];
+} MapBinHeader;
+
+struct MapBin {
+    char *base;
+    size_t length;
+    const uint8_t *packed;  // Capa empaquetada (NULL si el mapa usa RLE)
+    size_t stride;
+    const uint64_t *rows;   // Índice de filas RLE
+    const uint32_t *runs;   // Tramos RLE
+    uint64_t run_count;
+};
+
+// Código de 2 bits -> símbolo del terreno
+static const char bin_symbols[4] = {WATER, ROCK, PORT, ISLAND};
+
+typedef struct {
+    uint64_t id;
+    char *base;             // Dirección devuelta por mmap
+    size_t length;          // Longitud proyectada
+    char *data;             // Primer byte de la tesela dentro de la proyección
+    unsigned long last_used;
+} TileSlot;
+
+struct MapTiles {
+    int fd;
+    uint32_t tile_size;
+    uint32_t tiles_x;
+    uint32_t tiles_y;
+    size_t tile_bytes;
+    uint64_t *index;
+    TileSlot slots[MAP_TILE_CACHE];
+    int resident;
+    int last_slot;
+    unsigned long clock;
+};
+
+// Tabla hash (direccionamiento abierto) celda -> número de barcos marcados en ella
+struct MapMarks {
+    uint64_t *keys;         // Índice de celda + 1 (0 = hueco libre)
+    int *counts;
+    size_t capacity;
+    size_t used;
+};
+
+// Componentes conexas de las celdas navegables (vecindad de 4, como los movimientos de los barcos)
+struct MapComponents {
+    uint32_t *label;        // Componente de cada celda (1..count), 0 en roca; NULL si el mapa es demasiado grande
+    int count;
+    int *ports;             // Puertos de cada componente (índice 1..count)
+    int *islands;           // Islas de cada componente
+};
+
+static Map* map_load_text(FILE *f);
+static Map* map_load_tiled(int fd);
+static Map* map_load_binary(int fd);
+static void map_freeze_text(Map *map);
+
+static uint64_t cell_index(Map *map, int x, int y) {
+    return (uint64_t)y * (uint64_t)map->width + (uint64_t)x;
+}
+
+static int in_bounds(Map *map, int x, int y) {
+    return x >= 0 && x < map->width && y >= 0 && y < map->height;
+}
+
 Map* map_load(const char *filename) {
-    FILE *f = fopen(filename, "r");
-    if (!f) return NULL;
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) return NULL;
+
+    // Detectamos el formato por los primeros bytes del fichero
+    char magic[4];
+    if (pread(fd, magic, sizeof(magic), 0) == (ssize_t)sizeof(magic)) {
+        if (memcmp(magic, MAP_TILE_MAGIC, sizeof(magic)) == 0) return map_load_tiled(fd);
+        if (memcmp(magic, MAP_BIN_MAGIC, sizeof(magic)) == 0) return map_load_binary(fd);
+    }
+
+    FILE *f = fdopen(fd, "r");
+    if (!f) {
+        close(fd);
+        return NULL;
+    }
+    return map_load_text(f);
+}
 
-    Map *map = malloc(sizeof(Map));
+static Map* map_load_text(FILE *f) {
+    Map *map = calloc(1, sizeof(Map));
     if (!map) {
         fclose(f);
         return NULL;
     }
-    map->height = 0;
-    map->width = 0;
-    map->data = NULL;
 
     char *line = NULL;
     size_t len = 0;
@@ -26,16 +154,23 @@ Map* map_load(const char *filename) {
         if (read > 0 && line[read - 1] == '\n') {
             line[read - 1] = '\0';
         }
-        
-        int current_width = strlen(line);
+
+        size_t current_width = strlen(line);
         if (current_width > 0) {
-            
+
             // Si es la primera línea, definimos el ancho del mapa
             if (map->height == 0) {
-                map->width = current_width;
-            } 
+                if (current_width > MAP_MAX_DIM) {
+                    fprintf(stderr, "Error: El mapa es demasiado ancho (%zu columnas)\n", current_width);
+                    free(line);
+                    map_destroy(map);
+                    fclose(f);
+                    return NULL;
+                }
+                map->width = (int)current_width;
+            }
             // Si no es la primera, verificamos que el ancho coincida
-            else if (current_width != map->width) {
+            else if (current_width != (size_t)map->width) {
                 fprintf(stderr, "Error: Todas las filas deben tener la misma longitud\n");
                 // Limpieza de memoria en caso de error
                 free(line);
@@ -44,6 +179,16 @@ Map* map_load(const char *filename) {
                 return NULL;
             }
 
+            // El mapa de texto vive entero en el heap de cada proceso: rechazamos los que no caben
+            if ((long)(map->height + 1) * map->width > MAP_TEXT_MAX_CELLS) {
+                fprintf(stderr, "Error: El mapa supera %ld celdas; conviértalo al formato teselado\n",
+                        MAP_TEXT_MAX_CELLS);
+                free(line);
+                map_destroy(map);
+                fclose(f);
+                return NULL;
+            }
+
             // Realojamos memoria para añadir la nueva fila
             char **new_data = realloc(map->data, sizeof(char*) * (map->height + 1));
             if (!new_data) {
@@ -63,60 +208,884 @@ Map* map_load(const char *filename) {
 
     free(line);
     fclose(f);
+    map_freeze_text(map);
+    return map;
+}
+
+/**
+ * @brief Pasa las filas de un mapa de texto a un único bloque proyectado de solo lectura. El terreno ya no cambia
+ * (los barcos van en la capa de ocupación), así que cualquier escritura accidental sobre él falla en el acto.
+ * Si no hay memoria para el bloque, el mapa sigue funcionando con las filas sueltas.
+ */
+static void map_freeze_text(Map *map) {
+    size_t length = (size_t)map->width * (size_t)map->height;
+    if (length == 0) return;
+    char *terrain = mmap(NULL, length, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (terrain == MAP_FAILED) return;
+
+    for (int i = 0; i < map->height; i++) {
+        memcpy(terrain + (size_t)i * map->width, map->data[i], map->width);
+        free(map->data[i]);
+        map->data[i] = terrain + (size_t)i * map->width;
+    }
+    mprotect(terrain, length, PROT_READ);
+    map->terrain = terrain;
+}
+
+static Map* map_load_tiled(int fd) {
+    MapTileHeader h;
+    struct stat st;
+
+    if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || fstat(fd, &st) == -1) {
+        fprintf(stderr, "Error: Cabecera de mapa teselado ilegible\n");
+        close(fd);
+        return NULL;
+    }
+
+    uint64_t tiles = (uint64_t)h.tiles_x * h.tiles_y;
+    uint64_t tile_bytes = (uint64_t)h.tile_size * h.tile_size;
+
+    if (h.version != MAP_TILE_VERSION || h.width == 0 || h.height == 0 ||
+        h.width > MAP_MAX_DIM || h.height > MAP_MAX_DIM ||
+        h.tile_size < 8 || h.tile_size > 1024 ||
+        h.tiles_x != (h.width + h.tile_size - 1) / h.tile_size ||
+        h.tiles_y != (h.height + h.tile_size - 1) / h.tile_size ||
+        h.index_offset + tiles * sizeof(uint64_t) > (uint64_t)st.st_size) {
+        fprintf(stderr, "Error: Cabecera de mapa teselado inválida\n");
+        close(fd);
+        return NULL;
+    }
+
+    Map *map = calloc(1, sizeof(Map));
+    MapTiles *t = calloc(1, sizeof(MapTiles));
+    uint64_t *index = malloc(tiles * sizeof(uint64_t));
+    if (!map || !t || !index) {
+        perror("Error reservando memoria para el mapa");
+        free(map);
+        free(t);
+        free(index);
+        close(fd);
+        return NULL;
+    }
+
+    // La tabla de teselas es lo único que se lee al arrancar; los datos se proyectan al tocarlos
+    if (pread(fd, index, tiles * sizeof(uint64_t), (off_t)h.index_offset) != (ssize_t)(tiles * sizeof(uint64_t))) {
+        fprintf(stderr, "Error: Índice de teselas ilegible\n");
+        free(map);
+        free(t);
+        free(index);
+        close(fd);
+        return NULL;
+    }
+    for (uint64_t i = 0; i < tiles; i++) {
+        if (index[i] + tile_bytes > (uint64_t)st.st_size) {
+            fprintf(stderr, "Error: La tesela %llu apunta fuera del fichero\n", (unsigned long long)i);
+            free(map);
+            free(t);
+            free(index);
+            close(fd);
+            return NULL;
+        }
+    }
+
+    t->fd = fd;
+    t->tile_size = h.tile_size;
+    t->tiles_x = h.tiles_x;
+    t->tiles_y = h.tiles_y;
+    t->tile_bytes = (size_t)tile_bytes;
+    t->index = index;
+    t->last_slot = -1;
+
+    map->width = (int)h.width;
+    map->height = (int)h.height;
+    map->tiles = t;
     return map;
 }
 
+static Map* map_load_binary(int fd) {
+    MapBinHeader h;
+    struct stat st;
+
+    if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || fstat(fd, &st) == -1) {
+        fprintf(stderr, "Error: Cabecera de mapa binario ilegible\n");
+        close(fd);
+        return NULL;
+    }
+    if (h.version != MAP_BIN_VERSION || h.width == 0 || h.height == 0 ||
+        h.width > MAP_MAX_DIM || h.height > MAP_MAX_DIM || h.layer_count > MAP_BIN_MAX_LAYERS) {
+        fprintf(stderr, "Error: Cabecera de mapa binario inválida\n");
+        close(fd);
+        return NULL;
+    }
+
+    // Proyectamos el fichero entero: el arranque no depende del tamaño del mapa
+    char *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) {
+        perror("Error proyectando el mapa binario");
+        return NULL;
+    }
+
+    MapBin bin;
+    memset(&bin, 0, sizeof(bin));
+    bin.base = base;
+    bin.length = (size_t)st.st_size;
+    bin.stride = (h.width + 3) / 4;
+
+    int valid = 1;
+    for (uint32_t i = 0; i < h.layer_count && valid; i++) {
+        MapBinLayer *l = &h.layers[i];
+        if (l->offset % sizeof(uint64_t) != 0 || l->offset + l->size > (uint64_t)st.st_size) {
+            valid = 0;
+        } else if (l->kind == MAP_LAYER_PACKED) {
+            valid = l->size == (uint64_t)bin.stride * h.height;
+            bin.packed = (const uint8_t *)(base + l->offset);
+        } else if (l->kind == MAP_LAYER_ROWS) {
+            valid = l->size == ((uint64_t)h.height + 1) * sizeof(uint64_t);
+            bin.rows = (const uint64_t *)(base + l->offset);
+        } else if (l->kind == MAP_LAYER_RUNS) {
+            valid = l->size % sizeof(uint32_t) == 0;
+            bin.runs = (const uint32_t *)(base + l->offset);
+            bin.run_count = l->size / sizeof(uint32_t);
+        }
+    }
+    if (!bin.packed && (!bin.rows || !bin.runs)) valid = 0;
+
+    Map *map = valid ? calloc(1, sizeof(Map)) : NULL;
+    MapBin *b = map ? malloc(sizeof(MapBin)) : NULL;
+    if (!b) {
+        if (!valid) fprintf(stderr, "Error: Capas del mapa binario inválidas\n");
+        else perror("Error reservando memoria para el mapa");
+        free(map);
+        munmap(base, (size_t)st.st_size);
+        return NULL;
+    }
+
+    *b = bin;
+    map->width = (int)h.width;
+    map->height = (int)h.height;
+    map->bin = b;
+    return map;
+}
+
+static char bin_cell(Map *map, int x, int y) {
+    MapBin *b = map->bin;
+    if (b->packed) {
+        uint8_t byte = b->packed[(size_t)y * b->stride + (size_t)(x / 4)];
+        return bin_symbols[(byte >> ((x % 4) * 2)) & 0x3];
+    }
+
+    // Búsqueda binaria del último tramo de la fila que empieza en o antes de x
+    uint64_t lo = b->rows[y];
+    uint64_t hi = b->rows[y + 1];
+    if (lo >= hi || hi > b->run_count || (b->runs[lo] >> 2) > (uint32_t)x) return ROCK;
+    while (hi - lo > 1) {
+        uint64_t mid = lo + (hi - lo) / 2;
+        if ((b->runs[mid] >> 2) <= (uint32_t)x) lo = mid;
+        else hi = mid;
+    }
+    return bin_symbols[b->runs[lo] & 0x3];
+}
+
+/**
+ * @brief Devuelve los datos de una tesela, proyectándola con mmap si no está residente.
+ * Si la caché está llena se desaloja la tesela usada hace más tiempo (LRU).
+ */
+static char* tile_get(MapTiles *t, uint64_t id) {
+    t->clock++;
+
+    // Camino rápido: los barcos suelen consultar repetidamente la misma tesela
+    if (t->last_slot >= 0 && t->slots[t->last_slot].id == id) {
+        t->slots[t->last_slot].last_used = t->clock;
+        return t->slots[t->last_slot].data;
+    }
+
+    int victim = 0;
+    for (int i = 0; i < t->resident; i++) {
+        if (t->slots[i].id == id) {
+            t->slots[i].last_used = t->clock;
+            t->last_slot = i;
+            return t->slots[i].data;
+        }
+        if (t->slots[i].last_used < t->slots[victim].last_used) victim = i;
+    }
+
+    if (t->resident < MAP_TILE_CACHE) {
+        victim = t->resident++;
+    } else {
+        munmap(t->slots[victim].base, t->slots[victim].length);
+    }
+
+    // mmap exige un desplazamiento alineado a página; ajustamos el puntero dentro de la proyección
+    long page = sysconf(_SC_PAGESIZE);
+    uint64_t offset = t->index[id];
+    uint64_t aligned = offset - offset % (uint64_t)page;
+    size_t length = (size_t)(offset - aligned) + t->tile_bytes;
+
+    char *base = mmap(NULL, length, PROT_READ, MAP_SHARED, t->fd, (off_t)aligned);
+    if (base == MAP_FAILED) {
+        perror("Error proyectando tesela del mapa");
+        // El hueco queda libre para el siguiente intento
+        if (victim == t->resident - 1) {
+            t->resident--;
+        } else {
+            t->slots[victim] = t->slots[--t->resident];
+        }
+        t->last_slot = -1;
+        return NULL;
+    }
+
+    t->slots[victim].id = id;
+    t->slots[victim].base = base;
+    t->slots[victim].length = length;
+    t->slots[victim].data = base + (offset - aligned);
+    t->slots[victim].last_used = t->clock;
+    t->last_slot = victim;
+    return t->slots[victim].data;
+}
+
+static char tile_cell(Map *map, int x, int y) {
+    MapTiles *t = map->tiles;
+    uint64_t id = (uint64_t)(y / t->tile_size) * t->tiles_x + (uint64_t)(x / t->tile_size);
+    char *data = tile_get(t, id);
+    if (!data) return 0;
+    return data[(size_t)(y % t->tile_size) * t->tile_size + (size_t)(x % t->tile_size)];
+}
+
+static int *marks_slot(MapMarks *m, uint64_t key, int create) {
+    if (!m->keys) {
+        if (!create) return NULL;
+        m->capacity = 16;
+        m->keys = calloc(m->capacity, sizeof(uint64_t));
+        m->counts = calloc(m->capacity, sizeof(int));
+        if (!m->keys || !m->counts) return NULL;
+    }
+
+    size_t i = (size_t)(key * 0x9E3779B97F4A7C15ULL) & (m->capacity - 1);
+    while (m->keys[i] != 0) {
+        if (m->keys[i] == key + 1) return &m->counts[i];
+        i = (i + 1) & (m->capacity - 1);
+    }
+    if (!create) return NULL;
+
+    // Mantenemos la ocupación por debajo de la mitad rehaciendo la tabla sin las celdas ya vacías
+    if ((m->used + 1) * 2 > m->capacity) {
+        MapMarks grown = {0};
+        grown.capacity = m->capacity * 2;
+        grown.keys = calloc(grown.capacity, sizeof(uint64_t));
+        grown.counts = calloc(grown.capacity, sizeof(int));
+        if (!grown.keys || !grown.counts) {
+            free(grown.keys);
+            free(grown.counts);
+            return NULL;
+        }
+        for (size_t j = 0; j < m->capacity; j++) {
+            if (m->keys[j] != 0 && m->counts[j] > 0) {
+                *marks_slot(&grown, m->keys[j] - 1, 1) = m->counts[j];
+            }
+        }
+        free(m->keys);
+        free(m->counts);
+        *m = grown;
+        return marks_slot(m, key, 1);
+    }
+
+    m->keys[i] = key + 1;
+    m->counts[i] = 0;
+    m->used++;
+    return &m->counts[i];
+}
+
 void map_destroy(Map *map) {
     if (!map) return;
-    // Liberar cada fila individualmente
-    if (map->data) {
+    // Liberar el bloque del terreno o, si no se llegó a crear, cada fila individualmente
+    if (map->terrain) {
+        munmap(map->terrain, (size_t)map->width * (size_t)map->height);
+    }
+    else if (map->data) {
         for (int i = 0; i < map->height; i++) {
             if (map->data[i]) free(map->data[i]);
         }
+    }
+    if (map->data) {
         // Liberar el array de punteros
         free(map->data);
     }
+    // Deshacer las proyecciones de las teselas residentes
+    if (map->tiles) {
+        for (int i = 0; i < map->tiles->resident; i++) {
+            munmap(map->tiles->slots[i].base, map->tiles->slots[i].length);
+        }
+        close(map->tiles->fd);
+        free(map->tiles->index);
+        free(map->tiles);
+    }
+    if (map->bin) {
+        munmap(map->bin->base, map->bin->length);
+        free(map->bin);
+    }
+    if (map->marks) {
+        free(map->marks->keys);
+        free(map->marks->counts);
+        free(map->marks);
+    }
+    if (map->components) {
+        free(map->components->label);
+        free(map->components->ports);
+        free(map->components->islands);
+        free(map->components);
+    }
     // Liberar la estructura principal
     free(map);
 }
 
 int map_can_sail(Map *map, int x, int y) {
-    if (x >= 0 && x < map->width && y >= 0 && y < map->height) {
-        return map->data[y][x] != ROCK;
+    if (in_bounds(map, x, y)) {
+        char cell = map_get_cell_type(map, x, y);
+        return cell != 0 && cell != ROCK;
     }
     return 0;
 }
 
+/** @brief Terreno de la celda (x, y), sin tener en cuenta los barcos. 0 si está fuera del mapa. */
+char map_get_terrain(Map *map, int x, int y) {
+    if (!in_bounds(map, x, y)) return 0;
+    if (map->data) return map->data[y][x];
+    return map->tiles ? tile_cell(map, x, y) : bin_cell(map, x, y);
+}
+
+/** @brief Número de barcos marcados en la celda (x, y). */
+int map_ship_count(Map *map, int x, int y) {
+    if (!map->marks || !in_bounds(map, x, y)) return 0;
+    int *count = marks_slot(map->marks, cell_index(map, x, y), 0);
+    return count ? *count : 0;
+}
+
+/**
+ * @brief Tipo de la celda (x, y): el terreno, o su variante con barco (SHIP, HOME, BAR) si hay al menos uno.
+ * 0 si está fuera del mapa.
+ */
 char map_get_cell_type(Map *map, int x, int y) {
-    if (x >= 0 && x < map->width && y >= 0 && y < map->height) {
-        return map->data[y][x];
+    char terrain = map_get_terrain(map, x, y);
+    if (terrain && map_ship_count(map, x, y) > 0) {
+        if (terrain == WATER) return SHIP;
+        if (terrain == PORT) return HOME;
+        if (terrain == ISLAND) return BAR;
     }
-    return 0;
+    return terrain;
 }
 
+/**
+ * @brief Marca un barco más en la celda (x, y). Las marcas se cuentan en la capa de ocupación, aparte del terreno,
+ * así que varios barcos pueden compartir celda y el que se va no borra la marca de los demás.
+ * @return 1 en caso de éxito, 0 si la celda está fuera del mapa o no hay memoria.
+ */
 int map_set_ship(Map *map, int x, int y) {
-    if (x >= 0 && x < map->width && y >= 0 && y < map->height) {
-        char current = map->data[y][x];
-        if (current == WATER) map->data[y][x] = SHIP;
-        else if (current == PORT) map->data[y][x] = HOME;
-        else if (current == ISLAND) map->data[y][x] = BAR;
-        return 1; // Éxito
-    }
-    return 0; // Fallo (fuera de límites)
+    if (!in_bounds(map, x, y)) return 0;
+    if (!map->marks && !(map->marks = calloc(1, sizeof(MapMarks)))) return 0;
+    int *count = marks_slot(map->marks, cell_index(map, x, y), 1);
+    if (!count) return 0;
+    (*count)++;
+    return 1;
 }
 
+/** @brief Quita la marca de un barco de la celda (x, y). */
 void map_remove_ship(Map *map, int x, int y) {
-    if (x >= 0 && x < map->width && y >= 0 && y < map->height) {
-        char current = map->data[y][x];
-        if (current == SHIP) map->data[y][x] = WATER;
-        else if (current == HOME) map->data[y][x] = PORT;
-        else if (current == BAR) map->data[y][x] = ISLAND;
+    if (!in_bounds(map, x, y)) return;
+    int *count = map->marks ? marks_slot(map->marks, cell_index(map, x, y), 0) : NULL;
+    if (count && *count > 0) (*count)--;
+}
+
+static uint32_t uf_find(uint32_t *parent, uint32_t a) {
+    while (parent[a] != a) {
+        parent[a] = parent[parent[a]];  // Compresión a medias: cada nodo salta a su abuelo
+        a = parent[a];
+    }
+    return a;
+}
+
+/**
+ * @brief Etiqueta las componentes conexas de agua en dos pasadas por filas (union-find): la primera asigna
+ * etiquetas provisionales uniendo cada celda con su vecina de arriba y de la izquierda, la segunda las
+ * renumera de forma compacta y cuenta puertos e islas de cada componente.
+ * @return 0 en caso de éxito, -1 si el mapa es demasiado grande o no hay memoria (components->label queda a NULL).
+ */
+static int components_build(Map *map, MapComponents *c) {
+    size_t w = (size_t)map->width, cells = w * (size_t)map->height;
+    if (cells == 0 || cells > (size_t)MAP_COMPONENT_MAX_CELLS) return -1;
+
+    uint32_t *label = calloc(cells, sizeof(uint32_t));
+    uint32_t *parent = NULL, next = 1;
+    size_t capacity = 0;
+    if (!label) return -1;
+
+    for (int y = 0; y < map->height; y++) {
+        for (int x = 0; x < map->width; x++) {
+            char t = map_get_terrain(map, x, y);
+            if (t == 0 || t == ROCK) continue;
+            size_t i = (size_t)y * w + (size_t)x;
+            uint32_t up = y > 0 ? label[i - w] : 0, left = x > 0 ? label[i - 1] : 0;
+            if (up && left) {
+                uint32_t ru = uf_find(parent, up), rl = uf_find(parent, left);
+                if (ru != rl) parent[ru > rl ? ru : rl] = ru < rl ? ru : rl;
+                label[i] = left;
+            }
+            else if (up || left) {
+                label[i] = up ? up : left;
+            }
+            else {
+                if (next >= capacity) {
+                    size_t grown = capacity ? capacity * 2 : 1024;
+                    uint32_t *p = realloc(parent, grown * sizeof(uint32_t));
+                    if (!p) {
+                        free(parent);
+                        free(label);
+                        return -1;
+                    }
+                    parent = p;
+                    capacity = grown;
+                }
+                parent[next] = next;
+                label[i] = next++;
+            }
+        }
+    }
+
+    // Raíz provisional -> componente definitiva, numeradas en orden de aparición
+    uint32_t *remap = calloc(next, sizeof(uint32_t));
+    c->ports = NULL;
+    c->islands = NULL;
+    c->count = 0;
+    if (!remap) {
+        free(parent);
+        free(label);
+        return -1;
+    }
+    for (uint32_t l = 1; l < next; l++) {
+        uint32_t r = uf_find(parent, l);
+        if (!remap[r]) remap[r] = (uint32_t)++c->count;
     }
+    c->ports = calloc((size_t)c->count + 1, sizeof(int));
+    c->islands = calloc((size_t)c->count + 1, sizeof(int));
+    if (!c->ports || !c->islands) {
+        free(c->ports);
+        free(c->islands);
+        free(remap);
+        free(parent);
+        free(label);
+        return -1;
+    }
+    for (int y = 0; y < map->height; y++) {
+        for (int x = 0; x < map->width; x++) {
+            size_t i = (size_t)y * w + (size_t)x;
+            if (!label[i]) continue;
+            label[i] = remap[uf_find(parent, label[i])];
+            char t = map_get_terrain(map, x, y);
+            if (t == PORT) c->ports[label[i]]++;
+            else if (t == ISLAND) c->islands[label[i]]++;
+        }
+    }
+
+    free(remap);
+    free(parent);
+    c->label = label;
+    return 0;
+}
+
+// Las componentes se calculan una vez, en la primera consulta: los procesos que no preguntan no pagan nada
+static MapComponents *components_get(Map *map) {
+    if (!map->components) {
+        map->components = calloc(1, sizeof(MapComponents));
+        if (map->components) components_build(map, map->components);
+    }
+    return map->components && map->components->label ? map->components : NULL;
+}
+
+/**
+ * @brief Componente conexa de agua de la celda (x, y).
+ * @return Su número (1 o más), 0 si la celda es roca o está fuera del mapa, o -1 si el mapa es demasiado grande
+ * para etiquetarlo (ver MAP_COMPONENT_MAX_CELLS).
+ */
+int map_component(Map *map, int x, int y) {
+    if (!map_can_sail(map, x, y)) return 0;
+    MapComponents *c = components_get(map);
+    if (!c) return -1;
+    return (int)c->label[cell_index(map, x, y)];
+}
+
+/**
+ * @brief Indica si un barco puede llegar navegando de (x0, y0) a (x1, y1), sin contar con otros barcos.
+ * Si las componentes no están disponibles sólo se comprueba que ambas celdas sean navegables.
+ * @return 1 si están en la misma componente, 0 si no.
+ */
+int map_same_component(Map *map, int x0, int y0, int x1, int y1) {
+    int a = map_component(map, x0, y0), b = map_component(map, x1, y1);
+    if (a == 0 || b == 0) return 0;
+    return a == -1 || b == -1 || a == b;
+}
+
+/** @return Puertos de la componente, o -1 si no existe o las componentes no están disponibles. */
+int map_component_ports(Map *map, int component) {
+    MapComponents *c = components_get(map);
+    if (!c || component < 1 || component > c->count) return -1;
+    return c->ports[component];
+}
+
+/** @return Islas de la componente, o -1 si no existe o las componentes no están disponibles. */
+int map_component_islands(Map *map, int component) {
+    MapComponents *c = components_get(map);
+    if (!c || component < 1 || component > c->count) return -1;
+    return c->islands[component];
 }
 
 void map_print(Map *map) {
-    if (!map || !map->data) return;
-    for (int i = 0; i < map->height; i++) {
-        fprintf(stderr, "%s\n", map->data[i]);
+    if (!map) return;
+    if ((long)map->width * map->height > MAP_PRINT_MAX_CELLS) {
+        fprintf(stderr, "[Mapa %dx%d demasiado grande para imprimirlo]\n", map->width, map->height);
+        return;
+    }
+    for (int y = 0; y < map->height; y++) {
+        for (int x = 0; x < map->width; x++) {
+            fputc(map_get_cell_type(map, x, y), stderr);
+        }
+        fputc('\n', stderr);
+    }
+}
+
+static int write_at(FILE *out, uint64_t offset, const void *buf, size_t len) {
+    if (fseeko(out, (off_t)offset, SEEK_SET) != 0) return -1;
+    return fwrite(buf, 1, len, out) == len ? 0 : -1;
+}
+
+/**
+ * @brief Lee la siguiente fila no vacía de un mapa de texto y comprueba que su ancho coincida.
+ * @return 1 si se leyó una fila, 0 al llegar al final del fichero, -1 si el mapa es inválido.
+ */
+static int read_map_row(FILE *in, char **line, size_t *len, uint32_t *width, uint32_t height) {
+    ssize_t read;
+    do {
+        read = getline(line, len, in);
+        if (read == -1) return 0;
+        if (read > 0 && (*line)[read - 1] == '\n') (*line)[--read] = '\0';
+    } while (read == 0);
+
+    if (*width == 0) {
+        if ((size_t)read > MAP_MAX_DIM) {
+            fprintf(stderr, "Error: El mapa es demasiado ancho (%zd columnas)\n", read);
+            return -1;
+        }
+        *width = (uint32_t)read;
+    } else if ((uint32_t)read != *width) {
+        fprintf(stderr, "Error: Todas las filas deben tener la misma longitud\n");
+        return -1;
+    }
+    if (height >= MAP_MAX_DIM) {
+        fprintf(stderr, "Error: El mapa es demasiado alto\n");
+        return -1;
+    }
+    return 1;
+}
+
+/**
+ * @brief Convierte un mapa de texto al formato teselado sin cargarlo entero en memoria.
+ * Se leen tile_size filas cada vez; las teselas uniformes (p.ej. océano abierto) se escriben
+ * una sola vez y el índice las comparte, así que los mundos enormes ocupan poco en disco.
+ * @return 0 si la conversión fue correcta, -1 en caso de error.
+ */
+int map_write_tiled(const char *src, const char *dst, int tile_size) {
+    if (tile_size < 8 || tile_size > 1024) {
+        fprintf(stderr, "Error: Tamaño de tesela inválido (%d)\n", tile_size);
+        return -1;
+    }
+
+    FILE *in = fopen(src, "r");
+    if (!in) return -1;
+    FILE *out = fopen(dst, "w");
+    if (!out) {
+        fclose(in);
+        return -1;
     }
-}
\ No newline at end of file
+
+    size_t ts = (size_t)tile_size;
+    size_t tile_bytes = ts * ts;
+    char *line = NULL;
+    size_t len = 0;
+    int read;
+    char *band = NULL;          // tile_size filas completas del mapa
+    char *tile = malloc(tile_bytes);
+    uint64_t *index = NULL;
+    size_t index_len = 0;
+    uint64_t uniform[256];      // Desplazamiento de la primera tesela uniforme de cada símbolo
+    uint64_t next = MAP_TILE_ALIGN; // La primera página es para la cabecera
+    uint32_t width = 0;
+    uint32_t height = 0;
+    uint32_t tiles_x = 0;
+    int rows_in_band = 0;
+    int ok = tile != NULL;
+    int done = 0;
+
+    memset(uniform, 0, sizeof(uniform));
+
+    while (ok && !done) {
+        read = read_map_row(in, &line, &len, &width, height);
+        if (read < 0) {
+            ok = 0;
+            break;
+        }
+        if (read > 0) {
+            if (!band) {
+                tiles_x = (uint32_t)((width + ts - 1) / ts);
+                band = malloc((size_t)tiles_x * ts * ts);
+                if (!band) {
+                    ok = 0;
+                    break;
+                }
+            }
+
+            // Las columnas sobrantes de la última tesela se rellenan con roca
+            char *row = band + (size_t)rows_in_band * tiles_x * ts;
+            memcpy(row, line, width);
+            memset(row + width, ROCK, (size_t)tiles_x * ts - width);
+            rows_in_band++;
+            height++;
+            if (rows_in_band < tile_size) continue;
+        } else {
+            done = 1;
+            if (rows_in_band == 0) break;
+            // Las filas sobrantes de la última banda también son roca
+            memset(band + (size_t)rows_in_band * tiles_x * ts, ROCK,
+                   (size_t)(tile_size - rows_in_band) * tiles_x * ts);
+        }
+
+        uint64_t *grown = realloc(index, (index_len + tiles_x) * sizeof(uint64_t));
+        if (!grown) {
+            ok = 0;
+            break;
+        }
+        index = grown;
+
+        for (uint32_t tx = 0; tx < tiles_x && ok; tx++) {
+            for (size_t r = 0; r < ts; r++) {
+                memcpy(tile + r * ts, band + r * tiles_x * ts + tx * ts, ts);
+            }
+
+            int is_uniform = 1;
+            for (size_t i = 1; i < tile_bytes && is_uniform; i++) is_uniform = tile[i] == tile[0];
+
+            unsigned char symbol = (unsigned char)tile[0];
+            if (is_uniform && uniform[symbol] != 0) {
+                index[index_len++] = uniform[symbol];
+                continue;
+            }
+            if (write_at(out, next, tile, tile_bytes) != 0) {
+                ok = 0;
+                break;
+            }
+            if (is_uniform) uniform[symbol] = next;
+            index[index_len++] = next;
+            next += (tile_bytes + MAP_TILE_ALIGN - 1) / MAP_TILE_ALIGN * MAP_TILE_ALIGN;
+        }
+        rows_in_band = 0;
+    }
+
+    if (ok && height == 0) {
+        fprintf(stderr, "Error: El mapa %s está vacío\n", src);
+        ok = 0;
+    }
+
+    if (ok) {
+        MapTileHeader h;
+        memset(&h, 0, sizeof(h));
+        memcpy(h.magic, MAP_TILE_MAGIC, sizeof(h.magic));
+        h.version = MAP_TILE_VERSION;
+        h.width = width;
+        h.height = height;
+        h.tile_size = (uint32_t)tile_size;
+        h.tiles_x = tiles_x;
+        h.tiles_y = (uint32_t)((height + ts - 1) / ts);
+        h.index_offset = next;
+        ok = write_at(out, next, index, index_len * sizeof(uint64_t)) == 0 &&
+             write_at(out, 0, &h, sizeof(h)) == 0;
+    }
+
+    free(line);
+    free(band);
+    free(tile);
+    free(index);
+    fclose(in);
+    if (fclose(out) != 0) ok = 0;
+    if (!ok) unlink(dst);
+    return ok ? 0 : -1;
+}
+
+// Símbolo del mapa de texto -> código de 2 bits (las marcas de barco se guardan como su terreno)
+static int bin_code(char c) {
+    switch (c) {
+        case WATER: case SHIP: return 0;
+        case ROCK: return 1;
+        case PORT: case HOME: return 2;
+        case ISLAND: case BAR: return 3;
+        default: return -1;
+    }
+}
+
+static void fnv1a(uint64_t *hash, const void *buf, size_t len) {
+    const unsigned char *p = buf;
+    for (size_t i = 0; i < len; i++) {
+        *hash ^= p[i];
+        *hash *= 1099511628211ULL;
+    }
+}
+
+static int write_layer(FILE *out, uint64_t *hash, const void *buf, size_t len) {
+    fnv1a(hash, buf, len);
+    return fwrite(buf, 1, len, out) == len ? 0 : -1;
+}
+
+/**
+ * @brief Compila un mapa de texto al formato binario (.mapb), fila a fila.
+ * Por defecto las celdas se empaquetan a 2 bits; con MAP_BIN_RLE cada fila se guarda como una
+ * lista de tramos del mismo terreno, lo que reduce las grandes extensiones de agua a unos bytes.
+ * @param flags 0 o MAP_BIN_RLE.
+ * @return 0 si la conversión fue correcta, -1 en caso de error.
+ */
+int map_write_binary(const char *src, const char *dst, int flags) {
+    FILE *in = fopen(src, "r");
+    if (!in) return -1;
+    FILE *out = fopen(dst, "w");
+    if (!out) {
+        fclose(in);
+        return -1;
+    }
+
+    MapBinHeader h;
+    memset(&h, 0, sizeof(h));
+    memcpy(h.magic, MAP_BIN_MAGIC, sizeof(h.magic));
+    h.version = MAP_BIN_VERSION;
+    h.flags = (uint32_t)flags & MAP_BIN_RLE;
+    h.checksum = 14695981039346656037ULL;
+
+    char *line = NULL;
+    size_t len = 0;
+    uint8_t *packed = NULL;     // Una fila empaquetada
+    uint32_t *runs = NULL;      // Tramos de una fila
+    uint64_t *rows = NULL;      // Índice de filas RLE
+    size_t rows_cap = 0;
+    uint64_t run_total = 0;
+    int read;
+    int ok = fseeko(out, MAP_TILE_ALIGN, SEEK_SET) == 0; // La primera página es para la cabecera
+
+    while (ok && (read = read_map_row(in, &line, &len, &h.width, h.height)) != 0) {
+        if (read < 0 || (!packed && !(packed = malloc((h.width + 3) / 4))) ||
+            (!runs && !(runs = malloc(h.width * sizeof(uint32_t))))) {
+            ok = 0;
+            break;
+        }
+
+        size_t stride = (h.width + 3) / 4;
+        size_t run_count = 0;
+        memset(packed, 0, stride);
+        for (uint32_t x = 0; x < h.width; x++) {
+            int code = bin_code(line[x]);
+            if (code < 0) {
+                fprintf(stderr, "Error: Símbolo desconocido '%c' en (%u, %u)\n", line[x], x, h.height);
+                ok = 0;
+                break;
+            }
+            packed[x / 4] |= (uint8_t)(code << ((x % 4) * 2));
+            if (run_count == 0 || (int)(runs[run_count - 1] & 0x3) != code) {
+                runs[run_count++] = (x << 2) | (uint32_t)code;
+            }
+        }
+        if (!ok) break;
+
+        if (h.flags & MAP_BIN_RLE) {
+            if ((size_t)h.height + 2 > rows_cap) {
+                rows_cap = rows_cap ? rows_cap * 2 : 1024;
+                uint64_t *grown = realloc(rows, rows_cap * sizeof(uint64_t));
+                if (!grown) {
+                    ok = 0;
+                    break;
+                }
+                rows = grown;
+            }
+            rows[h.height] = run_total;
+            run_total += run_count;
+            ok = write_layer(out, &h.checksum, runs, run_count * sizeof(uint32_t)) == 0;
+        } else {
+            ok = write_layer(out, &h.checksum, packed, stride) == 0;
+        }
+        h.height++;
+    }
+
+    if (ok && h.height == 0) {
+        fprintf(stderr, "Error: El mapa %s está vacío\n", src);
+        ok = 0;
+    }
+
+    if (ok && (h.flags & MAP_BIN_RLE)) {
+        // Tramos primero (se escribieron en streaming), después el índice de filas alineado a 8 bytes
+        uint64_t runs_size = run_total * sizeof(uint32_t);
+        uint64_t rows_offset = (MAP_TILE_ALIGN + runs_size + 7) / 8 * 8;
+        uint64_t padding = 0;
+        rows[h.height] = run_total;
+
+        h.layer_count = 2;
+        h.layers[0].kind = MAP_LAYER_RUNS;
+        h.layers[0].offset = MAP_TILE_ALIGN;
+        h.layers[0].size = runs_size;
+        h.layers[1].kind = MAP_LAYER_ROWS;
+        h.layers[1].offset = rows_offset;
+        h.layers[1].size = ((uint64_t)h.height + 1) * sizeof(uint64_t);
+        ok = fwrite(&padding, 1, rows_offset - MAP_TILE_ALIGN - runs_size, out) ==
+                 rows_offset - MAP_TILE_ALIGN - runs_size &&
+             write_layer(out, &h.checksum, rows, h.layers[1].size) == 0;
+    } else if (ok) {
+        h.layer_count = 1;
+        h.layers[0].kind = MAP_LAYER_PACKED;
+        h.layers[0].offset = MAP_TILE_ALIGN;
+        h.layers[0].size = (uint64_t)((h.width + 3) / 4) * h.height;
+    }
+
+    if (ok) ok = write_at(out, 0, &h, sizeof(h)) == 0;
+
+    free(line);
+    free(packed);
+    free(runs);
+    free(rows);
+    fclose(in);
+    if (fclose(out) != 0) ok = 0;
+    if (!ok) unlink(dst);
+    return ok ? 0 : -1;
+}
+
+/**
+ * @brief Recalcula el checksum de las capas de un mapa binario y lo compara con el de la cabecera.
+ * map_load no lo hace para que el arranque siga siendo una simple proyección.
+ * @return 0 si el mapa es íntegro, -1 si está corrupto o no se puede leer.
+ */
+int map_verify_binary(const char *filename) {
+    int fd = open(filename, O_RDONLY);
+    if (fd == -1) return -1;
+
+    MapBinHeader h;
+    struct stat st;
+    if (pread(fd, &h, sizeof(h), 0) != (ssize_t)sizeof(h) || fstat(fd, &st) == -1 ||
+        memcmp(h.magic, MAP_BIN_MAGIC, sizeof(h.magic)) != 0 || h.layer_count > MAP_BIN_MAX_LAYERS) {
+        close(fd);
+        return -1;
+    }
+
+    char *base = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (base == MAP_FAILED) return -1;
+
+    uint64_t hash = 14695981039346656037ULL;
+    int ok = 1;
+    for (uint32_t i = 0; i < h.layer_count && ok; i++) {
+        if (h.layers[i].offset + h.layers[i].size > (uint64_t)st.st_size) ok = 0;
+        else fnv1a(&hash, base + h.layers[i].offset, (size_t)h.layers[i].size);
+    }
+    munmap(base, (size_t)st.st_size);
+    return ok && hash == h.checksum ? 0 : -1;
+}
@@ -15,11 +15,37 @@
 #define HOME 'H'
 #define BAR 'B'
 
-// Estructura que representa el mapa
+// Límites de tamaño. Un mapa de texto se carga entero en memoria de cada proceso,
+// así que los mundos grandes deben convertirse al formato teselado.
+#define MAP_MAX_DIM 1000000
+#define MAP_TEXT_MAX_CELLS (4096L * 4096L)
+#define MAP_PRINT_MAX_CELLS (256L * 256L)
+#define MAP_COMPONENT_MAX_CELLS (4096L * 4096L)   // Más allá no se etiquetan las componentes (4 bytes por celda)
+
+// Mapa teselado: teselas cuadradas indexadas en una cabecera y proyectadas con mmap bajo demanda
+#define MAP_TILE_MAGIC "MAPT"
+#define MAP_TILE_DEFAULT_SIZE 64
+#define MAP_TILE_CACHE 64
+
+// Mapa binario precompilado (.mapb): celdas empaquetadas a 2 bits, o por tramos (RLE), proyectado entero con mmap
+#define MAP_BIN_MAGIC "MAPB"
+#define MAP_BIN_RLE 0x1
+
+typedef struct MapTiles MapTiles;
+typedef struct MapBin MapBin;
+typedef struct MapMarks MapMarks;
+typedef struct MapComponents MapComponents;
+
+// Estructura que representa el mapa: el terreno (inmutable tras cargarlo) y, aparte, la ocupación
 typedef struct {
-    char **data;
-    int width;      
-    int height;    
+    char **data;        // Filas del terreno en modo texto, sin terminador (NULL en los demás modos)
+    int width;
+    int height;
+    char *terrain;      // Bloque de solo lectura al que apuntan las filas de data (NULL si no se pudo crear)
+    MapTiles *tiles;    // Teselas residentes en modo teselado (NULL en otro modo)
+    MapBin *bin;        // Proyección del mapa binario (NULL en otro modo)
+    MapMarks *marks;    // Capa de ocupación: número de barcos por celda, en todos los modos
+    MapComponents *components;  // Componentes conexas de agua, calculadas en la primera consulta (NULL hasta entonces)
 } Map;
 
 // Funciones públicas
@@ -27,8 +53,17 @@ Map* map_load(const char *filename);
 void map_destroy(Map *map);
 int map_can_sail(Map *map, int x, int y);
 char map_get_cell_type(Map *map, int x, int y);
+char map_get_terrain(Map *map, int x, int y);
+int map_ship_count(Map *map, int x, int y);
+int map_component(Map *map, int x, int y);
+int map_same_component(Map *map, int x0, int y0, int x1, int y1);
+int map_component_ports(Map *map, int component);
+int map_component_islands(Map *map, int component);
 int map_set_ship(Map *map, int x, int y);
 void map_remove_ship(Map *map, int x, int y);
 void map_print(Map *map); // Para imprimirlo en stderr (debug)
+int map_write_tiled(const char *src, const char *dst, int tile_size);
+int map_write_binary(const char *src, const char *dst, int flags);
+int map_verify_binary(const char *filename);
 
-#endif
\ No newline at end of file
+#endif
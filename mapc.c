@@ -0,0 +1,76 @@
+/*
+ * @file mapc.c
+ * @brief Compilador de mapas: convierte un mapa de texto a los formatos binario (.mapb) o teselado.
+ *
+ * Los procesos cargan estos formatos con map_load proyectándolos con mmap, sin parsear texto
+ * al arrancar. El formato se detecta automáticamente por la cabecera del fichero.
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "map.h"
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s [--rle | --tiled [tamaño]] <mapa.txt> <salida>\n", prog);
+    fprintf(stderr, "     %s --verify <mapa.mapb>\n", prog);
+}
+
+int main(int argc, char *argv[]) {
+    int flags = 0;
+    int tile_size = 0;
+    char *verify = NULL;
+    char *src = NULL;
+    char *dst = NULL;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--rle") == 0) {
+            flags |= MAP_BIN_RLE;
+        }
+        else if (strcmp(argv[i], "--tiled") == 0) {
+            tile_size = MAP_TILE_DEFAULT_SIZE;
+            // El tamaño de tesela es opcional
+            if (i + 1 < argc && argv[i + 1][0] >= '0' && argv[i + 1][0] <= '9') tile_size = atoi(argv[++i]);
+        }
+        else if (strcmp(argv[i], "--verify") == 0 && i + 1 < argc) {
+            verify = argv[++i];
+        }
+        else if (!src) src = argv[i];
+        else if (!dst) dst = argv[i];
+        else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+
+    if (verify) {
+        if (map_verify_binary(verify) != 0) {
+            fprintf(stderr, "[mapc] %s está corrupto o no es un mapa binario.\n", verify);
+            return EXIT_FAILURE;
+        }
+        fprintf(stderr, "[mapc] %s: checksum correcto.\n", verify);
+        return EXIT_SUCCESS;
+    }
+
+    if (!src || !dst || (tile_size && flags)) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+
+    int result = tile_size ? map_write_tiled(src, dst, tile_size) : map_write_binary(src, dst, flags);
+    if (result != 0) {
+        fprintf(stderr, "[mapc] No se pudo convertir %s a %s.\n", src, dst);
+        return EXIT_FAILURE;
+    }
+
+    // Comprobamos que el resultado se carga como cualquier otro mapa
+    Map *map = map_load(dst);
+    if (!map) {
+        fprintf(stderr, "[mapc] %s se escribió pero no se puede cargar.\n", dst);
+        return EXIT_FAILURE;
+    }
+    fprintf(stderr, "[mapc] %s -> %s (%dx%d, %s).\n", src, dst, map->width, map->height,
+            tile_size ? "teselado" : (flags & MAP_BIN_RLE) ? "binario RLE" : "binario empaquetado");
+    map_destroy(map);
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,439 @@
+/*
+ * @file montecarlo.c
+ * @brief Simulador por lotes de la economía del mar: miles de partidas independientes en paralelo.
+ *
+ * Cada partida reproduce en memoria, sin procesos ni mensajes, el modo aleatorio con el reloj de la flota (--clock):
+ * cada barco da un paso al azar cada `speed` tics gastando 5 de comida y vuelve a puerto tras sus pasos. Los pasos se
+ * aplican a un motor de Ursula (libursula, engine.h) en modo por turnos, que al cerrar cada tic resuelve los combates
+ * con las mismas reglas que el binario ursula: el perdedor pierde 10 de comida y 10 de oro, el ganador recibe 10 de
+ * oro, y Ursula cobra el sobrante o subsidia la diferencia hasta que su tesoro no alcanza (bancarrota).
+ *
+ * Las partidas se reparten en bloques entre los hilos con un pool con robo de trabajo: cada hilo vacía su propia cola
+ * por el final y, cuando se queda sin trabajo, roba bloques por el principio de la cola de otro. Cada partida usa su
+ * propio generador sembrado con (semilla, número de partida), así que los resultados no dependen del número de hilos.
+ * Cada hilo tiene su propio motor, que se vacía al empezar cada partida.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#include <pthread.h>
+#include "map.h"
+#include "engine.h"
+
+#define MC_DEFAULT_GAMES 1000
+#define MC_DEFAULT_FOOD 100         // Comida inicial de un barco (la de ship por defecto)
+#define MC_DEFAULT_STEPS 10         // Pasos del modo aleatorio (los que pide el capitán)
+#define MC_DEFAULT_TREASURY 100     // Tesoro inicial de Ursula
+#define MC_MAX_TICKS 1000000        // Tope de una partida (por si los pasos son ilimitados)
+#define MC_CHUNK 8                  // Partidas por tarea del pool
+#define MC_MAX_THREADS 256
+
+#define MC_MOVE_COST 5
+
+// Barco tal y como aparece en el fichero de barcos
+typedef struct {
+    int x;
+    int y;
+    int speed;
+} SimShip;
+
+typedef struct {
+    int width;
+    int height;
+    uint8_t *sea;               // 1 si la celda es navegable (copia del mapa, para no compartir su caché de teselas)
+    SimShip *fleet;
+    int ships;
+    int food;
+    int steps;
+    int treasury;
+    int max_ticks;
+    uint64_t seed;
+} SimConfig;
+
+typedef struct {
+    int bankrupt;
+    int ticks;                  // Tic de la bancarrota, o de la vuelta a puerto del último barco
+    int combats;
+    int treasury;
+} GameResult;
+
+// Cola de tareas de un hilo: [top, bottom). El dueño toma por bottom y los ladrones por top.
+typedef struct {
+    pthread_mutex_t lock;
+    int *tasks;
+    int top;
+    int bottom;
+} TaskDeque;
+
+typedef struct {
+    const SimConfig *config;
+    GameResult *results;
+    int *gold;                  // Oro final de cada barco: games * ships
+    int games;
+    TaskDeque *deques;
+    int threads;
+} Pool;
+
+typedef struct {
+    Pool *pool;
+    int index;
+    long stolen;
+} Worker;
+
+// Estado de un barco durante una partida que no lleva el motor
+typedef struct {
+    int slot;                   // Ranura del barco en el motor
+    int steps;
+    int alive;
+} GameShip;
+
+static uint64_t splitmix64(uint64_t *state) {
+    uint64_t z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+static int rng_below(uint64_t *state, int n) {
+    return (int)(splitmix64(state) % (uint64_t)n);
+}
+
+/** @brief Juega la partida número game y deja su resultado en result y el oro de cada barco en gold. */
+static void play_game(const SimConfig *c, int game, GameResult *result, int *gold, GameShip *ships, Engine *engine) {
+    static const int directions[4][2] = {{0, -1}, {0, 1}, {-1, 0}, {1, 0}};
+    uint64_t rng = c->seed ^ ((uint64_t)game * 0xD1B54A32D192ED03ULL);
+    int alive = c->ships;
+    EngineShip state;
+
+    // El motor escoge los ganadores con su propio generador, sembrado desde el de la partida
+    engine_reset(engine, c->treasury, (unsigned int)splitmix64(&rng));
+    memset(result, 0, sizeof(*result));
+    for (int i = 0; i < c->ships; i++) {
+        ships[i] = (GameShip){engine_apply_init(engine, i + 1, c->fleet[i].x, c->fleet[i].y, c->food, 0, 0), c->steps, 1};
+        gold[i] = 0;
+    }
+    engine_clear_events(engine);
+
+    int tick;
+    for (tick = 1; alive > 0 && tick <= c->max_ticks; tick++) {
+        // Pasos de los barcos a los que les toca en este tic (como random_step en ship.c)
+        for (int i = 0; i < c->ships; i++) {
+            GameShip *s = &ships[i];
+            if (!s->alive || tick % c->fleet[i].speed != 0) continue;
+            engine_ship(engine, s->slot, &state);
+            if (s->steps == 0) {
+                gold[i] = state.gold;   // Vuelve a puerto con su oro
+                engine_apply_terminate(engine, i + 1);
+                s->alive = 0;
+                alive--;
+                continue;
+            }
+            if (state.food >= MC_MOVE_COST) {
+                const int *d = directions[rng_below(&rng, 4)];
+                int nx = state.x + d[0], ny = state.y + d[1];
+                if (nx >= 0 && ny >= 0 && nx < c->width && ny < c->height && c->sea[(size_t)ny * c->width + nx]) {
+                    engine_apply_move(engine, i + 1, nx, ny, state.food - MC_MOVE_COST, state.gold);
+                }
+            }
+            if (s->steps > 0) s->steps--;
+        }
+
+        // Cierre del turno: el motor resuelve las celdas compartidas donde alguien se movió
+        result->combats += engine_tick(engine);
+        engine_clear_events(engine);
+        if (engine_bankrupt(engine)) {
+            result->bankrupt = 1;
+            break;
+        }
+    }
+
+    // Sin bancarrota el for ya avanzó tick más allá del último tic jugado
+    result->ticks = result->bankrupt ? tick : tick - 1;
+    result->treasury = engine_treasury(engine);
+    for (int i = 0; i < c->ships; i++) {
+        if (ships[i].alive && engine_ship(engine, ships[i].slot, &state)) gold[i] = state.gold;
+    }
+}
+
+/** @return La siguiente tarea de la cola propia (por el final) o, si está vacía, una robada a otro hilo; -1 si no quedan. */
+static int next_task(Worker *w, uint64_t *rng) {
+    Pool *p = w->pool;
+    TaskDeque *own = &p->deques[w->index];
+    int task = -1;
+
+    pthread_mutex_lock(&own->lock);
+    if (own->bottom > own->top) task = own->tasks[--own->bottom];
+    pthread_mutex_unlock(&own->lock);
+    if (task >= 0) return task;
+
+    // Robo: se empieza por una víctima al azar para no cargar siempre la misma cola
+    int first = p->threads > 1 ? rng_below(rng, p->threads) : 0;
+    for (int k = 0; k < p->threads; k++) {
+        TaskDeque *victim = &p->deques[(first + k) % p->threads];
+        if (victim == own) continue;
+        pthread_mutex_lock(&victim->lock);
+        if (victim->bottom > victim->top) task = victim->tasks[victim->top++];
+        pthread_mutex_unlock(&victim->lock);
+        if (task >= 0) {
+            w->stolen++;
+            return task;
+        }
+    }
+    return -1;  // Las tareas no se crean sobre la marcha: si todas las colas están vacías, no queda trabajo
+}
+
+static void *worker_main(void *arg) {
+    Worker *w = arg;
+    const SimConfig *c = w->pool->config;
+    uint64_t rng = c->seed + (uint64_t)w->index;
+    GameShip *ships = malloc(sizeof(GameShip) * c->ships);
+    Engine *engine = engine_create(c->treasury, 0);
+    if (!ships || !engine) {
+        free(ships);
+        engine_destroy(engine);
+        return NULL;    // Sus tareas las robarán los demás
+    }
+    engine_set_turns(engine, 1);
+
+    for (int task; (task = next_task(w, &rng)) >= 0;) {
+        int end = (task + 1) * MC_CHUNK < w->pool->games ? (task + 1) * MC_CHUNK : w->pool->games;
+        for (int g = task * MC_CHUNK; g < end; g++) {
+            play_game(c, g, &w->pool->results[g], &w->pool->gold[(size_t)g * c->ships], ships, engine);
+        }
+    }
+    free(ships);
+    engine_destroy(engine);
+    return NULL;
+}
+
+static int compare_int(const void *a, const void *b) {
+    int ia = *(const int *)a, ib = *(const int *)b;
+    return (ia > ib) - (ia < ib);
+}
+
+/** @brief Imprime media y percentiles de values (que quedan ordenados). */
+static void print_distribution(const char *label, int *values, size_t n) {
+    if (n == 0) {
+        printf("  %-26s sin datos\n", label);
+        return;
+    }
+    double sum = 0;
+    qsort(values, n, sizeof(int), compare_int);
+    for (size_t i = 0; i < n; i++) sum += values[i];
+    printf("  %-26s media %.1f  min %d  p10 %d  p50 %d  p90 %d  p99 %d  max %d\n", label, sum / n, values[0],
+           values[n / 10], values[n / 2], values[n * 9 / 10], values[n * 99 / 100], values[n - 1]);
+}
+
+static int load_fleet(const char *path, Map *map, SimConfig *c) {
+    FILE *f = fopen(path, "r");
+    char *line = NULL;
+    size_t len = 0;
+    int id, x, y, speed;
+    if (!f) return -1;
+
+    c->ships = 0;
+    c->fleet = NULL;
+    while (getline(&line, &len, f) != -1) {
+        if (sscanf(line, "%d (%d,%d) %d", &id, &x, &y, &speed) != 4) continue;
+        if (!map_can_sail(map, x, y) || speed < 1) {
+            fprintf(stderr, "[Montecarlo] Barco ID %d en (%d, %d) no es válido, se ignora.\n", id, x, y);
+            continue;
+        }
+        SimShip *grown = realloc(c->fleet, sizeof(SimShip) * (c->ships + 1));
+        if (!grown) break;
+        c->fleet = grown;
+        c->fleet[c->ships++] = (SimShip){x, y, speed};
+    }
+    free(line);
+    fclose(f);
+    if (c->ships > ENGINE_MAX_SHIPS) {
+        fprintf(stderr, "[Montecarlo] Sólo se simulan los primeros %d barcos.\n", ENGINE_MAX_SHIPS);
+        c->ships = ENGINE_MAX_SHIPS;
+    }
+    return c->ships > 0 ? 0 : -1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s --map <mapa> --ships <barcos> [--games <n>] [--threads <n>] [--seed <n>]\n", prog);
+    fprintf(stderr, "     [--treasury <n>] [--food <n>] [--steps <n>] [--max-ticks <n>] [--csv <fichero>]\n");
+}
+
+int main(int argc, char *argv[]) {
+    const char *map_path = NULL, *ships_path = NULL, *csv_path = NULL;
+    int games = MC_DEFAULT_GAMES;
+    long cpus = sysconf(_SC_NPROCESSORS_ONLN);
+    int threads = cpus > 0 ? (int)cpus : 1;
+    SimConfig c = {0};
+    c.food = MC_DEFAULT_FOOD;
+    c.steps = MC_DEFAULT_STEPS;
+    c.treasury = MC_DEFAULT_TREASURY;
+    c.max_ticks = MC_MAX_TICKS;
+    c.seed = (uint64_t)time(NULL);
+
+    for (int i = 1; i < argc; i++) {
+        if (i + 1 >= argc) {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+        if (strcmp(argv[i], "--map") == 0) map_path = argv[++i];
+        else if (strcmp(argv[i], "--ships") == 0) ships_path = argv[++i];
+        else if (strcmp(argv[i], "--csv") == 0) csv_path = argv[++i];
+        else if (strcmp(argv[i], "--games") == 0) games = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--threads") == 0) threads = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0) c.seed = strtoull(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--treasury") == 0) c.treasury = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--food") == 0) c.food = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--steps") == 0) c.steps = atoi(argv[++i]);   // -1: sin límite
+        else if (strcmp(argv[i], "--max-ticks") == 0) c.max_ticks = atoi(argv[++i]);
+        else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!map_path || !ships_path || games < 1 || threads < 1 || c.max_ticks < 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (threads > MC_MAX_THREADS) threads = MC_MAX_THREADS;
+
+    Map *map = map_load(map_path);
+    if (!map) {
+        fprintf(stderr, "[Montecarlo] No se pudo cargar el mapa %s.\n", map_path);
+        return EXIT_FAILURE;
+    }
+    if ((long)map->width * map->height > MAP_TEXT_MAX_CELLS) {
+        fprintf(stderr, "[Montecarlo] El mapa %s es demasiado grande para simularlo.\n", map_path);
+        map_destroy(map);
+        return EXIT_FAILURE;
+    }
+    if (load_fleet(ships_path, map, &c) != 0) {
+        fprintf(stderr, "[Montecarlo] No hay barcos válidos en %s.\n", ships_path);
+        map_destroy(map);
+        return EXIT_FAILURE;
+    }
+
+    // Navegabilidad precalculada: los hilos sólo leen este array, nunca el mapa
+    c.width = map->width;
+    c.height = map->height;
+    c.sea = malloc((size_t)c.width * c.height);
+    if (!c.sea) {
+        map_destroy(map);
+        free(c.fleet);
+        return EXIT_FAILURE;
+    }
+    for (int y = 0; y < c.height; y++) {
+        for (int x = 0; x < c.width; x++) c.sea[(size_t)y * c.width + x] = (uint8_t)map_can_sail(map, x, y);
+    }
+    map_destroy(map);
+
+    Pool pool = {&c, calloc(games, sizeof(GameResult)), calloc((size_t)games * c.ships, sizeof(int)), games,
+                 calloc(threads, sizeof(TaskDeque)), threads};
+    Worker *workers = calloc(threads, sizeof(Worker));
+    pthread_t *tids = calloc(threads, sizeof(pthread_t));
+    int tasks = (games + MC_CHUNK - 1) / MC_CHUNK;
+    if (!pool.results || !pool.gold || !pool.deques || !workers || !tids) {
+        fprintf(stderr, "[Montecarlo] Sin memoria para %d partidas.\n", games);
+        return EXIT_FAILURE;
+    }
+
+    // Reparto inicial por turnos; el robo corrige los desequilibrios (partidas que duran más que otras)
+    for (int t = 0; t < threads; t++) {
+        pthread_mutex_init(&pool.deques[t].lock, NULL);
+        pool.deques[t].tasks = malloc(sizeof(int) * (tasks / threads + 1));
+        if (!pool.deques[t].tasks) {
+            fprintf(stderr, "[Montecarlo] Sin memoria para las colas.\n");
+            return EXIT_FAILURE;
+        }
+    }
+    for (int task = 0; task < tasks; task++) {
+        TaskDeque *d = &pool.deques[task % threads];
+        d->tasks[d->bottom++] = task;
+    }
+
+    fprintf(stderr, "[Montecarlo] %d partidas de %d barcos en %d hilos (semilla %llu).\n", games, c.ships, threads,
+            (unsigned long long)c.seed);
+    struct timespec t0, t1;
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+    int started = 0;
+    for (int t = 0; t < threads; t++) {
+        workers[t] = (Worker){&pool, t, 0};
+        if (pthread_create(&tids[t], NULL, worker_main, &workers[t]) == 0) started++;
+        else tids[t] = 0;
+    }
+    if (started == 0) {
+        // Sin hilos auxiliares: el principal hace todo el trabajo (robando de todas las colas)
+        worker_main(&workers[0]);
+    }
+    long stolen = 0;
+    for (int t = 0; t < threads; t++) {
+        if (tids[t]) pthread_join(tids[t], NULL);
+        stolen += workers[t].stolen;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    double elapsed = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec) / 1e9;
+
+    // Informe
+    int *bankrupt_ticks = malloc(sizeof(int) * games);
+    int *lengths = malloc(sizeof(int) * games);
+    int *combats = malloc(sizeof(int) * games);
+    int *treasuries = malloc(sizeof(int) * games);
+    if (!bankrupt_ticks || !lengths || !combats || !treasuries) {
+        fprintf(stderr, "[Montecarlo] Sin memoria para el informe.\n");
+        return EXIT_FAILURE;
+    }
+    int bankruptcies = 0;
+    for (int g = 0; g < games; g++) {
+        if (pool.results[g].bankrupt) bankrupt_ticks[bankruptcies++] = pool.results[g].ticks;
+        lengths[g] = pool.results[g].ticks;
+        combats[g] = pool.results[g].combats;
+        treasuries[g] = pool.results[g].treasury;
+    }
+
+    if (csv_path) {
+        FILE *csv = fopen(csv_path, "w");
+        if (!csv) {
+            perror("Error abriendo el fichero CSV");
+        }
+        else {
+            fprintf(csv, "game,bankrupt,ticks,combats,treasury,gold\n");
+            for (int g = 0; g < games; g++) {
+                long gold = 0;
+                for (int i = 0; i < c.ships; i++) gold += pool.gold[(size_t)g * c.ships + i];
+                fprintf(csv, "%d,%d,%d,%d,%d,%ld\n", g, pool.results[g].bankrupt, pool.results[g].ticks,
+                        pool.results[g].combats, pool.results[g].treasury, gold);
+            }
+            fclose(csv);
+        }
+    }
+
+    printf("Partidas: %d  Barcos por partida: %d  Tesoro inicial: %d\n", games, c.ships, c.treasury);
+    printf("Bancarrotas: %d (%.1f%%)\n", bankruptcies, 100.0 * bankruptcies / games);
+    print_distribution("Tic de la bancarrota:", bankrupt_ticks, bankruptcies);
+    print_distribution("Duración de la partida:", lengths, games);
+    print_distribution("Combates por partida:", combats, games);
+    print_distribution("Tesoro final:", treasuries, games);
+    print_distribution("Oro por barco:", pool.gold, (size_t)games * c.ships);
+    printf("Tiempo: %.2f s (%.0f partidas/s), %ld bloques robados.\n", elapsed, games / elapsed, stolen);
+
+    for (int t = 0; t < threads; t++) {
+        pthread_mutex_destroy(&pool.deques[t].lock);
+        free(pool.deques[t].tasks);
+    }
+    free(pool.deques);
+    free(pool.results);
+    free(pool.gold);
+    free(workers);
+    free(tids);
+    free(bankrupt_ticks);
+    free(lengths);
+    free(combats);
+    free(treasuries);
+    free(c.sea);
+    free(c.fleet);
+    return EXIT_SUCCESS;
+}
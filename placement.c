@@ -0,0 +1,114 @@
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "placement.h"
+
+/**
+ * @brief Lee una lista de CPUs con el formato de taskset/cpuset: números y rangos separados por comas ("0-3,6").
+ * @return 0 si la lista es válida y no está vacía, -1 en caso contrario.
+ */
+int placement_parse_cpus(const char *spec, CpuList *out) {
+    const char *p = spec;
+    out->count = 0;
+    while (*p) {
+        char *end;
+        long lo = strtol(p, &end, 10), hi;
+        if (end == p || lo < 0 || lo >= CPU_SETSIZE) return -1;
+        hi = lo;
+        p = end;
+        if (*p == '-') {
+            hi = strtol(p + 1, &end, 10);
+            if (end == p + 1 || hi < lo || hi >= CPU_SETSIZE) return -1;
+            p = end;
+        }
+        for (long cpu = lo; cpu <= hi; cpu++) {
+            if (out->count == PLACEMENT_MAX_CPUS) return -1;
+            out->cpus[out->count++] = (int)cpu;
+        }
+        if (*p == ',') p++;
+        else if (*p) return -1;
+    }
+    return out->count > 0 ? 0 : -1;
+}
+
+/** @brief Restringe el proceso pid (0 = el llamante, con todos los hilos que cree después) a las CPUs de la lista. */
+int placement_pin(pid_t pid, const CpuList *list) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    for (int i = 0; i < list->count; i++) CPU_SET(list->cpus[i], &set);
+    return sched_setaffinity(pid, sizeof(set), &set);
+}
+
+/** @brief Fija el proceso pid a una sola CPU de la lista, la index-ésima (en rueda), para repartir procesos. */
+int placement_pin_one(pid_t pid, const CpuList *list, int index) {
+    cpu_set_t set;
+    CPU_ZERO(&set);
+    CPU_SET(list->cpus[index % list->count], &set);
+    return sched_setaffinity(pid, sizeof(set), &set);
+}
+
+/**
+ * @brief Pasa el proceso llamante a SCHED_BATCH: el planificador lo trata como trabajo de fondo y no le da ventaja
+ * al despertar frente a los procesos interactivos (Ursula, el capitán). Conserva su valor nice.
+ */
+int placement_batch(void) {
+    struct sched_param param = {0};
+    return sched_setscheduler(0, SCHED_BATCH, &param);
+}
+
+// Escribe una línea en un fichero de control del cgroup
+static int write_control(const char *dir, const char *file, const char *value) {
+    char path[512];
+    snprintf(path, sizeof(path), "%s/%s", dir, file);
+    int fd = open(path, O_WRONLY);
+    if (fd == -1) return -1;
+    ssize_t n = write(fd, value, strlen(value));
+    int err = errno;
+    close(fd);
+    errno = err;
+    return n == (ssize_t)strlen(value) ? 0 : -1;
+}
+
+/**
+ * @brief Crea el cgroup de la flota, parent/fleet-<pid del capitán>, con peso de CPU weight (1-10000, 100 es el
+ * peso por defecto de cualquier cgroup). Si el controlador cpu no está habilitado en parent se intenta habilitar.
+ * @param path Recibe la ruta del cgroup creado.
+ * @return 0 si el cgroup existe (aunque no se haya podido fijar el peso, que se avisa), -1 en caso de error.
+ */
+int placement_cgroup_create(const char *parent, int weight, char *path, int len) {
+    char value[16];
+    snprintf(path, len, "%s/fleet-%d", parent, (int)getpid());
+    if (mkdir(path, 0755) == -1 && errno != EEXIST) return -1;
+    // Fuera de una jerarquía cgroup v2 mkdir crea un directorio corriente, sin ficheros de control
+    char procs[512];
+    snprintf(procs, sizeof(procs), "%s/cgroup.procs", path);
+    if (access(procs, W_OK) == -1) {
+        int err = errno;
+        rmdir(path);
+        errno = err;
+        return -1;
+    }
+
+    write_control(parent, "cgroup.subtree_control", "+cpu");
+    snprintf(value, sizeof(value), "%d", weight);
+    if (write_control(path, "cpu.weight", value) == -1) perror("Aviso: no se pudo fijar cpu.weight del cgroup");
+    return 0;
+}
+
+/** @brief Mueve el proceso pid al cgroup. */
+int placement_cgroup_attach(const char *path, pid_t pid) {
+    char value[16];
+    snprintf(value, sizeof(value), "%d", (int)pid);
+    return write_control(path, "cgroup.procs", value);
+}
+
+/** @brief Retira el cgroup de la flota; sólo es posible cuando ya no queda ningún proceso en él. */
+void placement_cgroup_remove(const char *path) {
+    if (path && path[0]) rmdir(path);
+}
@@ -0,0 +1,32 @@
+/**
+ * @file placement.h
+ * @brief Ubicación de los procesos en la máquina: afinidad de CPU, clase de planificación y cgroups (v2).
+ *
+ * Con flotas grandes los barcos compiten por la CPU con el hilo de ingesta de Ursula. Ursula puede reservarse
+ * unos núcleos (--cpus) y el capitán puede repartir sus barcos por otro conjunto, bajarles la prioridad
+ * (nice, SCHED_BATCH) y meter la flota en un cgroup con su propio peso de CPU.
+ */
+
+#ifndef PLACEMENT_H
+#define PLACEMENT_H
+
+#include <sys/types.h>
+
+#define PLACEMENT_MAX_CPUS 1024
+
+// Lista de CPUs en el orden en que se escribió ("0-3,6")
+typedef struct {
+    int count;
+    int cpus[PLACEMENT_MAX_CPUS];
+} CpuList;
+
+int placement_parse_cpus(const char *spec, CpuList *out);
+int placement_pin(pid_t pid, const CpuList *list);
+int placement_pin_one(pid_t pid, const CpuList *list, int index);
+int placement_batch(void);
+
+int placement_cgroup_create(const char *parent, int weight, char *path, int len);
+int placement_cgroup_attach(const char *path, pid_t pid);
+void placement_cgroup_remove(const char *path);
+
+#endif
@@ -0,0 +1,380 @@
+#define _GNU_SOURCE
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "ring.h"
+
+#define RING_MASK (RING_SLOTS - 1)
+
+static void cpu_relax(void) {
+#if defined(__x86_64__) || defined(__i386__)
+    __builtin_ia32_pause();
+#endif
+}
+
+// Futex compartido entre procesos (sin FUTEX_PRIVATE_FLAG): la palabra vive en memoria compartida
+static int futex_wait(uint32_t *addr, uint32_t val, const struct timespec *timeout) {
+    return (int)syscall(SYS_futex, addr, FUTEX_WAIT, val, timeout, NULL, 0);
+}
+
+static void futex_wake(uint32_t *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+static long now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return ts.tv_sec * 1000L + ts.tv_nsec / 1000000L;
+}
+
+/**
+ * @brief Duerme en el futex word mientras siga valiendo val, como mucho hasta deadline (-1 = sin límite).
+ * El llamante ya ha anunciado que espera y ha comprobado de nuevo la condición, así que no se pierden avisos.
+ * @return 0 si hay que volver a comprobar la condición, -1 si se agotó el plazo.
+ */
+static int wait_on(uint32_t *word, uint32_t val, long deadline) {
+    struct timespec ts;
+    const struct timespec *timeout = NULL;
+    if (deadline >= 0) {
+        long left = deadline - now_ms();
+        if (left <= 0) return -1;
+        ts.tv_sec = left / 1000;
+        ts.tv_nsec = (left % 1000) * 1000000L;
+        timeout = &ts;
+    }
+    // EINTR (p.ej. las señales de Ursula a un barco) y EAGAIN sólo obligan a reintentar
+    if (futex_wait(word, val, timeout) == -1 && errno == ETIMEDOUT) return -1;
+    return 0;
+}
+
+/**
+ * @brief Crea un canal para un barco en un memfd, que el hijo hereda a través de exec.
+ * @param fd Devuelve el descriptor del memfd; el padre debe cerrarlo tras el fork.
+ * @return El canal proyectado, o NULL en caso de error.
+ */
+ShipChannel* ring_channel_create(int *fd) {
+    *fd = memfd_create("ship-channel", 0);
+    if (*fd == -1) return NULL;
+    if (ftruncate(*fd, sizeof(ShipChannel)) == -1) {
+        close(*fd);
+        return NULL;
+    }
+    ShipChannel *channel = ring_channel_attach(*fd);
+    if (!channel) close(*fd);
+    return channel;
+}
+
+/** @brief Proyecta un canal creado por ring_channel_create (en el barco, a partir del descriptor heredado). */
+ShipChannel* ring_channel_attach(int fd) {
+    ShipChannel *channel = mmap(NULL, sizeof(ShipChannel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return channel == MAP_FAILED ? NULL : channel;
+}
+
+void ring_channel_destroy(ShipChannel *channel) {
+    if (channel) munmap(channel, sizeof(ShipChannel));
+}
+
+/**
+ * @brief Encola un registro sin bloquear. Sólo despierta al consumidor si está dormido.
+ * @return 0 en caso de éxito, -1 si el anillo está lleno.
+ */
+int ring_push(SpscRing *ring, const RingRecord *rec) {
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_RELAXED);
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_ACQUIRE);
+    if (head - tail == RING_SLOTS) return -1;
+
+    ring->slots[head & RING_MASK] = *rec;
+    __atomic_store_n(&ring->head, head + 1, __ATOMIC_RELEASE);
+
+    // Emparejado con la barrera de ring_pop_wait: o el consumidor ve el nuevo head, o nosotros vemos que espera
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->consumer_waiting, __ATOMIC_RELAXED)) futex_wake(&ring->head);
+    return 0;
+}
+
+/**
+ * @brief Desencola un registro sin bloquear.
+ * @return 0 en caso de éxito, -1 si el anillo está vacío.
+ */
+int ring_pop(SpscRing *ring, RingRecord *rec) {
+    uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_ACQUIRE);
+    if (tail == head) return -1;
+
+    *rec = ring->slots[tail & RING_MASK];
+    __atomic_store_n(&ring->tail, tail + 1, __ATOMIC_RELEASE);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->producer_waiting, __ATOMIC_RELAXED)) futex_wake(&ring->tail);
+    return 0;
+}
+
+/**
+ * @brief Encola un registro esperando hueco si el anillo está lleno.
+ * @param timeout_ms Plazo máximo en milisegundos, o -1 para esperar indefinidamente.
+ * @return 0 en caso de éxito, -1 si se agotó el plazo.
+ */
+int ring_push_wait(SpscRing *ring, const RingRecord *rec, int timeout_ms) {
+    long deadline = timeout_ms >= 0 ? now_ms() + timeout_ms : -1;
+    for (int i = 0; i < RING_SPIN; i++) {
+        if (ring_push(ring, rec) == 0) return 0;
+        cpu_relax();
+    }
+    while (1) {
+        __atomic_store_n(&ring->producer_waiting, 1, __ATOMIC_SEQ_CST);
+        uint32_t tail = __atomic_load_n(&ring->tail, __ATOMIC_SEQ_CST);
+        int full = __atomic_load_n(&ring->head, __ATOMIC_RELAXED) - tail == RING_SLOTS;
+        int expired = full && wait_on(&ring->tail, tail, deadline) != 0;
+        __atomic_store_n(&ring->producer_waiting, 0, __ATOMIC_RELAXED);
+        if (ring_push(ring, rec) == 0) return 0;
+        if (expired) return -1;
+    }
+}
+
+/**
+ * @brief Desencola un registro esperando a que llegue uno: primero en espera activa (camino caliente,
+ * latencia por debajo del microsegundo) y después durmiendo en el futex de head.
+ * @param timeout_ms Plazo máximo en milisegundos, o -1 para esperar indefinidamente.
+ * @return 0 en caso de éxito, -1 si se agotó el plazo.
+ */
+int ring_pop_wait(SpscRing *ring, RingRecord *rec, int timeout_ms) {
+    long deadline = timeout_ms >= 0 ? now_ms() + timeout_ms : -1;
+    for (int i = 0; i < RING_SPIN; i++) {
+        if (ring_pop(ring, rec) == 0) return 0;
+        cpu_relax();
+    }
+    while (1) {
+        __atomic_store_n(&ring->consumer_waiting, 1, __ATOMIC_SEQ_CST);
+        uint32_t head = __atomic_load_n(&ring->head, __ATOMIC_SEQ_CST);
+        int empty = head == __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+        int expired = empty && wait_on(&ring->head, head, deadline) != 0;
+        __atomic_store_n(&ring->consumer_waiting, 0, __ATOMIC_RELAXED);
+        if (ring_pop(ring, rec) == 0) return 0;
+        if (expired) return -1;
+    }
+}
+
+/**
+ * @brief Crea (o reinicia) un anillo MPSC en el segmento compartido name. El llamante es el consumidor.
+ * @return El anillo proyectado en lectura/escritura, o NULL en caso de error.
+ */
+MpscRing* mpsc_create(const char *name) {
+    if (strlen(name) >= sizeof(((MpscRing *)0)->name)) return NULL;
+
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0666);
+    if (fd == -1) return NULL;
+    if (ftruncate(fd, 0) == -1 || ftruncate(fd, sizeof(MpscRing)) == -1) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+    MpscRing *ring = mmap(NULL, sizeof(MpscRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    // Ranura i libre para el ticket i: su turno vale i hasta que alguien la publica
+    for (uint32_t i = 0; i < MPSC_SLOTS; i++) ring->slots[i].seq = i;
+    ring->owner_pid = getpid();
+    strcpy(ring->name, name);
+    __atomic_store_n(&ring->magic, MPSC_MAGIC, __ATOMIC_RELEASE);
+    return ring;
+}
+
+/**
+ * @brief Proyecta el anillo MPSC name como productor.
+ * @return El anillo, o NULL si no existe o su consumidor ya no está vivo.
+ */
+MpscRing* mpsc_attach(const char *name) {
+    struct stat st;
+    int fd = shm_open(name, O_RDWR, 0);
+    if (fd == -1) return NULL;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(MpscRing)) {
+        close(fd);
+        return NULL;
+    }
+    MpscRing *ring = mmap(NULL, sizeof(MpscRing), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (ring == MAP_FAILED) return NULL;
+
+    // Un segmento huérfano (consumidor muerto sin limpiar) se trata como si no existiera
+    if (__atomic_load_n(&ring->magic, __ATOMIC_ACQUIRE) != MPSC_MAGIC ||
+        (kill(ring->owner_pid, 0) == -1 && errno == ESRCH)) {
+        munmap(ring, sizeof(MpscRing));
+        return NULL;
+    }
+    return ring;
+}
+
+/** @brief Retira el segmento del anillo (lo llama el consumidor). */
+void mpsc_destroy(MpscRing *ring) {
+    if (!ring) return;
+    shm_unlink(ring->name);
+    munmap(ring, sizeof(MpscRing));
+}
+
+void mpsc_detach(MpscRing *ring) {
+    if (ring) munmap(ring, sizeof(MpscRing));
+}
+
+// PID del proceso productor, leído una vez por imagen (los hijos de fork no publican antes de su exec)
+static int32_t producer_pid(void) {
+    static int32_t pid = 0;
+    if (!pid) pid = (int32_t)getpid();
+    return pid;
+}
+
+/**
+ * @brief Publica un registro sin bloquear. La ranura se reserva primero a nombre del productor (claimants) y sólo
+ * después se avanza tail, así el consumidor sabe siempre de quién es una ranura reservada sin publicar. Se puede
+ * llamar desde manejadores de señales si las señales que terminan el proceso están bloqueadas durante la llamada.
+ * @return 0 en caso de éxito, -1 si el anillo está lleno (o la ranura siguiente aún la tiene otro productor).
+ */
+int mpsc_push(MpscRing *ring, const MpscRecord *rec) {
+    int32_t self = producer_pid();
+    uint32_t pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+    MpscRecord *slot;
+
+    while (1) {
+        slot = &ring->slots[pos & (MPSC_SLOTS - 1)];
+        int32_t *claimant = &ring->claimants[pos & (MPSC_SLOTS - 1)];
+        int32_t diff = (int32_t)(__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) - pos);
+        if (diff == 0) {
+            // Ranura libre para este ticket: se reserva a nuestro nombre y después se avanza tail
+            int32_t none = 0;
+            if (!__atomic_compare_exchange_n(claimant, &none, self, 0, __ATOMIC_ACQ_REL, __ATOMIC_RELAXED)) {
+                return -1; // Otro productor la tiene reservada y aún no ha avanzado tail
+            }
+            uint32_t expected = pos;
+            if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == pos &&
+                __atomic_compare_exchange_n(&ring->tail, &expected, pos + 1, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED)) {
+                break;
+            }
+            // La ranura cambió de vuelta entre la lectura de tail y la reserva: se suelta y se reintenta
+            __atomic_store_n(claimant, 0, __ATOMIC_RELEASE);
+            pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+        } else if (diff < 0) {
+            return -1; // El consumidor aún no ha liberado la ranura de la vuelta anterior
+        } else {
+            pos = __atomic_load_n(&ring->tail, __ATOMIC_RELAXED);
+        }
+    }
+
+    slot->op = rec->op;
+    slot->pid = rec->pid;
+    memcpy(slot->arg, rec->arg, sizeof(slot->arg));
+    __atomic_store_n(&slot->seq, pos + 1, __ATOMIC_RELEASE);
+
+    __atomic_thread_fence(__ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&ring->consumer_waiting, __ATOMIC_RELAXED)) {
+        __atomic_add_fetch(&ring->wake, 1, __ATOMIC_RELEASE);
+        futex_wake(&ring->wake);
+    }
+    return 0;
+}
+
+/**
+ * @brief Publica un registro esperando hueco si el anillo está lleno, mientras el consumidor siga vivo.
+ * @return 0 en caso de éxito, -1 si el consumidor ha muerto.
+ */
+int mpsc_push_wait(MpscRing *ring, const MpscRecord *rec) {
+    struct timespec pause_ts = {0, 100000}; // 100 us
+    for (int i = 0; mpsc_push(ring, rec) != 0; i++) {
+        if (i < RING_SPIN) {
+            cpu_relax();
+            continue;
+        }
+        if (kill(ring->owner_pid, 0) == -1 && errno == ESRCH) return -1;
+        nanosleep(&pause_ts, NULL);
+    }
+    return 0;
+}
+
+/**
+ * @brief Desencola un registro sin bloquear (sólo el consumidor).
+ * @return 0 en caso de éxito, -1 si no hay ningún registro publicado en la siguiente ranura.
+ */
+int mpsc_pop(MpscRing *ring, MpscRecord *rec) {
+    uint32_t pos = ring->head;
+    MpscRecord *slot = &ring->slots[pos & (MPSC_SLOTS - 1)];
+    if (__atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) != pos + 1) return -1;
+
+    *rec = *slot;
+    // La ranura queda libre para el ticket de la siguiente vuelta
+    __atomic_store_n(&ring->claimants[pos & (MPSC_SLOTS - 1)], 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->seq, pos + MPSC_SLOTS, __ATOMIC_RELEASE);
+    ring->head = pos + 1;
+    ring->stall_since = 0;
+    return 0;
+}
+
+/**
+ * @brief Comprueba si la siguiente ranura está reservada sin publicar y, si lleva así MPSC_STALL_MS y su productor ha
+ * muerto, la salta (como un registro vacío) para que los demás productores no se queden sin consumidor.
+ * @return 1 si hay una ranura reservada sin publicar (se haya saltado o no), 0 si no.
+ */
+static int mpsc_recover(MpscRing *ring) {
+    uint32_t pos = ring->head;
+    MpscRecord *slot = &ring->slots[pos & (MPSC_SLOTS - 1)];
+    int32_t *claimant = &ring->claimants[pos & (MPSC_SLOTS - 1)];
+    int32_t pid = __atomic_load_n(claimant, __ATOMIC_ACQUIRE);
+
+    if (pid == 0 || __atomic_load_n(&slot->seq, __ATOMIC_ACQUIRE) == pos + 1) return 0;
+    long now = now_ms();
+    if (ring->stall_since == 0 || ring->stall_pos != pos) {
+        ring->stall_pos = pos;
+        ring->stall_since = now;
+        return 1;
+    }
+    if (now - ring->stall_since < MPSC_STALL_MS || kill(pid, 0) == 0 || errno != ESRCH) return 1;
+
+    // Productor muerto: si no llegó a avanzar tail se avanza por él, y la ranura pasa a la siguiente vuelta
+    uint32_t expected = pos;
+    __atomic_compare_exchange_n(&ring->tail, &expected, pos + 1, 0, __ATOMIC_RELAXED, __ATOMIC_RELAXED);
+    __atomic_store_n(claimant, 0, __ATOMIC_RELAXED);
+    __atomic_store_n(&slot->seq, pos + MPSC_SLOTS, __ATOMIC_RELEASE);
+    ring->head = pos + 1;
+    ring->stall_since = 0;
+    return 1;
+}
+
+/**
+ * @brief Desencola un registro esperando a que algún productor publique uno. Mientras la siguiente ranura esté
+ * reservada sin publicar, se duerme como mucho MPSC_STALL_MS para comprobar si su productor sigue vivo.
+ * @param timeout_ms Plazo máximo en milisegundos, o -1 para esperar indefinidamente.
+ * @return 0 en caso de éxito, -1 si se agotó el plazo.
+ */
+int mpsc_pop_wait(MpscRing *ring, MpscRecord *rec, int timeout_ms) {
+    long deadline = timeout_ms >= 0 ? now_ms() + timeout_ms : -1;
+    for (int i = 0; i < RING_SPIN; i++) {
+        if (mpsc_pop(ring, rec) == 0) return 0;
+        cpu_relax();
+    }
+    while (1) {
+        if (mpsc_recover(ring) && mpsc_pop(ring, rec) == 0) return 0;
+        long until = deadline;
+        if (ring->stall_since) {
+            long check = now_ms() + MPSC_STALL_MS;
+            if (until < 0 || check < until) until = check;
+        }
+        uint32_t wake = __atomic_load_n(&ring->wake, __ATOMIC_ACQUIRE);
+        __atomic_store_n(&ring->consumer_waiting, 1, __ATOMIC_RELAXED);
+        __atomic_thread_fence(__ATOMIC_SEQ_CST);
+        int got = mpsc_pop(ring, rec) == 0;
+        int expired = !got && wait_on(&ring->wake, wake, until) != 0;
+        __atomic_store_n(&ring->consumer_waiting, 0, __ATOMIC_RELAXED);
+        if (got || mpsc_pop(ring, rec) == 0) return 0;
+        if (expired && deadline >= 0 && now_ms() >= deadline) return -1;
+    }
+}
@@ -0,0 +1,102 @@
+/**
+ * @file ring.h
+ * @brief Anillos sin bloqueo en memoria compartida para transportar registros binarios entre procesos.
+ *
+ * SpscRing: un productor y un consumidor (capitán -> barco y barco -> capitán). Mientras ambos lados están
+ * activos no hay llamadas al sistema; sólo se usa un futex cuando un lado se queda esperando.
+ *
+ * MpscRing: muchos productores y un consumidor (barcos y capitanes -> Ursula), en un segmento POSIX con nombre.
+ * Los productores reservan ranuras con una operación atómica sobre tail; el consumidor vacía el anillo por lotes y
+ * sólo duerme en un futex cuando lo encuentra vacío. Cada ranura reservada lleva el PID de su productor: si éste muere
+ * entre la reserva y la publicación (SIGKILL, un fallo), el consumidor salta la ranura pasado MPSC_STALL_MS en vez de
+ * quedarse esperándola. Un productor que publique desde manejadores de señales debe bloquear las señales que puedan
+ * terminarlo durante mpsc_push (ver ship.c).
+ */
+
+#ifndef RING_H
+#define RING_H
+
+#include <stdint.h>
+
+#define RING_SLOTS 64           // Potencia de dos
+#define RING_SPIN 2000          // Iteraciones de espera activa antes de dormir en el futex
+
+// Operaciones de los registros
+enum {
+    RING_CMD_MOVE = 1,          // arg0 = dx, arg1 = dy
+    RING_CMD_EXIT = 2,
+    RING_ACK_OK = 3,            // arg0, arg1 = posición del barco tras el comando
+    RING_ACK_NOK = 4
+};
+
+typedef struct {
+    uint32_t seq;               // Número de comando, el ack lo repite
+    int32_t op;
+    int32_t arg0;
+    int32_t arg1;
+} RingRecord;
+
+// head y tail en líneas de caché distintas para que productor y consumidor no se pisen
+typedef struct {
+    uint32_t head;              // Siguiente posición a escribir (sólo el productor)
+    uint32_t consumer_waiting;  // El consumidor duerme en el futex de head
+    char pad0[56];
+    uint32_t tail;              // Siguiente posición a leer (sólo el consumidor)
+    uint32_t producer_waiting;  // El productor duerme en el futex de tail (anillo lleno)
+    char pad1[56];
+    RingRecord slots[RING_SLOTS];
+} SpscRing;
+
+// Canal completo de un barco: comandos del capitán y confirmaciones del barco
+typedef struct {
+    SpscRing to_ship;
+    SpscRing to_captain;
+} ShipChannel;
+
+#define MPSC_MAGIC 0x4d505343u  // "MPSC"
+#define MPSC_SLOTS 4096          // Potencia de dos
+#define MPSC_STALL_MS 100        // Tiempo sin publicar tras el que se comprueba si el productor de una ranura vive
+
+// Registro de un anillo MPSC. seq es el turno de la ranura, no un dato del productor.
+typedef struct {
+    uint32_t seq;
+    int32_t op;
+    int32_t pid;
+    int32_t arg[5];
+} MpscRecord;
+
+typedef struct {
+    uint32_t magic;
+    int32_t owner_pid;          // Consumidor (Ursula), para que los productores no esperen a un proceso muerto
+    char name[248];             // Nombre del segmento, para retirarlo al destruirlo
+    uint32_t tail;              // Siguiente ranura a reservar (productores, con CAS)
+    char pad0[60];
+    uint32_t head;              // Siguiente ranura a leer (sólo el consumidor)
+    uint32_t consumer_waiting;  // El consumidor duerme en el futex de wake
+    uint32_t wake;              // Palabra del futex, los productores la incrementan para despertarlo
+    uint32_t stall_pos;         // Ranura reservada sin publicar que el consumidor está esperando (sólo el consumidor)
+    long stall_since;           // Desde cuándo (ms monótonos), 0 si no hay ninguna
+    char pad1[40];
+    MpscRecord slots[MPSC_SLOTS];
+    int32_t claimants[MPSC_SLOTS];  // PID del productor que ha reservado cada ranura, 0 si está libre
+} MpscRing;
+
+ShipChannel* ring_channel_create(int *fd);
+ShipChannel* ring_channel_attach(int fd);
+void ring_channel_destroy(ShipChannel *channel);
+
+int ring_push(SpscRing *ring, const RingRecord *rec);
+int ring_pop(SpscRing *ring, RingRecord *rec);
+int ring_push_wait(SpscRing *ring, const RingRecord *rec, int timeout_ms);
+int ring_pop_wait(SpscRing *ring, RingRecord *rec, int timeout_ms);
+
+MpscRing* mpsc_create(const char *name);
+MpscRing* mpsc_attach(const char *name);
+void mpsc_destroy(MpscRing *ring);
+void mpsc_detach(MpscRing *ring);
+int mpsc_push(MpscRing *ring, const MpscRecord *rec);
+int mpsc_push_wait(MpscRing *ring, const MpscRecord *rec);
+int mpsc_pop(MpscRing *ring, MpscRecord *rec);
+int mpsc_pop_wait(MpscRing *ring, MpscRecord *rec, int timeout_ms);
+
+#endif
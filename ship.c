@@ -7,6 +7,10 @@
 #include <limits.h>
 #include <sys/types.h>
 #include "map.h"
+#include "ring.h"
+#include "ursula.h"
+#include "telemetry.h"
+#include "wheel.h"
 #include <signal.h>
 
 // Direcciones: Derecha, Abajo, Izquierda, Arriba. La lógica es, dado que es un array 2D, el primer índice es la fila (y) y el segundo
@@ -30,21 +34,51 @@ typedef struct
 Ship* aux_ship = NULL;
 int ship_speed = 1;
 int steps_remaining = -1;
-FILE* ursula_pipe = NULL;
+// Conexión con Ursula (FIFO o anillo en memoria compartida), desconectada si no se pasó --ursula
+UrsulaLink ursula_link;
+// Página de telemetría compartida con el capitán (NULL si no se pasó --telemetry-fd)
+ShipTelemetry* telemetry = NULL;
+// Capitán dueño del barco (su proceso padre), para los agregados por capitán de Ursula
+int ship_owner = 0;
+// Combates aplicados por combat_handler y aún no registrados (el registro se escribe fuera del manejador)
+volatile sig_atomic_t combats_pending = 0;
+volatile sig_atomic_t combats_food = 0;
+volatile sig_atomic_t combats_gold = 0;
 
-// Funciones para notificar a Ursula los eventos del barco.
+/**
+ * @brief Publica el estado del barco en su página de telemetría y renueva su latido.
+ */
+void publish_telemetry(Ship* s)
+{
+    telemetry_publish(telemetry, s->pid, s->x, s->y, s->food, s->gold);
+}
+
+// Funciones para notificar a Ursula los eventos del barco (ver ursula.h para el formato).
+
+/**
+ * @brief Envía un evento a Ursula con las señales que pueden terminar el barco (o reentrar en el envío) bloqueadas,
+ * para que no muera con una ranura del anillo reservada y sin publicar.
+ */
+static void send_event(const UrsulaEvent* ev)
+{
+    sigset_t block, old;
+    sigemptyset(&block);
+    sigaddset(&block, SIGQUIT);
+    sigaddset(&block, SIGINT);
+    sigaddset(&block, SIGALRM);
+    sigprocmask(SIG_BLOCK, &block, &old);
+    ursula_send(&ursula_link, ev);
+    sigprocmask(SIG_SETMASK, &old, NULL);
+}
 
 /**
  * @brief Envía un mensaje formateado a Ursula cada vez que el barco se mueve, incluyendo su posición actual y recursos.
 */
 void notify_ursula_move(Ship* s)
 {
-    if (ursula_pipe)
-    {
-        // Format: <PID>, MOVE, <x>, <y>, <food>, <gold>
-        fprintf(ursula_pipe, "%d,MOVE,%d,%d,%d,%d\n", s->pid, s->x, s->y, s->food, s->gold);
-        fflush(ursula_pipe);
-    }
+    // Format: <PID>, MOVE, <x>, <y>, <food>, <gold>
+    UrsulaEvent ev = {URSULA_MOVE, s->pid, s->x, s->y, s->food, s->gold, ship_owner};
+    send_event(&ev);
 }
 
 /**
@@ -52,12 +86,9 @@ void notify_ursula_move(Ship* s)
 */
 void notify_ursula_init(Ship* s)
 {
-    if (ursula_pipe)
-    {
-        // Format: <PID>, INIT, <x>, <y>, <food>, <gold>
-        fprintf(ursula_pipe, "%d,INIT,%d,%d,%d,%d\n", s->pid, s->x, s->y, s->food, s->gold);
-        fflush(ursula_pipe);
-    }
+    // Format: <PID>, INIT, <x>, <y>, <food>, <gold>
+    UrsulaEvent ev = {URSULA_INIT, s->pid, s->x, s->y, s->food, s->gold, ship_owner};
+    send_event(&ev);
 }
 
 /**
@@ -65,14 +96,44 @@ void notify_ursula_init(Ship* s)
 */
 void notify_ursula_terminate(Ship* s)
 {
-    if (ursula_pipe)
+    // Format: <PID>, TERMINATE
+    UrsulaEvent ev = {URSULA_TERMINATE, s->pid, 0, 0, 0, 0, 0};
+    send_event(&ev);
+    ursula_disconnect(&ursula_link);
+}
+
+/**
+ * @brief Bloquea (block = 1) o restaura la señal de combate de Ursula, para que combat_handler no modifique la
+ * comida y el oro del barco a medias de una actualización del bucle principal.
+ * @param old Máscara guardada al bloquear y restaurada al desbloquear.
+ */
+static void combat_block(int block, sigset_t* old)
+{
+    if (block)
     {
-        // Format: <PID>, TERMINATE
-        fprintf(ursula_pipe, "%d,TERMINATE\n", s->pid);
-        fflush(ursula_pipe);
-        fclose(ursula_pipe);
-        ursula_pipe = NULL;
+        sigset_t set;
+        sigemptyset(&set);
+        sigaddset(&set, URSULA_COMBAT_SIGNAL);
+        sigprocmask(SIG_BLOCK, &set, old);
     }
+    else
+    {
+        sigprocmask(SIG_SETMASK, old, NULL);
+    }
+}
+
+/**
+ * @brief Registra los combates que combat_handler ha aplicado desde la última llamada.
+ * Se llama con la señal de combate bloqueada.
+ */
+static void log_combats(Ship* s)
+{
+    if (combats_pending == 0) return;
+    fprintf(stderr, "Barco %d: Resultado de %d combate(s) (%+d Comida, %+d Oro). Comida: %d, Oro: %d\n",
+            s->pid, (int)combats_pending, (int)combats_food, (int)combats_gold, s->food, s->gold);
+    combats_pending = 0;
+    combats_food = 0;
+    combats_gold = 0;
 }
 
 /**
@@ -106,6 +167,7 @@ void sigusr1_handler(int signal)
     if (aux_ship != NULL)
     {
         aux_ship->gold += 10;
+        publish_telemetry(aux_ship);
         fprintf(stderr, "Barco %d: Señal USR1 recibida (+10 Oro). Oro Total: %d\n",
                 aux_ship->pid, aux_ship->gold);
     }
@@ -139,6 +201,7 @@ void sigusr2_handler(int signal)
         {
             aux_ship->food = 0;
         }
+        publish_telemetry(aux_ship);
         fprintf(stderr, "Barco %d: Señal USR2 recibida (¡Ataque!). Comida restante: %d, Oro restante: %d\n",
                 aux_ship->pid, aux_ship->food, aux_ship->gold);
     }
@@ -185,17 +248,16 @@ void sigstp_handler(int signal)
 }
 
 /**
- * @brief Manejador de señal para SIGALRM para realizar el movimiento aleatorio del barco a intervalos regulares.
+ * @brief Realiza un paso del movimiento aleatorio del barco (en cada SIGALRM, o en cada turno del reloj de la flota).
  * Comprueba si el barco tiene pasos restantes y suficiente comida para moverse, luego selecciona aleatoriamente una dirección e intenta moverse.
  * Si el movimiento es exitoso, actualiza la posición del barco, reduce la comida, comprueba eventos, y notifica a Ursula del movimiento.
  * Si el barco se queda sin pasos o comida, registra el mensaje apropiado y puede terminar si los pasos se agotan.
- * @param signal Número de señal (no usado)
  */
-void sigalrm_handler(int signal)
+void random_step(void)
 {
-    (void)signal;
     if (aux_ship != NULL)
     {
+        log_combats(aux_ship);
         if (steps_remaining == 0)
         {
             fprintf(stderr, "Barco %d ha terminado sus pasos aleatorios.\n", aux_ship->pid);
@@ -206,6 +268,7 @@ void sigalrm_handler(int signal)
         if (aux_ship->food < 5)
         {
             fprintf(stderr, "Barco %d no tiene suficiente comida para moverse.\n", aux_ship->pid);
+            telemetry_count(telemetry, 0);
         }
         else
         {
@@ -230,22 +293,65 @@ void sigalrm_handler(int signal)
 
                 // Notificar a Ursula del movimiento aleatorio
                 notify_ursula_move(aux_ship);
+                telemetry_count(telemetry, 1);
 
                 fprintf(stderr, "Barco %d en (%d, %d) con %d comida y %d oro.\n",
                         aux_ship->pid, aux_ship->x, aux_ship->y, aux_ship->food, aux_ship->gold);
             }
+            else
+            {
+                telemetry_count(telemetry, 0);
+            }
         }
+        publish_telemetry(aux_ship); // Latido en cada tic, aunque el barco no se haya movido
 
         if (steps_remaining > 0)
         {
             steps_remaining--;
         }
-        alarm(ship_speed);
     }
 }
 
 /**
- * @brief Configura los manejadores de señales para el proceso del barco, incluyendo manejadores para SIGUSR1, SIGUSR2, SIGQUIT, SIGTSTP y SIGALRM.
+ * @brief Manejador de señal para SIGALRM para realizar el movimiento aleatorio del barco a intervalos regulares.
+ * @param signal Número de señal (no usado)
+ */
+void sigalrm_handler(int signal)
+{
+    (void)signal;
+    random_step();
+    alarm(ship_speed);
+}
+
+/**
+ * @brief Manejador de la señal de combate de Ursula (URSULA_COMBAT_SIGNAL, de tiempo real).
+ * A diferencia de SIGUSR1/SIGUSR2 estas señales se encolan, una por envío, y cada una trae las variaciones exactas
+ * de comida y oro que Ursula ha anotado en sus libros, de modo que el barco no se desvía de ellos aunque pierda
+ * varios combates antes de ser planificado.
+ * @param signal Número de señal (no usado)
+ * @param info Datos de la señal; si_value lleva las variaciones (ursula_combat_pack)
+ * @param context Contexto (no usado)
+ */
+void combat_handler(int signal, siginfo_t* info, void* context)
+{
+    (void)signal;
+    (void)context;
+    if (aux_ship != NULL)
+    {
+        int food, gold;
+        ursula_combat_unpack(info->si_value.sival_int, &food, &gold);
+        aux_ship->food = aux_ship->food + food > 0 ? aux_ship->food + food : 0;
+        aux_ship->gold = aux_ship->gold + gold > 0 ? aux_ship->gold + gold : 0;
+        publish_telemetry(aux_ship);
+        combats_food += food;
+        combats_gold += gold;
+        combats_pending++;
+    }
+}
+
+/**
+ * @brief Configura los manejadores de señales para el proceso del barco, incluyendo manejadores para SIGUSR1, SIGUSR2,
+ * la señal de combate de Ursula, SIGQUIT, SIGTSTP y SIGALRM.
  * Cada manejador está asociado con su función correspondiente para manejar el comportamiento del barco en respuesta a las señales.
  * Si la configuración de algún manejador de señal falla, imprime un mensaje de error y el proceso termina.
  */
@@ -261,6 +367,18 @@ void setup_signals()
         perror("Error configurando SIGUSR2");
         exit(EXIT_FAILURE);
     }
+    struct sigaction combat;
+    memset(&combat, 0, sizeof(combat));
+    combat.sa_sigaction = combat_handler;
+    combat.sa_flags = SA_SIGINFO | SA_RESTART;
+    // Ni el paso aleatorio interrumpe a combat_handler ni éste al paso (ver SIGALRM más abajo)
+    sigemptyset(&combat.sa_mask);
+    sigaddset(&combat.sa_mask, SIGALRM);
+    if (sigaction(URSULA_COMBAT_SIGNAL, &combat, NULL) == -1)
+    {
+        perror("Error configurando la señal de combate");
+        exit(EXIT_FAILURE);
+    }
     if (signal(SIGQUIT, sigquit_handler) == SIG_ERR)
     {
         perror("Error configurando SIGQUIT");
@@ -271,7 +389,13 @@ void setup_signals()
         perror("Error configurando SIGTSTP");
         exit(EXIT_FAILURE);
     }
-    if (signal(SIGALRM, sigalrm_handler) == SIG_ERR)
+    struct sigaction step;
+    memset(&step, 0, sizeof(step));
+    step.sa_handler = sigalrm_handler;
+    step.sa_flags = SA_RESTART;
+    sigemptyset(&step.sa_mask);
+    sigaddset(&step.sa_mask, URSULA_COMBAT_SIGNAL);
+    if (sigaction(SIGALRM, &step, NULL) == -1)
     {
         perror("Error configurando SIGALRM");
         exit(EXIT_FAILURE);
@@ -282,19 +406,26 @@ void setup_signals()
  * @brief Intenta desplazar la posición del barco por las cantidades especificadas en las direcciones x e y.
  * Comprueba si el barco tiene suficiente comida para moverse y si la nueva posición es navegable en el mapa.
  * Si el movimiento es exitoso, actualiza la posición del barco, reduce la comida, comprueba eventos, y notifica a Ursula del movimiento.
- * Si el movimiento está bloqueado o si no hay suficiente comida, registra el mensaje apropiado y responde con "NOK".
+ * Si el movimiento está bloqueado o si no hay suficiente comida, registra el mensaje apropiado.
+ * La respuesta al capitán ("OK"/"NOK" o un registro del anillo) la envía quien llama.
  * @param s Puntero a la estructura Ship que está intentando moverse.
  * @param shift_x La cantidad a desplazar en la dirección x (positivo para derecha, negativo para izquierda).
  * @param shift_y La cantidad a desplazar en la dirección y (positivo para abajo, negativo para arriba).
+ * @return 1 si el barco se movió, 0 si el movimiento fue rechazado.
  */
-void shift_position(Ship* s, int shift_x, int shift_y)
+int shift_position(Ship* s, int shift_x, int shift_y)
 {
+    sigset_t old;
+    combat_block(1, &old);
+    log_combats(s);
+
     if (s->food < 5)
     {
         fprintf(stderr, "Barco %d sin comida suficiente.\n", s->pid);
-        printf("NOK\n");
-        fflush(stdout);
-        return;
+        telemetry_count(telemetry, 0);
+        publish_telemetry(s);
+        combat_block(0, &old);
+        return 0;
     }
 
     int new_x = s->x + shift_x;
@@ -312,19 +443,28 @@ void shift_position(Ship* s, int shift_x, int shift_y)
 
         // Notificar a Ursula del movimiento ordenado por el capitán
         notify_ursula_move(s);
+        telemetry_count(telemetry, 1);
+        publish_telemetry(s);
 
         map_print(s->mapa); // Opcional para depuración
-        printf("OK\n");
-        fflush(stdout);
         fprintf(stderr, "Barco %d en (%d, %d) con %d comida y %d oro.\n",
                 s->pid, s->x, s->y, s->food, s->gold);
+        combat_block(0, &old);
+        return 1;
     }
-    else
-    {
-        printf("NOK\n");
-        fflush(stdout);
-        fprintf(stderr, "Movimiento bloqueado para barco %d.\n", s->pid);
-    }
+
+    fprintf(stderr, "Movimiento bloqueado para barco %d.\n", s->pid);
+    telemetry_count(telemetry, 0);
+    publish_telemetry(s);
+    combat_block(0, &old);
+    return 0;
+}
+
+// Responde al capitán por la tubería de salida estándar
+static void reply_pipe(int ok)
+{
+    printf(ok ? "OK\n" : "NOK\n");
+    fflush(stdout);
 }
 
 /**
@@ -347,10 +487,10 @@ void command_mode(Ship* s)
     {
         if (nread > 0 && line[nread - 1] == '\n') line[nread - 1] = '\0';
 
-        if (strcasecmp(line, "up") == 0) shift_position(s, 0, -1);
-        else if (strcasecmp(line, "down") == 0) shift_position(s, 0, 1);
-        else if (strcasecmp(line, "left") == 0) shift_position(s, -1, 0);
-        else if (strcasecmp(line, "right") == 0) shift_position(s, 1, 0);
+        if (strcasecmp(line, "up") == 0) reply_pipe(shift_position(s, 0, -1));
+        else if (strcasecmp(line, "down") == 0) reply_pipe(shift_position(s, 0, 1));
+        else if (strcasecmp(line, "left") == 0) reply_pipe(shift_position(s, -1, 0));
+        else if (strcasecmp(line, "right") == 0) reply_pipe(shift_position(s, 1, 0));
         else if (strcasecmp(line, "exit") == 0)
         {
             fprintf(stderr, "Barco %d saliendo con oro %d.\n", s->pid, s->gold);
@@ -362,6 +502,75 @@ void command_mode(Ship* s)
     free(line);
 }
 
+/**
+ * @brief Modo capitán sobre el canal en memoria compartida: los comandos llegan como registros binarios por
+ * to_ship y cada uno se confirma con un registro en to_captain que repite su número.
+ * Si el capitán desaparece (cambia el padre) el barco deja de esperar órdenes, como con el EOF de la tubería.
+ * @param s Puntero a la estructura Ship que será controlada a través de comandos.
+ * @param channel Canal compartido con el capitán.
+ */
+void command_mode_ring(Ship* s, ShipChannel* channel)
+{
+    pid_t captain = getppid();
+    RingRecord cmd;
+
+    alarm(0);
+
+    fprintf(stderr, "Barco PID: %d. Modo capitán (anillo)\n", s->pid);
+
+    while (1)
+    {
+        if (ring_pop_wait(&channel->to_ship, &cmd, 1000) != 0)
+        {
+            if (getppid() != captain) break;
+            publish_telemetry(s); // Latido mientras espera órdenes
+            continue;
+        }
+
+        if (cmd.op == RING_CMD_MOVE)
+        {
+            int ok = shift_position(s, cmd.arg0, cmd.arg1);
+            RingRecord ack = {cmd.seq, ok ? RING_ACK_OK : RING_ACK_NOK, s->x, s->y};
+            ring_push_wait(&channel->to_captain, &ack, -1);
+        }
+        else if (cmd.op == RING_CMD_EXIT)
+        {
+            fprintf(stderr, "Barco %d saliendo con oro %d.\n", s->pid, s->gold);
+            notify_ursula_terminate(s);
+            exit(s->gold);
+        }
+    }
+}
+
+/**
+ * @brief Modo aleatorio con el reloj de la flota: en vez de armar su propio alarm(), el barco duerme en la rueda del
+ * capitán hasta su turno (cada ship_speed tics) y da un paso. Si el capitán desaparece el barco deja de esperar.
+ * @param s Puntero a la estructura Ship.
+ * @param wheel Reloj compartido con el capitán.
+ */
+void clock_mode(Ship* s, TickWheel* wheel)
+{
+    pid_t captain = getppid();
+    uint32_t due = wheel_next_due(wheel, 0, ship_speed);
+
+    fprintf(stderr, "Barco PID: %d. Modo aleatorio con el reloj de la flota (cada %d tics)\n", s->pid, ship_speed);
+
+    while (1)
+    {
+        if (wheel_wait(wheel, due, 1000) != 0)
+        {
+            if (getppid() != captain) break;
+            publish_telemetry(s); // Latido mientras espera su turno
+            continue;
+        }
+        sigset_t old;
+        combat_block(1, &old); // Como en sigalrm_handler, el paso no se mezcla con combat_handler
+        random_step();
+        combat_block(0, &old);
+        due = wheel_next_due(wheel, due, ship_speed);
+    }
+}
+
 /**
  * @brief Inicializa el estado del barco, incluyendo su posición, recursos y referencia al mapa.
  * También establece el PID del barco y marca su posición inicial en el mapa.
@@ -398,10 +607,14 @@ void ship_init(Ship* s, Map* mapa, int x, int y, int food)
  * @param random_speed Puntero a un entero que contendrá la velocidad del movimiento aleatorio en segundos (por defecto 1).
  * @param use_captain Puntero a un entero que se establecerá a 1 si el modo capitán está habilitado (por defecto 0).
  * @param ursula_pipe Puntero a un string que contendrá el nombre de la tubería para la comunicación con Ursula (por defecto NULL).
+ * @param ring_fd Puntero a un entero que contendrá el descriptor heredado del canal con el capitán (por defecto -1, tuberías).
+ * @param telemetry_fd Puntero a un entero que contendrá el descriptor heredado de la página de telemetría (por defecto -1).
+ * @param clock_fd Puntero a un entero que contendrá el descriptor heredado del reloj de la flota (por defecto -1, alarm).
  * @return Devuelve 0 en caso de análisis exitoso, o un valor distinto de cero si hubo un error con los argumentos.
  */
 static int parse_args(int argc, char* argv[], char** map_file, int* pos_x, int* pos_y,
-                      int* food, int* random_steps, int* random_speed, int* use_captain, char** ursula_pipe)
+                      int* food, int* random_steps, int* random_speed, int* use_captain, char** ursula_pipe,
+                      int* ring_fd, int* telemetry_fd, int* clock_fd)
 {
     for (int i = 1; i < argc; i++)
     {
@@ -482,6 +695,48 @@ static int parse_args(int argc, char* argv[], char** map_file, int* pos_x, int*
         {
             *ursula_pipe = argv[++i];
         }
+        else if (strcmp(argv[i], "--ring-fd") == 0 && i + 1 < argc)
+        {
+            char* end;
+            long v;
+
+            errno = 0;
+            v = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || errno == ERANGE || v < 0 || v > INT_MAX)
+            {
+                fprintf(stderr, "Valor inválido para --ring-fd: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            *ring_fd = (int)v;
+        }
+        else if (strcmp(argv[i], "--telemetry-fd") == 0 && i + 1 < argc)
+        {
+            char* end;
+            long v;
+
+            errno = 0;
+            v = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || errno == ERANGE || v < 0 || v > INT_MAX)
+            {
+                fprintf(stderr, "Valor inválido para --telemetry-fd: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            *telemetry_fd = (int)v;
+        }
+        else if (strcmp(argv[i], "--clock-fd") == 0 && i + 1 < argc)
+        {
+            char* end;
+            long v;
+
+            errno = 0;
+            v = strtol(argv[++i], &end, 10);
+            if (end == argv[i] || *end != '\0' || errno == ERANGE || v < 0 || v > INT_MAX)
+            {
+                fprintf(stderr, "Valor inválido para --clock-fd: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+            *clock_fd = (int)v;
+        }
     }
     return 0;
 }
@@ -496,18 +751,28 @@ int main(int argc, char* argv[])
     int random_steps = -1;
     int random_speed = 1;
     int use_captain = 0;
+    int ring_fd = -1;
+    int telemetry_fd = -1;
+    int clock_fd = -1;
 
     if (parse_args(argc, argv, &map_file, &pos_x, &pos_y, &food, &random_steps, &random_speed, &use_captain,
-                   &ursula_fifo) != 0)
+                   &ursula_fifo, &ring_fd, &telemetry_fd, &clock_fd) != 0)
     {
         return EXIT_FAILURE;
     }
 
+    // Página de telemetría del capitán: si no se puede proyectar, el barco funciona igual (status usa SIGTSTP)
+    if (telemetry_fd != -1)
+    {
+        telemetry = telemetry_attach(telemetry_fd);
+        close(telemetry_fd);
+        if (!telemetry) perror("Error proyectando la página de telemetría");
+    }
+
     // Conectar a Ursula
     if (ursula_fifo)
     {
-        ursula_pipe = fopen(ursula_fifo, "w");
-        if (!ursula_pipe)
+        if (ursula_connect(&ursula_link, ursula_fifo) != 0)
         {
             perror("Fallo al abrir la tubería de Ursula en el barco");
             // Continuamos la ejecución, pero sin reportar a Ursula
@@ -553,15 +818,45 @@ int main(int argc, char* argv[])
     steps_remaining = random_steps;
 
     // Notify Init
+    ship_owner = getppid();
     notify_ursula_init(&ship);
+    publish_telemetry(&ship);
 
     setup_signals();
     srand(time(NULL) ^ getpid());
 
-    if (use_captain)
+    if (use_captain && ring_fd != -1)
+    {
+        ShipChannel* channel = ring_channel_attach(ring_fd);
+        close(ring_fd);
+        if (!channel)
+        {
+            perror("Error proyectando el canal con el capitán");
+            notify_ursula_terminate(&ship);
+            map_destroy(mapa);
+            return EXIT_FAILURE;
+        }
+        command_mode_ring(&ship, channel);
+        ring_channel_destroy(channel);
+    }
+    else if (use_captain)
     {
         command_mode(&ship);
     }
+    else if (clock_fd != -1)
+    {
+        TickWheel* wheel = wheel_attach(clock_fd);
+        close(clock_fd);
+        if (!wheel)
+        {
+            perror("Error proyectando el reloj de la flota");
+            notify_ursula_terminate(&ship);
+            map_destroy(mapa);
+            return EXIT_FAILURE;
+        }
+        clock_mode(&ship, wheel);
+        wheel_destroy(wheel);
+    }
     else
     {
         alarm(ship_speed);
@@ -0,0 +1,152 @@
+#include <string.h>
+#include "stats.h"
+
+static StatsTotals *group_totals(SeaStats *stats, int group) {
+    return group >= 0 && group < STATS_MAX_GROUPS ? &stats->groups[group] : NULL;
+}
+
+// Suma (sign = 1) o resta (sign = -1) lo contabilizado de item a los totales del mar y de su capitán
+static void account(SeaStats *stats, int item, int sign) {
+    StatsTotals *g = group_totals(stats, stats->group[item]);
+    stats->sea.ships += sign;
+    stats->sea.food += sign * stats->food[item];
+    stats->sea.gold += sign * stats->gold[item];
+    if (g) {
+        g->ships += sign;
+        g->food += sign * stats->food[item];
+        g->gold += sign * stats->gold[item];
+    }
+}
+
+static void heap_swap(SeaStats *stats, int a, int b) {
+    int ia = stats->heap[a], ib = stats->heap[b];
+    stats->heap[a] = ib;
+    stats->heap[b] = ia;
+    stats->heap_pos[ib] = a;
+    stats->heap_pos[ia] = b;
+}
+
+// Orden del montículo: más oro primero; a igualdad, la ranura más baja (resultado determinista)
+static int heap_before(const SeaStats *stats, int a, int b) {
+    int ia = stats->heap[a], ib = stats->heap[b];
+    if (stats->gold[ia] != stats->gold[ib]) return stats->gold[ia] > stats->gold[ib];
+    return ia < ib;
+}
+
+static void heap_fix(SeaStats *stats, int pos) {
+    while (pos > 0 && heap_before(stats, pos, (pos - 1) / 2)) {
+        heap_swap(stats, pos, (pos - 1) / 2);
+        pos = (pos - 1) / 2;
+    }
+    while (1) {
+        int best = pos, l = 2 * pos + 1, r = l + 1;
+        if (l < stats->heap_size && heap_before(stats, l, best)) best = l;
+        if (r < stats->heap_size && heap_before(stats, r, best)) best = r;
+        if (best == pos) return;
+        heap_swap(stats, pos, best);
+        pos = best;
+    }
+}
+
+void stats_init(SeaStats *stats) {
+    memset(stats, 0, sizeof(*stats));
+}
+
+/**
+ * @brief Contabiliza el estado actual de item (alta o cambio): los totales se corrigen con la diferencia respecto
+ * a lo contabilizado antes y el barco se recoloca en el montículo.
+ * @param group Capitán dueño del barco (-1 si no tiene).
+ */
+void stats_update(SeaStats *stats, int item, int group, int food, int gold) {
+    if (item < 0 || item >= STATS_MAX_ITEMS) return;
+    if (stats->present[item]) {
+        account(stats, item, -1);
+    } else {
+        stats->present[item] = 1;
+        stats->heap[stats->heap_size] = item;
+        stats->heap_pos[item] = stats->heap_size++;
+    }
+    stats->food[item] = food;
+    stats->gold[item] = gold;
+    stats->group[item] = group;
+    account(stats, item, 1);
+    heap_fix(stats, stats->heap_pos[item]);
+}
+
+/**
+ * @brief Da de baja a item de los agregados.
+ * @param banked 1 si el barco vuelve a puerto y su oro cuenta para el marcador de su capitán (TERMINATE),
+ * 0 si sólo deja de estar en este mar (traspaso a otra región).
+ */
+void stats_remove(SeaStats *stats, int item, int banked) {
+    if (item < 0 || item >= STATS_MAX_ITEMS || !stats->present[item]) return;
+    account(stats, item, -1);
+    if (banked) {
+        StatsTotals *g = group_totals(stats, stats->group[item]);
+        stats->sea.banked += stats->gold[item];
+        if (g) g->banked += stats->gold[item];
+    }
+    stats->present[item] = 0;
+
+    int pos = stats->heap_pos[item];
+    heap_swap(stats, pos, --stats->heap_size);
+    if (pos < stats->heap_size) heap_fix(stats, pos);
+}
+
+/**
+ * @brief Deja a cero los totales de un capitán que se ha ido, para que su ranura se pueda reutilizar. Sus barcos
+ * que sigan a flote deben haberse reasignado antes (stats_update con otro grupo).
+ */
+void stats_reset_group(SeaStats *stats, int group) {
+    StatsTotals *g = group_totals(stats, group);
+    if (g) memset(g, 0, sizeof(*g));
+}
+
+// Montículo auxiliar de candidatos (posiciones del montículo principal), con el mismo orden
+static void cand_push(const SeaStats *stats, int *cand, int *n, int pos) {
+    int j = (*n)++;
+    cand[j] = pos;
+    while (j > 0 && heap_before(stats, cand[j], cand[(j - 1) / 2])) {
+        int t = cand[j];
+        cand[j] = cand[(j - 1) / 2];
+        cand[(j - 1) / 2] = t;
+        j = (j - 1) / 2;
+    }
+}
+
+static int cand_pop(const SeaStats *stats, int *cand, int *n) {
+    int top = cand[0], j = 0;
+    cand[0] = cand[--(*n)];
+    while (1) {
+        int best = j, l = 2 * j + 1, r = l + 1;
+        if (l < *n && heap_before(stats, cand[l], cand[best])) best = l;
+        if (r < *n && heap_before(stats, cand[r], cand[best])) best = r;
+        if (best == j) return top;
+        int t = cand[j];
+        cand[j] = cand[best];
+        cand[best] = t;
+        j = best;
+    }
+}
+
+/**
+ * @brief Los k barcos con más oro, de más a menos, recorriendo sólo la cima del montículo: un montículo auxiliar
+ * de candidatos guarda los hijos de los ya elegidos, así que el coste es O(k log k).
+ * @return Número de barcos escritos en out (k, o menos si no hay tantos).
+ */
+int stats_top_gold(const SeaStats *stats, int k, int *out) {
+    int cand[STATS_MAX_ITEMS + 1];
+    int n_cand = 0, found = 0;
+
+    if (k > stats->heap_size) k = stats->heap_size;
+    if (k <= 0) return 0;
+    cand_push(stats, cand, &n_cand, 0);
+
+    while (found < k) {
+        int pos = cand_pop(stats, cand, &n_cand);
+        out[found++] = stats->heap[pos];
+        if (2 * pos + 1 < stats->heap_size) cand_push(stats, cand, &n_cand, 2 * pos + 1);
+        if (2 * pos + 2 < stats->heap_size) cand_push(stats, cand, &n_cand, 2 * pos + 2);
+    }
+    return found;
+}
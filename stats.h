@@ -0,0 +1,46 @@
+/**
+ * @file stats.h
+ * @brief Agregados de Ursula mantenidos de forma incremental: totales del mar, totales por capitán y un
+ * montículo de máximos por oro.
+ *
+ * Cada cambio de un barco (alta, movimiento, combate, baja) se aplica como la diferencia con lo último que se
+ * contabilizó de ese barco, en O(log n) por el montículo. Los totales se leen en O(1) y los k barcos más ricos
+ * en O(k log k), sin recorrer la tabla de barcos.
+ */
+
+#ifndef STATS_H
+#define STATS_H
+
+#include "world.h"
+
+#define STATS_MAX_ITEMS WORLD_MAX_SHIPS
+#define STATS_MAX_GROUPS 100            // Capitanes (misma numeración que la tabla de capitanes de Ursula)
+
+typedef struct {
+    int ships;                  // Barcos activos
+    long food;                  // Comida a bordo
+    long gold;                  // Oro a bordo
+    long banked;                // Oro de los barcos que ya volvieron a puerto (TERMINATE)
+} StatsTotals;
+
+typedef struct {
+    StatsTotals sea;
+    StatsTotals groups[STATS_MAX_GROUPS];
+    // Último valor contabilizado de cada barco (por ranura de la tabla de barcos)
+    int present[STATS_MAX_ITEMS];
+    int food[STATS_MAX_ITEMS];
+    int gold[STATS_MAX_ITEMS];
+    int group[STATS_MAX_ITEMS];         // Capitán dueño, -1 si no tiene
+    // Montículo de máximos por oro y posición de cada barco en él
+    int heap[STATS_MAX_ITEMS];
+    int heap_pos[STATS_MAX_ITEMS];
+    int heap_size;
+} SeaStats;
+
+void stats_init(SeaStats *stats);
+void stats_update(SeaStats *stats, int item, int group, int food, int gold);
+void stats_remove(SeaStats *stats, int item, int banked);
+void stats_reset_group(SeaStats *stats, int group);
+int stats_top_gold(const SeaStats *stats, int k, int *out);
+
+#endif
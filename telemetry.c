@@ -0,0 +1,68 @@
+#define _GNU_SOURCE
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include "telemetry.h"
+
+/**
+ * @brief Crea la página de telemetría de un barco en un memfd, que el hijo hereda a través de exec.
+ * @param fd Devuelve el descriptor del memfd; el padre debe cerrarlo tras el fork.
+ * @return La página proyectada (a cero), o NULL en caso de error.
+ */
+ShipTelemetry* telemetry_create(int *fd) {
+    *fd = memfd_create("ship-telemetry", 0);
+    if (*fd == -1) return NULL;
+    if (ftruncate(*fd, sizeof(ShipTelemetry)) == -1) {
+        close(*fd);
+        return NULL;
+    }
+    ShipTelemetry *page = telemetry_attach(*fd);
+    if (!page) close(*fd);
+    return page;
+}
+
+/** @brief Proyecta una página creada por telemetry_create (en el barco, a partir del descriptor heredado). */
+ShipTelemetry* telemetry_attach(int fd) {
+    ShipTelemetry *page = mmap(NULL, sizeof(ShipTelemetry), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return page == MAP_FAILED ? NULL : page;
+}
+
+void telemetry_destroy(ShipTelemetry *page) {
+    if (page) munmap(page, sizeof(ShipTelemetry));
+}
+
+int64_t telemetry_now_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/** @brief Publica el estado del barco y renueva su latido. Segura dentro de un manejador de señales. */
+void telemetry_publish(ShipTelemetry *page, int pid, int x, int y, int food, int gold) {
+    if (!page) return;
+    __atomic_store_n(&page->x, x, __ATOMIC_RELAXED);
+    __atomic_store_n(&page->y, y, __ATOMIC_RELAXED);
+    __atomic_store_n(&page->food, food, __ATOMIC_RELAXED);
+    __atomic_store_n(&page->gold, gold, __ATOMIC_RELAXED);
+    __atomic_store_n(&page->last_tick_ms, telemetry_now_ms(), __ATOMIC_RELAXED);
+    __atomic_store_n(&page->pid, pid, __ATOMIC_RELEASE);
+}
+
+/** @brief Cuenta un intento de movimiento: realizado (moved != 0) o rechazado. */
+void telemetry_count(ShipTelemetry *page, int moved) {
+    if (!page) return;
+    __atomic_fetch_add(moved ? &page->moves : &page->rejected, 1, __ATOMIC_RELAXED);
+}
+
+/** @brief Copia los campos de una página. out->pid queda a 0 si el barco aún no la ha publicado. */
+void telemetry_read(const ShipTelemetry *page, ShipTelemetry *out) {
+    out->pid = __atomic_load_n(&page->pid, __ATOMIC_ACQUIRE);
+    out->x = __atomic_load_n(&page->x, __ATOMIC_RELAXED);
+    out->y = __atomic_load_n(&page->y, __ATOMIC_RELAXED);
+    out->food = __atomic_load_n(&page->food, __ATOMIC_RELAXED);
+    out->gold = __atomic_load_n(&page->gold, __ATOMIC_RELAXED);
+    out->moves = __atomic_load_n(&page->moves, __ATOMIC_RELAXED);
+    out->rejected = __atomic_load_n(&page->rejected, __ATOMIC_RELAXED);
+    out->last_tick_ms = __atomic_load_n(&page->last_tick_ms, __ATOMIC_RELAXED);
+    out->pad = 0;
+}
@@ -0,0 +1,39 @@
+/**
+ * @file telemetry.h
+ * @brief Página de telemetría de un barco en memoria compartida (memfd heredado por el barco, como los canales).
+ *
+ * El barco es el único escritor y actualiza cada campo con un store atómico independiente (también desde sus
+ * manejadores de señales); el capitán lee las páginas sin bloqueos ni llamadas al sistema. Cada campo es
+ * coherente por sí mismo, aunque una lectura puede mezclar valores de dos actualizaciones seguidas.
+ */
+
+#ifndef TELEMETRY_H
+#define TELEMETRY_H
+
+#include <stdint.h>
+
+typedef struct {
+    int32_t pid;                // 0 hasta que el barco se inicializa
+    int32_t x;
+    int32_t y;
+    int32_t food;
+    int32_t gold;
+    uint32_t moves;             // Movimientos realizados
+    uint32_t rejected;          // Movimientos rechazados (sin comida o destino bloqueado)
+    uint32_t pad;
+    int64_t last_tick_ms;       // Último latido del barco (CLOCK_MONOTONIC)
+} ShipTelemetry;
+
+ShipTelemetry* telemetry_create(int *fd);
+ShipTelemetry* telemetry_attach(int fd);
+void telemetry_destroy(ShipTelemetry *page);
+
+// Barco
+void telemetry_publish(ShipTelemetry *page, int pid, int x, int y, int food, int gold);
+void telemetry_count(ShipTelemetry *page, int moved);
+
+// Capitán
+void telemetry_read(const ShipTelemetry *page, ShipTelemetry *out);
+int64_t telemetry_now_ms(void);
+
+#endif
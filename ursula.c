@@ -7,28 +7,106 @@
 #include <signal.h>
 #include <errno.h>
 #include <time.h>
-
-#define MAX_SHIPS 1000
-#define MAX_CAPTAINS 100
-
+#include <limits.h>
+#include <stdint.h>
+#include <pthread.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include <sys/epoll.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <sys/syscall.h>
+#include "world.h"
+#include "ursula.h"
+#include "engine.h"
+#include "ledger.h"
+#include "placement.h"
+
+#define QUERY_MAX_CLIENTS 64
+#define QUERY_LINE_MAX 256
+#define BATCH_MAX 4096              // Eventos que Ursula toma como máximo en cada pasada
+#define OVERLOAD_BATCH 64           // A partir de este atraso, Ursula prioriza el control y agrupa los MOVE
+#define COALESCE_SLOTS (2 * BATCH_MAX)
+
+#define MAX_SHIPS ENGINE_MAX_SHIPS
+#define MAX_CAPTAINS ENGINE_MAX_CAPTAINS
+
+// Estado del mar: barcos, capitanes, combate y tesoro (libursula); ursula es la capa de transporte
+Engine *sea = NULL;
+// Vigilancia de cada proceso registrado (ver watch_process), por ranura del motor; -1 si no se pudo abrir
+int ship_pidfd[MAX_SHIPS];
+int captain_pidfd[MAX_CAPTAINS];
+// Tesoro inicial
+int treasury = 100;
+// Libro del tesoro común cuando Ursula forma parte de una federación (NULL: el tesoro es local)
+Ledger *ledger = NULL;
+// Posición de esta Ursula en el fichero de federación (su cuenta en el libro)
+int region_index = 0;
+char *global_fifo_path = NULL;
+// Estado del mar publicado en memoria compartida para capitanes y visores (NULL si no se pudo crear)
+WorldState *world = NULL;
+// Anillo de eventos en memoria compartida (modo --ring), NULL si sólo se escucha el FIFO
+MpscRing *events = NULL;
+// Socket de consultas espaciales y su ruta (-1 si no se pudo crear)
+int query_fd = -1;
+char query_path[sizeof(((struct sockaddr_un *)0)->sun_path)];
+// epoll con un pidfd por barco y capitán registrados, atendido por el hilo reaper (-1 si no hay vigilancia)
+int reap_fd = -1;
+// Extremo de escritura del propio FIFO, por el que el hilo reaper da de baja a los procesos muertos
+int reap_fifo = -1;
+// Tubería interna por la que se pasan al hilo reaper los procesos que murieron antes de poder vigilarlos
+int reap_pipe[2] = {-1, -1};
+// Protege el estado de Ursula entre el hilo principal (eventos) y el hilo de consultas
+pthread_mutex_t sea_lock = PTHREAD_MUTEX_INITIALIZER;
+// Duración del turno de combate en ms (--tick); 0: el combate se resuelve tras cada MOVE
+int tick_ms = 0;
+// CPUs reservadas para Ursula (--cpus), vacía si no se fijó afinidad
+CpuList ursula_cpus;
+
+// Resultados de combate de un barco pendientes de notificar: variaciones de comida y oro acumuladas
 typedef struct {
     int pid;
-    int x;
-    int y;
     int food;
     int gold;
-    int active;
-} ShipInfo;
+    int queued;                 // La ranura figura en pending
+} Outcome;
 
-typedef struct {
-    int pid;
-    int active;
-} CaptainInfo;
+// Resultados por ranura de la tabla de barcos, y ranuras con resultados por enviar
+Outcome outcomes[MAX_SHIPS];
+int pending[MAX_SHIPS];
+int pending_count = 0;
 
-ShipInfo ships[MAX_SHIPS];
-CaptainInfo captains[MAX_CAPTAINS];
-int treasury = 100;
-char *global_fifo_path = NULL;
+/**
+ * @brief Retira el segmento de memoria compartida al salir, por cualquier camino (fin normal, SIGINT o bancarrota).
+ */
+void cleanup_world(void) {
+    if (world) {
+        world_destroy(world);
+        world = NULL;
+    }
+}
+
+void cleanup_query(void) {
+    if (query_fd != -1) {
+        close(query_fd);
+        unlink(query_path);
+        query_fd = -1;
+    }
+}
+
+void cleanup_ledger(void) {
+    if (ledger) {
+        ledger_leave(ledger, region_index);
+        ledger = NULL;
+    }
+}
+
+void cleanup_events(void) {
+    if (events) {
+        mpsc_destroy(events);
+        events = NULL;
+    }
+}
 
 
 void handle_sigint_ursula(int sig) {
@@ -41,182 +119,615 @@ void handle_sigint_ursula(int sig) {
 }
 
 /**
- * @brief Encuentra el índice de un barco en el array de barcos basado en su PID.
- * Itera a través del array de barcos, buscando un barco activo con un PID coincidente. Si lo encuentra, devuelve el índice;
- * de lo contrario, devuelve -1 para indicar que el barco no fue encontrado.
- * @param pid El ID del proceso del barco a encontrar.
- * @return El índice del barco en el array de barcos si se encuentra, o -1 si no se encuentra.
+ * @brief Envía los resultados de combate pendientes: una señal de tiempo real por barco con la suma de sus
+ * variaciones. Si la cola de señales del barco está llena (EAGAIN) el resultado se conserva para el siguiente envío.
  */
-int find_ship_index(int pid) {
-    for (int i = 0; i < MAX_SHIPS; i++) {
-        if (ships[i].active && ships[i].pid == pid) return i;
+void flush_outcomes(void) {
+    int kept = 0;
+    for (int i = 0; i < pending_count; i++) {
+        Outcome *o = &outcomes[pending[i]];
+        union sigval value;
+        value.sival_int = ursula_combat_pack(o->food, o->gold);
+        if (sigqueue(o->pid, URSULA_COMBAT_SIGNAL, value) == -1 && errno == EAGAIN) {
+            pending[kept++] = pending[i];
+        } else {
+            o->queued = 0;
+        }
     }
-    return -1;
+    pending_count = kept;
 }
 
 /**
- * @brief Añade un nuevo barco al array de barcos con los parámetros dados.
- * Busca una ranura inactiva en el array de barcos, y si la encuentra, inicializa la información del barco (PID,
- * posición, comida, oro) y lo marca como activo. La función devuelve el índice del barco recién añadido o -1 si no
- * hay ranuras disponibles.
- * @param pid El ID del proceso del nuevo barco.
- * @param x La coordenada x inicial del barco.
- * @param y La coordenada y inicial del barco.
- * @param food La cantidad inicial de comida para el barco.
- * @param gold La cantidad inicial de oro para el barco.
- * @return El índice del barco recién añadido en el array de barcos, o -1 si no hay ranuras disponibles.
+ * @brief Descarta lo pendiente para la ranura idx, que era del barco que la ocupaba antes (ya dado de baja).
+ * No toca al resto de ranuras: su envío sigue esperando al cierre del turno.
  */
-int add_ship(int pid, int x, int y, int food, int gold) {
-    for (int i = 0; i < MAX_SHIPS; i++) {
-        if (!ships[i].active) {
-            ships[i].pid = pid;
-            ships[i].x = x;
-            ships[i].y = y;
-            ships[i].food = food;
-            ships[i].gold = gold;
-            ships[i].active = 1;
-            return i;
+void discard_outcome(int idx) {
+    for (int i = 0; i < pending_count; i++) {
+        if (pending[i] == idx) {
+            pending[i] = pending[--pending_count];
+            break;
         }
     }
-    return -1;
+    outcomes[idx].queued = 0;
 }
 
 /**
- * @brief Encuentra el índice de un capitán en el array de capitanes basado en su PID.
- * Itera a través del array de capitanes, buscando un capitán activo con un PID coincidente. Si lo encuentra, devuelve el
- * índice; de lo contrario, devuelve -1 para indicar que el capitán no fue encontrado.
- * @param pid El ID del proceso del capitán a encontrar.
- * @return El índice del capitán en el array de capitanes si se encuentra, o -1 si no se encuentra.
+ * @brief Anota el resultado de un combate para el barco idx y lo envía al momento o, en modo --tick, al cerrar el turno.
+ * @param pid PID del barco.
+ * @param food Variación exacta de la comida del barco según los libros de Ursula.
+ * @param gold Variación exacta del oro.
  */
-int find_captain_index(int pid) {
-    for (int i = 0; i < MAX_CAPTAINS; i++) {
-        if (captains[i].active && captains[i].pid == pid) return i;
+void notify_outcome(int idx, int pid, int food, int gold) {
+    Outcome *o = &outcomes[idx];
+    if (!o->queued) {
+        o->pid = pid;
+        o->food = 0;
+        o->gold = 0;
+        o->queued = 1;
+        pending[pending_count++] = idx;
     }
-    return -1;
+    o->food += food;
+    o->gold += gold;
+    if (tick_ms <= 0) flush_outcomes();
 }
 
 /**
- * @brief Añade un nuevo capitán al array de capitanes con el PID dado.
- * Busca una ranura inactiva en el array de capitanes, y si la encuentra, inicializa la información del capitán (PID)
- * y lo marca como activo. La función devuelve el índice del capitán recién añadido o -1 si no hay ranuras disponibles.
- * @param pid El ID del proceso del nuevo capitán.
- * @return El índice del capitán recién añadido en el array de capitanes, o -1 si no hay ranuras disponibles.
+ * @brief Empieza a vigilar un proceso registrado con un pidfd en el epoll del hilo reaper. Si el proceso ya ha
+ * muerto, se le pasa al hilo reaper por reap_pipe para que lo dé de baja igual que si hubiera muerto después.
+ * @param pid Proceso a vigilar.
+ * @param type Evento con el que se le dará de baja si muere sin despedirse (URSULA_LOST o URSULA_END_CAPT).
+ * @return El pidfd, o -1 si no hay vigilancia (sin pidfd en el núcleo o el proceso ya no existe).
  */
-int add_captain(int pid) {
-    for (int i = 0; i < MAX_CAPTAINS; i++) {
-        if (!captains[i].active) {
-            captains[i].pid = pid;
-            captains[i].active = 1;
-            return i;
+int watch_process(int pid, int type) {
+    if (reap_fd == -1) return -1;
+    int fd = (int)syscall(SYS_pidfd_open, pid, 0);
+    if (fd == -1) {
+        // No se escribe en el FIFO desde aquí: este hilo es quien lo lee y se bloquearía si estuviera lleno
+        uint64_t dead = ((uint64_t)type << 32) | (uint32_t)pid;
+        if (errno == ESRCH && write(reap_pipe[1], &dead, sizeof(dead)) != sizeof(dead)) {
+            perror("Aviso: no se pudo dar de baja un proceso muerto");
         }
+        return -1;
     }
-    return -1;
+
+    // EPOLLONESHOT: el proceso muerto se notifica una vez, aunque su pidfd siga legible hasta que se cierre
+    struct epoll_event ev = {.events = EPOLLIN | EPOLLONESHOT, .data.u64 = ((uint64_t)type << 32) | (uint32_t)pid};
+    if (epoll_ctl(reap_fd, EPOLL_CTL_ADD, fd, &ev) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/** @brief Deja de vigilar un proceso dado de baja (cerrar el pidfd lo retira también del epoll). */
+void unwatch_process(int *pidfd) {
+    if (*pidfd != -1) close(*pidfd);
+    *pidfd = -1;
+}
+
+/** @brief Escribe en el FIFO la baja de un proceso muerto, con el formato de una línea de texto normal. */
+static void report_dead(uint64_t dead) {
+    char line[64];
+    int pid = (int)(uint32_t)dead;
+    int type = (int)(dead >> 32);
+    int len = snprintf(line, sizeof(line), "%d,%s\n", pid, type == URSULA_END_CAPT ? "END_CAPT" : "LOST");
+    if (write(reap_fifo, line, len) != len) perror("Aviso: no se pudo dar de baja un proceso muerto");
 }
 
 /**
- * @brief Resuelve el combate entre barcos situados en las mismas coordenadas (x, y).
- * La función identifica a todos los barcos en la ubicación especificada, selecciona aleatoriamente a un ganador entre ellos, y procesa a los
- * perdedores decrementando su comida y oro. El botín de los perdedores se junta en un pozo, y el ganador es recompensado
- * con oro de este pozo. Si el pozo es insuficiente para recompensar al ganador, Ursula subsidia la diferencia de su
- * tesoro. Si el tesoro no puede cubrir el subsidio, envía una señal a todos los capitanes para terminar y sale del programa.
- * @param x La coordenada x de la ubicación del combate.
- * @param y La coordenada y de la ubicación del combate.
+ * @brief Hilo reaper: espera a que muera algún barco o capitán registrado (SIGKILL, fallo, TERMINATE perdido) y
+ * escribe su baja en el FIFO como si la hubiera enviado él, para que se aplique en orden con el resto de eventos
+ * y libere su ranura y su celda. Si el proceso sí se despidió, la baja repetida no tiene efecto.
  */
-void resolve_combat(int x, int y) {
-    int combatants[MAX_SHIPS];
-    int count = 0;
-
-    // Identificar barcos en esta ubicación
-    for (int i = 0; i < MAX_SHIPS; i++) {
-        if (ships[i].active && ships[i].x == x && ships[i].y == y) {
-            combatants[count++] = i;
+void *reaper(void *arg) {
+    (void)arg;
+    struct epoll_event events[64];
+    uint64_t dead[64];
+
+    while (1) {
+        int n = epoll_wait(reap_fd, events, 64, -1);
+        if (n == -1 && errno != EINTR) return NULL;
+        for (int i = 0; i < n; i++) {
+            if (events[i].data.u64 != 0) {
+                report_dead(events[i].data.u64);
+                continue;
+            }
+            // Procesos que ya habían muerto cuando watch_process intentó vigilarlos
+            ssize_t got;
+            while ((got = read(reap_pipe[0], dead, sizeof(dead))) > 0) {
+                for (size_t k = 0; k < (size_t)got / sizeof(dead[0]); k++) report_dead(dead[k]);
+            }
         }
     }
+}
 
-    if (count < 2) return; // No se necesita pelear
+/**
+ * @brief Prepara la vigilancia de procesos y lanza el hilo reaper. Sin ella, un barco muerto sin despedirse
+ * ocupa su ranura hasta que Ursula termine.
+ * @return 0 en caso de éxito, -1 si la vigilancia no está disponible.
+ */
+int start_reaper(const char *fifo) {
+    pthread_t thread;
+
+    reap_fifo = open(fifo, O_WRONLY | O_CLOEXEC);
+    reap_fd = epoll_create1(EPOLL_CLOEXEC);
+    if (pipe(reap_pipe) == 0) {
+        // Ninguno de los dos hilos se bloquea en la tubería: el reaper la vacía entera en cada aviso del epoll
+        for (int k = 0; k < 2; k++) {
+            fcntl(reap_pipe[k], F_SETFL, O_NONBLOCK);
+            fcntl(reap_pipe[k], F_SETFD, FD_CLOEXEC);
+        }
+    }
+    // Dato 0 en el epoll: hay procesos en reap_pipe (ningún pid vigilado es 0)
+    struct epoll_event ev = {.events = EPOLLIN, .data.u64 = 0};
+    if (reap_fifo == -1 || reap_fd == -1 || reap_pipe[0] == -1 ||
+        epoll_ctl(reap_fd, EPOLL_CTL_ADD, reap_pipe[0], &ev) == -1 ||
+        pthread_create(&thread, NULL, reaper, NULL) != 0) {
+        if (reap_fifo != -1) close(reap_fifo);
+        if (reap_fd != -1) close(reap_fd);
+        if (reap_pipe[0] != -1) close(reap_pipe[0]);
+        if (reap_pipe[1] != -1) close(reap_pipe[1]);
+        reap_fifo = reap_fd = reap_pipe[0] = reap_pipe[1] = -1;
+        return -1;
+    }
+    pthread_detach(thread);
+    return 0;
+}
 
-    fprintf(stdout, "[Ursula] ¡Combate en (%d, %d) entre %d barcos!\n", x, y, count);
+/**
+ * @brief Consume los eventos de salida del motor: escribe el registro de la partida, notifica a cada barco el
+ * resultado de sus combates y vigila los procesos que se dan de alta. En bancarrota envía lo pendiente, señaliza a
+ * todos los capitanes para que terminen y sale del programa. Se llama con sea_lock tomado.
+ */
+void drain_events(void) {
+    const EngineEvent *out;
+    int n = engine_events(sea, &out);
+
+    for (int i = 0; i < n; i++) {
+        const EngineEvent *e = &out[i];
+        switch (e->type) {
+            case ENGINE_EV_SHIP_JOINED:
+                ship_pidfd[e->slot] = watch_process(e->pid, URSULA_LOST);
+                if (outcomes[e->slot].queued) discard_outcome(e->slot); // Lo pendiente era para el barco anterior de la ranura
+                break;
+            case ENGINE_EV_SHIP_LEFT:
+                unwatch_process(&ship_pidfd[e->slot]);
+                break;
+            case ENGINE_EV_CAPTAIN_JOINED:
+                captain_pidfd[e->slot] = watch_process(e->pid, URSULA_END_CAPT);
+                break;
+            case ENGINE_EV_CAPTAIN_LEFT:
+                unwatch_process(&captain_pidfd[e->slot]);
+                fprintf(stdout, "[Ursula] Capitán %d se ha desconectado. Oro llevado a puerto: %ld; a flote: %d en %d barcos.\n",
+                        e->pid, e->banked, e->gold, e->amount);
+                break;
+            case ENGINE_EV_COMBAT:
+                fprintf(stdout, "[Ursula] ¡Combate en (%d, %d) entre %d barcos!\n", e->x, e->y, e->amount);
+                break;
+            case ENGINE_EV_LOSS:
+                notify_outcome(e->slot, e->pid, e->dfood, e->dgold);
+                fprintf(stdout, "[Ursula] Barco %d perdió el combate. Comida: %d, Oro: %d.\n", e->pid, e->food, e->gold);
+                break;
+            case ENGINE_EV_WIN:
+                notify_outcome(e->slot, e->pid, 0, e->dgold);
+                if (e->amount >= 0) {
+                    fprintf(stdout, "[Ursula] ¡Barco %d ganó! Recibió %d de oro. Ursula cobró un impuesto de %d de oro.\n",
+                            e->pid, e->dgold, e->amount);
+                } else {
+                    fprintf(stdout, "[Ursula] ¡Barco %d ganó! Recibió %d de oro (Subsidiado con %d). Tesoro: %d.\n",
+                            e->pid, e->dgold, -e->amount, e->treasury);
+                }
+                break;
+            case ENGINE_EV_BANKRUPT: {
+                // EL FIN DEL MUNDO
+                int pids[MAX_CAPTAINS];
+                int count = engine_captains(sea, pids, MAX_CAPTAINS);
+                notify_outcome(e->slot, e->pid, 0, e->dgold);
+                fprintf(stderr, "[Ursula] ¡BANCARROTA DEL TESORO (%d)! No se puede pagar el subsidio de %d. EL FIN ESTÁ CERCA.\n",
+                        e->treasury, e->amount);
+                flush_outcomes();
+
+                // El motor ya cerró su sección de escritura (el estado publicado es coherente): se suelta también el
+                // cerrojo para que el hilo de consultas no quede bloqueado mientras el proceso termina
+                pthread_mutex_unlock(&sea_lock);
+
+                // Matar a todos los capitanes
+                for (int k = 0; k < count; k++) {
+                    fprintf(stderr, "[Ursula] Señalizando al Capitán %d para que termine.\n", pids[k]);
+                    kill(pids[k], SIGINT);
+                }
+                exit(EXIT_SUCCESS);
+            }
+        }
+    }
+    engine_clear_events(sea);
+    if (tick_ms <= 0) flush_outcomes();
+}
 
-    // Escoger un ganador
-    int winner_idx_in_combatants = rand() % count;
-    int winner_ship_idx = combatants[winner_idx_in_combatants];
+/**
+ * @brief Cierra un turno de combate (modo --tick) en el motor; las notificaciones se envían todas al final.
+ */
+void resolve_tick(void) {
+    pthread_mutex_lock(&sea_lock);
+    engine_tick(sea);
+    drain_events();
+    pthread_mutex_unlock(&sea_lock);
 
-    int loot_pool = 0;
+    flush_outcomes();
+}
 
-    // Procesar Perdedores
-    for (int i = 0; i < count; i++) {
-        if (i == winner_idx_in_combatants) continue;
+/**
+ * @brief Aplica un evento de un barco o capitán al motor (que lo publica en el estado compartido) y escribe el
+ * registro de la partida.
+ * @param ev Evento recibido por cualquiera de los transportes.
+ * @return 1 si todas las flotas han partido y Ursula debe terminar, 0 en caso contrario.
+ */
+int handle_event(const UrsulaEvent *ev) {
+    int pid = ev->pid;
+
+    // Por si acaso algun init no llego...
+    int unregistered = ev->type == URSULA_MOVE && engine_find_ship(sea, pid) == -1;
+    if (unregistered) fprintf(stderr, "[Ursula] ADVERTENCIA: Barco %d no estaba registrado...\n", pid);
+
+    // El registro del evento va antes que los combates que provoque
+    int idx = engine_apply(sea, ev);
+    if (ev->type == URSULA_INIT_CAPT) {
+        fprintf(stdout, "[Ursula] Capitán %d registrado.\n", pid);
+    } else if (ev->type == URSULA_INIT) {
+        fprintf(stdout, "[Ursula] Barco %d registrado en (%d, %d).\n", pid, ev->x, ev->y);
+    } else if (idx != -1 && ev->type == URSULA_MOVE && !unregistered) {
+        fprintf(stdout, "[Ursula] Barco %d se movió a (%d, %d). Comida: %d, Oro: %d.\n", pid, ev->x, ev->y, ev->food, ev->gold);
+    } else if (idx != -1 && ev->type == URSULA_ARRIVE) {
+        fprintf(stdout, "[Ursula] Barco %d llega desde otra región a (%d, %d).\n", pid, ev->x, ev->y);
+    } else if (idx != -1 && ev->type == URSULA_TERMINATE) {
+        fprintf(stdout, "[Ursula] Barco %d terminado.\n", pid);
+    } else if (idx != -1 && ev->type == URSULA_LOST) {
+        fprintf(stdout, "[Ursula] Barco %d perdido sin volver a puerto; su oro se hunde con él.\n", pid);
+    } else if (idx != -1 && ev->type == URSULA_LEAVE) {
+        fprintf(stdout, "[Ursula] Barco %d ha pasado a otra región.\n", pid);
+    }
+    drain_events();
 
-        int loser_idx = combatants[i];
+    // Comprobar Condición de Terminación Global
+    if (engine_finished(sea)) {
+        fprintf(stdout, "[Ursula] Todas las flotas han partido. El mar está en silencio. Oro llevado a puerto: %ld.\n",
+                engine_totals(sea)->banked);
+        return 1;
+    }
+    return 0;
+}
 
-        // Decrementar Comida (estado interno de Ursula)
-        if (ships[loser_idx].food >= 10) {
-            ships[loser_idx].food -= 10;
-        } else {
-            ships[loser_idx].food = 0;
+/**
+ * @brief Hilo lector del FIFO en modo --ring: los clientes que no usan el anillo siguen escribiendo en el FIFO,
+ * y este hilo reenvía sus líneas al anillo como un productor más, de modo que el hilo principal sólo consume
+ * el anillo y los eventos de ambos transportes se aplican en un único orden.
+ * Lee con read y no con getline: un FILE* bloqueado por este hilo impediría que exit vaciara los flujos.
+ * @param arg Descriptor del FIFO abierto (en un intptr_t).
+ */
+void *fifo_reader(void *arg) {
+    int fd = (int)(intptr_t)arg;
+    static UrsulaLineBuffer lines;
+    UrsulaEvent ev;
+    MpscRecord rec;
+
+    while (ursula_lines_fill(&lines, fd) >= 0) {
+        while (ursula_lines_take(&lines, &ev, 1) == 1) {
+            ursula_pack(&ev, &rec);
+            mpsc_push_wait(events, &rec);
         }
+    }
+    return NULL;
+}
 
-        // Decrementar Oro (Transferir al pozo - estado interno de Ursula)
-        if (ships[loser_idx].gold >= 10) {
-            ships[loser_idx].gold -= 10;
-            loot_pool += 10;
-        } else {
-            // Tomar lo que tengan
-            loot_pool += ships[loser_idx].gold;
-            ships[loser_idx].gold = 0;
+// Entrada de la tabla de agrupación de un lote: último MOVE y última baja (TERMINATE/LEAVE) de cada PID
+typedef struct {
+    int pid;
+    unsigned int generation;    // Lote al que pertenece la entrada; las de lotes anteriores cuentan como libres
+    int last_move;
+    int last_stop;
+} CoalesceEntry;
+
+/**
+ * @brief Aplica un lote de eventos pendientes. Con poco atraso se aplican en orden de llegada, uno a uno.
+ * En sobrecarga (al menos OVERLOAD_BATCH eventos) se aplican primero los mensajes de control (altas, bajas,
+ * capitanes, traspasos) en su orden, y después, de cada barco, sólo el último MOVE del lote, de modo que el
+ * combate se resuelve sobre las posiciones agrupadas. Un MOVE anterior a la baja de su barco se descarta.
+ * @param batch Eventos en orden de llegada.
+ * @param n Número de eventos.
+ * @return 1 si todas las flotas han partido y Ursula debe terminar, 0 en caso contrario.
+ */
+int process_batch(UrsulaEvent *batch, int n) {
+    static CoalesceEntry table[COALESCE_SLOTS];
+    static unsigned int generation = 0;
+    static uint32_t coalesced = 0;
+    static int overloaded = 0;
+    int done = 0;
+
+    pthread_mutex_lock(&sea_lock);
+
+    if (n >= OVERLOAD_BATCH && !overloaded) {
+        fprintf(stdout, "[Ursula] Sobrecarga: %d eventos pendientes, se agrupan los movimientos.\n", n);
+    } else if (n < OVERLOAD_BATCH && overloaded) {
+        fprintf(stdout, "[Ursula] Atraso recuperado.\n");
+    }
+    overloaded = n >= OVERLOAD_BATCH;
+
+    if (!overloaded) {
+        for (int i = 0; i < n && !done; i++) done = handle_event(&batch[i]);
+    } else {
+        generation++;
+        CoalesceEntry *entry[BATCH_MAX];
+        for (int i = 0; i < n; i++) {
+            unsigned int h = ((unsigned int)batch[i].pid * 2654435761u) & (COALESCE_SLOTS - 1);
+            while (table[h].generation == generation && table[h].pid != batch[i].pid) h = (h + 1) & (COALESCE_SLOTS - 1);
+            if (table[h].generation != generation) {
+                table[h].pid = batch[i].pid;
+                table[h].generation = generation;
+                table[h].last_move = -1;
+                table[h].last_stop = -1;
+            }
+            entry[i] = &table[h];
+            if (batch[i].type == URSULA_MOVE) table[h].last_move = i;
+            else if (batch[i].type == URSULA_TERMINATE || batch[i].type == URSULA_LEAVE ||
+                     batch[i].type == URSULA_LOST) table[h].last_stop = i;
         }
 
-        kill(ships[loser_idx].pid, SIGUSR2);
+        for (int i = 0; i < n && !done; i++) {
+            if (batch[i].type != URSULA_MOVE) done = handle_event(&batch[i]);
+        }
+        for (int i = 0; i < n && !done; i++) {
+            if (batch[i].type != URSULA_MOVE) continue;
+            if (entry[i]->last_move == i && entry[i]->last_stop < i) done = handle_event(&batch[i]);
+            else coalesced++;
+        }
+    }
 
-        fprintf(stdout, "[Ursula] Barco %d perdió el combate. Comida: %d, Oro: %d.\n",
-                ships[loser_idx].pid, ships[loser_idx].food, ships[loser_idx].gold);
+    // Indicador de atraso para los lectores del estado compartido
+    if (world) {
+        world_write_begin(world);
+        world->backlog = n;
+        world->coalesced = coalesced;
+        world_write_end(world);
     }
 
-    // Recompensar Ganador
-    int reward_needed = 10;
+    pthread_mutex_unlock(&sea_lock);
+    return done;
+}
 
-    kill(ships[winner_ship_idx].pid, SIGUSR1);
+typedef struct {
+    int fd;
+    size_t used;
+    char buf[QUERY_LINE_MAX];
+} QueryClient;
+
+// Envía todo el buffer a un cliente; si el cliente no lo lee se le desconecta
+static int send_all(int fd, const char *data, size_t len) {
+    while (len > 0) {
+        ssize_t n = send(fd, data, len, MSG_NOSIGNAL);
+        if (n == -1 && errno == EINTR) continue;
+        if (n <= 0) return -1;
+        data += n;
+        len -= n;
+    }
+    return 0;
+}
 
-    // Si el pozo tiene suficiente, el ganador toma 10, el resto va a Ursula
-    if (loot_pool >= reward_needed) {
-        ships[winner_ship_idx].gold += reward_needed;
-        int surplus = loot_pool - reward_needed;
-        treasury += surplus;
-        fprintf(stdout, "[Ursula] ¡Barco %d ganó! Recibió 10 de oro. Ursula cobró un impuesto de %d de oro.\n",
-                ships[winner_ship_idx].pid, surplus);
+/**
+ * @brief Hilo del servicio de consultas espaciales: atiende el socket UNIX con epoll. Cada petición se
+ * resuelve con engine_query bajo sea_lock, y la respuesta se envía ya fuera del cerrojo.
+ * @param arg No usado.
+ */
+void *query_server(void *arg) {
+    (void)arg;
+    struct epoll_event ev, ready[16];
+    int ep = epoll_create1(EPOLL_CLOEXEC);
+    if (ep == -1) {
+        perror("Error en epoll_create1");
+        return NULL;
     }
-    // Si el pozo es insuficiente, Ursula paga la diferencia
-    else {
-        ships[winner_ship_idx].gold += reward_needed;
-        int subsidy_needed = reward_needed - loot_pool;
-        if (treasury >= subsidy_needed) {
-            treasury -= subsidy_needed;
-            fprintf(stdout, "[Ursula] ¡Barco %d ganó! Recibió 10 de oro (Subsidiado con %d). Tesoro: %d.\n",
-                    ships[winner_ship_idx].pid, subsidy_needed, treasury);
-        } else {
-            // EL FIN DEL MUNDO
-            fprintf(stderr, "[Ursula] ¡BANCARROTA DEL TESORO (%d)! No se puede pagar el subsidio de %d. EL FIN ESTÁ CERCA.\n",
-                    treasury, subsidy_needed);
-
-            // Matar a todos los capitanes
-            for (int k = 0; k < MAX_CAPTAINS; k++) {
-                if (captains[k].active) {
-                    fprintf(stderr, "[Ursula] Señalizando al Capitán %d para que termine.\n", captains[k].pid);
-                    kill(captains[k].pid, SIGINT);
+    ev.events = EPOLLIN;
+    ev.data.ptr = NULL; // El socket de escucha
+    epoll_ctl(ep, EPOLL_CTL_ADD, query_fd, &ev);
+
+    while (1) {
+        int n = epoll_wait(ep, ready, 16, -1);
+        for (int i = 0; i < n; i++) {
+            QueryClient *client = ready[i].data.ptr;
+
+            if (!client) {
+                int fd = accept(query_fd, NULL, NULL);
+                if (fd == -1) continue;
+                client = calloc(1, sizeof(QueryClient));
+                if (!client) {
+                    close(fd);
+                    continue;
                 }
+                client->fd = fd;
+                ev.events = EPOLLIN;
+                ev.data.ptr = client;
+                epoll_ctl(ep, EPOLL_CTL_ADD, fd, &ev);
+                continue;
+            }
+
+            ssize_t got = read(client->fd, client->buf + client->used, sizeof(client->buf) - 1 - client->used);
+            int drop = got <= 0 && !(got == -1 && errno == EINTR);
+            if (got > 0) client->used += got;
+
+            // Responder a cada línea completa; una línea que no cabe en el buffer cierra la conexión
+            char *start = client->buf;
+            char *nl;
+            while (!drop && (nl = memchr(start, '\n', client->used - (start - client->buf))) != NULL) {
+                *nl = '\0';
+                char *reply = NULL;
+                size_t reply_len = 0;
+                FILE *out = open_memstream(&reply, &reply_len);
+                if (!out) {
+                    drop = 1;
+                    break;
+                }
+                pthread_mutex_lock(&sea_lock);
+                engine_query(sea, start, out);
+                pthread_mutex_unlock(&sea_lock);
+                fclose(out);
+
+                if (send_all(client->fd, reply, reply_len) != 0) drop = 1;
+                free(reply);
+                start = nl + 1;
+            }
+            client->used -= start - client->buf;
+            memmove(client->buf, start, client->used);
+            if (client->used == sizeof(client->buf) - 1) drop = 1;
+
+            if (drop) {
+                epoll_ctl(ep, EPOLL_CTL_DEL, client->fd, NULL);
+                close(client->fd);
+                free(client);
             }
-            exit(EXIT_SUCCESS);
         }
     }
+    return NULL;
+}
+
+/**
+ * @brief Crea el socket de consultas junto al FIFO y lanza el hilo que lo atiende.
+ * @return 0 en caso de éxito, -1 si el servicio no está disponible.
+ */
+int start_query_server(const char *fifo) {
+    struct sockaddr_un addr;
+    pthread_t server;
+
+    if (ursula_query_path(fifo, query_path, sizeof(query_path)) != 0) return -1;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    strcpy(addr.sun_path, query_path);
+
+    query_fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (query_fd == -1) return -1;
+    unlink(query_path); // Socket abandonado por una Ursula anterior
+    if (bind(query_fd, (struct sockaddr *)&addr, sizeof(addr)) == -1 || listen(query_fd, QUERY_MAX_CLIENTS) == -1) {
+        close(query_fd);
+        query_fd = -1;
+        return -1;
+    }
+    atexit(cleanup_query);
+
+    if (pthread_create(&server, NULL, query_server, NULL) != 0) {
+        cleanup_query();
+        return -1;
+    }
+    pthread_detach(server);
+    return 0;
+}
+
+/**
+ * @brief Se une a la federación descrita en path: busca su región por la ruta de su FIFO y se adhiere al libro
+ * del tesoro común.
+ * @return 0 en caso de éxito, -1 si el fichero no es válido, el FIFO no figura en él o el libro no se pudo abrir.
+ */
+int join_federation(const char *path, const char *fifo) {
+    char own[PATH_MAX], other[PATH_MAX];
+    UrsulaFederation *federation = malloc(sizeof(UrsulaFederation));
+    if (!federation || ursula_federation_load(path, federation) <= 0 || !realpath(fifo, own)) {
+        free(federation);
+        return -1;
+    }
+
+    region_index = -1;
+    for (int i = 0; i < federation->count && region_index == -1; i++) {
+        if (realpath(federation->regions[i].fifo, other) && strcmp(own, other) == 0) region_index = i;
+    }
+    if (region_index == -1) {
+        fprintf(stderr, "[Ursula] %s no figura en la federación %s\n", fifo, path);
+        free(federation);
+        return -1;
+    }
+
+    UrsulaRegion *r = &federation->regions[region_index];
+    fprintf(stdout, "[Ursula] Región %d de %d: (%d, %d) - (%d, %d)\n", region_index, federation->count,
+            r->x0, r->y0, r->x1, r->y1);
+    free(federation);
+
+    ledger = ledger_join(path, region_index, treasury);
+    if (!ledger) return -1;
+    atexit(cleanup_ledger);
+    engine_set_ledger(sea, ledger, region_index);
+    return 0;
+}
+
+static long long monotonic_ms(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000 + ts.tv_nsec / 1000000;
+}
+
+/**
+ * @brief Cierra el turno si ha vencido y calcula cuánto se puede esperar al siguiente evento.
+ * @param deadline Fin del turno en curso (se avanza al cerrar el turno).
+ * @return Milisegundos hasta el fin del turno, o -1 (sin límite) si no hay turnos.
+ */
+int tick_timeout(long long *deadline) {
+    if (tick_ms <= 0) return -1;
+    long long now = monotonic_ms();
+    if (now >= *deadline) {
+        resolve_tick();
+        *deadline = now + tick_ms;
+    }
+    return (int)(*deadline - now);
+}
+
+/**
+ * @brief Reserva los núcleos de --cpus antes de crear los hilos auxiliares (que heredan la afinidad). Con más de un
+ * núcleo, el primero queda para el hilo de ingesta (ver pin_ingest) y los auxiliares usan los demás.
+ */
+static void pin_ursula(void) {
+    static CpuList helpers;
+    if (ursula_cpus.count == 0) return;
+    helpers = ursula_cpus;
+    if (helpers.count > 1) {
+        helpers.count--;
+        memmove(helpers.cpus, helpers.cpus + 1, sizeof(int) * helpers.count);
+    }
+    if (placement_pin(0, &helpers) == -1) perror("Aviso: no se pudo fijar la afinidad de Ursula");
+}
+
+/** @brief Fija el hilo de ingesta (el llamante) al primer núcleo de --cpus, una vez creados los auxiliares. */
+static void pin_ingest(void) {
+    if (ursula_cpus.count > 1 && placement_pin_one(0, &ursula_cpus, 0) == -1) {
+        perror("Aviso: no se pudo fijar la CPU del hilo de ingesta");
+    }
 }
 
 int main(int argc, char *argv[]) {
-    if (argc < 2) {
-        fprintf(stderr, "Uso: %s <nombre_fifo>\n", argv[0]);
+    int use_ring = 0;
+    char *federation_path = NULL;
+    unsigned int seed = (unsigned int)time(NULL);
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--ring") == 0) use_ring = 1;
+        else if (strcmp(argv[i], "--tick") == 0 && i + 1 < argc) tick_ms = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--seed") == 0 && i + 1 < argc) seed = (unsigned int)strtoul(argv[++i], NULL, 10);
+        else if (strcmp(argv[i], "--federation") == 0 && i + 1 < argc) federation_path = argv[++i];
+        else if (strcmp(argv[i], "--cpus") == 0 && i + 1 < argc) {
+            if (placement_parse_cpus(argv[++i], &ursula_cpus) != 0) {
+                fprintf(stderr, "Lista de CPUs inválida: %s\n", argv[i]);
+                return EXIT_FAILURE;
+            }
+        }
+        else global_fifo_path = argv[i];
+    }
+
+    if (!global_fifo_path) {
+        fprintf(stderr, "Uso: %s [--ring] [--tick <ms>] [--seed <n>] [--federation <fichero>] [--cpus <lista>] <nombre_fifo>\n", argv[0]);
         return EXIT_FAILURE;
     }
 
-    global_fifo_path = argv[1];
+    // Initial random seed (--seed para repetir los combates de una partida en modo --tick)
+    sea = engine_create(treasury, seed);
+    if (!sea) {
+        fprintf(stderr, "Error creando el estado del mar\n");
+        return EXIT_FAILURE;
+    }
+    engine_set_turns(sea, tick_ms > 0);
 
     if (signal(SIGINT, handle_sigint_ursula) == SIG_ERR) {
         perror("Error configurando SIGINT");
@@ -231,122 +742,102 @@ int main(int argc, char *argv[]) {
         }
     }
 
-    fprintf(stdout, "[Ursula] La Dama del Mar (PID: %d) escuchando en %s. Tesoro: %d\n", getpid(), global_fifo_path, treasury);
-
-    // Abrir FIFO
-    FILE *fp = fopen(global_fifo_path, "r+");
-    if (!fp) {
-        perror("Error en fopen fifo");
+    // Región de una federación: el tesoro pasa a ser el libro común de todas las regiones
+    if (federation_path && join_federation(federation_path, global_fifo_path) != 0) {
+        fprintf(stderr, "Error uniéndose a la federación %s\n", federation_path);
         return EXIT_FAILURE;
     }
 
-    // Initial random seed
-    srand(time(NULL));
+    // Publicar el estado del mar; sin él Ursula sigue funcionando, pero nadie puede observarla
+    world = world_create(global_fifo_path);
+    if (world) {
+        atexit(cleanup_world);
+        engine_set_world(sea, world);
+    } else {
+        perror("Aviso: no se pudo crear el estado compartido del mar");
+    }
 
-    // Inicializar arrays
-    for(int i=0; i<MAX_SHIPS; i++) ships[i].active = 0;
-    for(int i=0; i<MAX_CAPTAINS; i++) captains[i].active = 0;
+    // Anillo de eventos: los clientes que lo encuentren lo usarán en vez del FIFO
+    if (use_ring) {
+        char ring_name[NAME_MAX];
+        if (ursula_ring_name(global_fifo_path, ring_name, sizeof(ring_name)) == 0) events = mpsc_create(ring_name);
+        if (events) {
+            atexit(cleanup_events);
+        } else {
+            perror("Aviso: no se pudo crear el anillo de eventos, se usa sólo el FIFO");
+        }
+    }
 
-    char *line = NULL;
-    size_t len = 0;
-    ssize_t read_len;
+    fprintf(stdout, "[Ursula] La Dama del Mar (PID: %d) escuchando en %s%s. Tesoro: %d\n", getpid(), global_fifo_path,
+            events ? " (y en memoria compartida)" : "", engine_treasury(sea));
 
-    while (1) {
-        read_len = getline(&line, &len, fp);
-        if (read_len == -1) {
-            clearerr(fp);
-            continue;
-        }
+    // Abrir FIFO (también para escritura, para no ver EOF cuando se van todos los clientes)
+    int fd = open(global_fifo_path, O_RDWR);
+    if (fd == -1) {
+        perror("Error abriendo el fifo");
+        return EXIT_FAILURE;
+    }
 
-        if (read_len > 0 && line[read_len-1] == '\n') line[read_len-1] = '\0';
-        if (strlen(line) == 0) continue;
+    pin_ursula();
 
-        // Parseo de variables
-        int pid, x, y, food, gold;
-        char type[32];
-        char *endptr; // Usado para strtol
+    // Bajas de los procesos que mueren sin despedirse, detectadas con pidfd
+    if (start_reaper(global_fifo_path) != 0) {
+        perror("Aviso: no se pueden vigilar los procesos registrados");
+    }
 
-        char *token = strtok(line, ",");
-        if (!token) continue;
-        pid = (int)strtol(token, &endptr, 10);
+    // Consultas espaciales de los capitanes, atendidas en su propio hilo
+    if (start_query_server(global_fifo_path) != 0) {
+        perror("Aviso: no se pudo crear el socket de consultas");
+    }
 
-        token = strtok(NULL, ",");
-        if (!token) continue;
-        while (*token == ' ') token++; // Recortar espacio inicial
-        strcpy(type, token);
+    static UrsulaEvent batch[BATCH_MAX];
+    int n;
+    long long deadline = monotonic_ms() + tick_ms;
+    if (tick_ms > 0) fprintf(stdout, "[Ursula] Combate por turnos de %d ms.\n", tick_ms);
 
-        if (strcmp(type, "INIT_CAPT") == 0) {
-            add_captain(pid);
-            fprintf(stdout, "[Ursula] Capitán %d registrado.\n", pid);
-        }
-        else if (strcmp(type, "END_CAPT") == 0) {
-            int idx = find_captain_index(pid);
-            if (idx != -1) {
-                captains[idx].active = 0;
-                fprintf(stdout, "[Ursula] Capitán %d se ha desconectado.\n", pid);
-            }
+    if (events) {
+        pthread_t reader;
+        if (pthread_create(&reader, NULL, fifo_reader, (void *)(intptr_t)fd) != 0) {
+            fprintf(stderr, "Error creando el hilo lector del FIFO\n");
+            return EXIT_FAILURE;
         }
-        else if (strcmp(type, "TERMINATE") == 0) {
-            int idx = find_ship_index(pid);
-            if (idx != -1) {
-                ships[idx].active = 0;
-                fprintf(stdout, "[Ursula] Barco %d terminado.\n", pid);
-            }
+        pin_ingest();
+
+        // Se vacía el anillo sin llamadas al sistema (todo lo pendiente, en un lote); sólo se duerme cuando está vacío
+        MpscRecord rec;
+        while (1) {
+            if (mpsc_pop_wait(events, &rec, tick_timeout(&deadline)) != 0) continue;
+            ursula_unpack(&rec, &batch[0]);
+            n = 1;
+            while (n < BATCH_MAX && mpsc_pop(events, &rec) == 0) ursula_unpack(&rec, &batch[n++]);
+            if (process_batch(batch, n)) break;
+            tick_timeout(&deadline);
         }
-        else if (strcmp(type, "INIT") == 0 || strcmp(type, "MOVE") == 0) {
-            // Retrieve remaining tokens safely
-            char *tok_x = strtok(NULL, ",");
-            char *tok_y = strtok(NULL, ",");
-            char *tok_food = strtok(NULL, ",");
-            char *tok_gold = strtok(NULL, ",");
-
-            if (tok_x && tok_y && tok_food && tok_gold) {
-                x = (int)strtol(tok_x, &endptr, 10);
-                y = (int)strtol(tok_y, &endptr, 10);
-                food = (int)strtol(tok_food, &endptr, 10);
-                gold = (int)strtol(tok_gold, &endptr, 10);
-
-                int idx = find_ship_index(pid);
-
-                if (strcmp(type, "INIT") == 0) {
-                    if (idx == -1) add_ship(pid, x, y, food, gold);
-                    fprintf(stdout, "[Ursula] Barco %d registrado en (%d, %d).\n", pid, x, y);
-                }
-                else { // MOVER
-                    if (idx != -1) {
-                        ships[idx].x = x;
-                        ships[idx].y = y;
-                        ships[idx].food = food;
-                        ships[idx].gold = gold;
-                        fprintf(stdout, "[Ursula] Barco %d se movió a (%d, %d). Comida: %d, Oro: %d.\n", pid, x, y, food, gold);
-
-                        resolve_combat(x, y);
-                    } else {
-                        // Por si acaso algun init no llego...
-                        fprintf(stderr, "[Ursula] ADVERTENCIA: Barco %d no estaba registrado...\n", pid);
-                        add_ship(pid, x, y, food, gold);
-                    }
-                }
-            }
-        }
-
-        // Comprobar Condición de Terminación Global
-        static int ever_had_captains = 0;
-        int active_c = 0;
-        int active_s = 0;
-        for(int i=0; i<MAX_CAPTAINS; i++) if(captains[i].active) active_c++;
-        for(int i=0; i<MAX_SHIPS; i++) if(ships[i].active) active_s++;
 
-        if (active_c > 0) ever_had_captains = 1;
+        // El hilo lector sigue bloqueado en el FIFO: se termina el proceso sin cerrarlo bajo sus pies
+        unlink(global_fifo_path);
+        return EXIT_SUCCESS;
+    }
 
-        if (ever_had_captains && active_c == 0 && active_s == 0) {
-            fprintf(stdout, "[Ursula] Todas las flotas han partido. El mar está en silencio.\n");
-            break;
+    // Sin anillo: se lee del FIFO todo lo que haya pendiente (sin bloquear) y se procesa como un lote
+    static UrsulaLineBuffer lines;
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL) | O_NONBLOCK);
+    pin_ingest();
+    while (1) {
+        n = ursula_lines_take(&lines, batch, BATCH_MAX);
+        while (n < BATCH_MAX && ursula_lines_fill(&lines, fd) > 0) {
+            n += ursula_lines_take(&lines, batch + n, BATCH_MAX - n);
+        }
+        if (n == 0) {
+            struct pollfd pfd = {fd, POLLIN, 0};
+            poll(&pfd, 1, tick_timeout(&deadline));
+            continue;
         }
+        if (process_batch(batch, n)) break;
+        tick_timeout(&deadline);
     }
 
-    if (line) free(line);
-    fclose(fp);
+    close(fd);
     unlink(global_fifo_path);
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,106 @@
+/**
+ * @file ursula.h
+ * @brief Protocolo de eventos entre Ursula y sus clientes (barcos y capitanes) y su transporte.
+ *
+ * Los eventos viajan como líneas de texto por el FIFO de Ursula ("<pid>,MOVE,<x>,<y>,<comida>,<oro>") o, si
+ * Ursula se lanzó con --ring, como registros binarios en un anillo MPSC en memoria compartida. ursula_connect
+ * elige el anillo cuando Ursula lo publica y recurre al FIFO en caso contrario.
+ *
+ * INIT y ARRIVE llevan opcionalmente un séptimo campo con el PID del capitán dueño del barco.
+ *
+ * Además Ursula atiende consultas espaciales (RADIUS, RECT, KNN) y de agregados (TOP, STATS, CAPTAIN) en un socket
+ * UNIX junto al FIFO ("<fifo>.sock").
+ *
+ * Federación: si en lugar de un FIFO se pasa un fichero de federación (una línea "<fifo> <x0> <y0> <x1> <y1>" por
+ * región), el mar se reparte entre varias Ursulas. Cada evento de un barco va a la dueña de su celda; al cruzar una
+ * frontera el barco se despide de la región antigua (LEAVE) y se presenta en la nueva (ARRIVE). Los eventos de los
+ * capitanes van a todas las regiones.
+ *
+ * Resultados de combate: Ursula los envía a cada barco con sigqueue(URSULA_COMBAT_SIGNAL), una señal de tiempo real
+ * que no se agrupa como SIGUSR1/SIGUSR2. Cada señal lleva en su valor las variaciones exactas de comida y oro
+ * (ursula_combat_pack), sumadas si el barco combatió varias veces en el mismo turno.
+ */
+
+#ifndef URSULA_H
+#define URSULA_H
+
+#include <stdio.h>
+#include <limits.h>
+#include <signal.h>
+#include "ring.h"
+
+#define URSULA_MAX_REGIONS 16
+#define URSULA_COMBAT_SIGNAL (SIGRTMIN + 1)
+
+// Tipos de evento
+enum {
+    URSULA_INIT = 1,
+    URSULA_MOVE,
+    URSULA_TERMINATE,
+    URSULA_INIT_CAPT,
+    URSULA_END_CAPT,
+    URSULA_LEAVE,       // El barco pasa a otra región
+    URSULA_ARRIVE,      // El barco llega desde otra región (lleva posición y recursos, como MOVE)
+    URSULA_LOST         // El barco murió sin despedirse (lo envía el reaper de Ursula): su oro se pierde
+};
+
+typedef struct {
+    int type;
+    int pid;
+    int x;
+    int y;
+    int food;
+    int gold;
+    int owner;          // Capitán del barco (INIT y ARRIVE; 0 si no tiene), para los agregados por capitán
+} UrsulaEvent;
+
+// Buffer de lectura del protocolo de texto: acumula bytes del FIFO y entrega líneas completas como eventos
+#define URSULA_LINE_BUFFER 65536
+
+typedef struct {
+    size_t used;
+    char buf[URSULA_LINE_BUFFER];
+} UrsulaLineBuffer;
+
+typedef struct UrsulaFederation UrsulaFederation;
+
+// Conexión de un cliente con Ursula: exactamente uno de los dos transportes, una federación, o nada
+typedef struct {
+    FILE *pipe;
+    MpscRing *ring;
+    UrsulaFederation *federation;
+    int region;                 // Región dueña del barco en una federación (-1 hasta su INIT)
+} UrsulaLink;
+
+typedef struct {
+    char fifo[PATH_MAX];
+    int x0, y0, x1, y1;         // Celdas de la región, bordes incluidos
+    int connected;
+    UrsulaLink link;            // Conexión directa con la Ursula de la región (se abre al primer evento)
+} UrsulaRegion;
+
+struct UrsulaFederation {
+    int count;
+    UrsulaRegion regions[URSULA_MAX_REGIONS];
+};
+
+int ursula_ring_name(const char *fifo, char *name, int len);
+int ursula_parse_line(char *line, UrsulaEvent *ev);
+void ursula_pack(const UrsulaEvent *ev, MpscRecord *rec);
+void ursula_unpack(const MpscRecord *rec, UrsulaEvent *ev);
+long ursula_lines_fill(UrsulaLineBuffer *lines, int fd);
+int ursula_lines_take(UrsulaLineBuffer *lines, UrsulaEvent *out, int max);
+int ursula_combat_pack(int food, int gold);
+void ursula_combat_unpack(int value, int *food, int *gold);
+
+int ursula_connect(UrsulaLink *link, const char *fifo);
+int ursula_send(UrsulaLink *link, const UrsulaEvent *ev);
+void ursula_disconnect(UrsulaLink *link);
+
+int ursula_federation_load(const char *path, UrsulaFederation *federation);
+int ursula_region_of(const UrsulaFederation *federation, int x, int y);
+
+int ursula_query_path(const char *fifo, char *path, int len);
+int ursula_query_open(const char *fifo);
+
+#endif
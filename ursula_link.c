@@ -0,0 +1,344 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <stdint.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <sys/socket.h>
+#include <sys/un.h>
+#include "ursula.h"
+#include "world.h"
+
+/**
+ * @brief Nombre del segmento del anillo de eventos de la Ursula que escucha en fifo.
+ * @return 0 en caso de éxito, -1 si el nombre no cabe en len.
+ */
+int ursula_ring_name(const char *fifo, char *name, int len) {
+    if (world_shm_name(fifo, name, len) != 0) return -1;
+    size_t n = strlen(name);
+    if (n + sizeof(".ring") > (size_t)len) return -1;
+    strcpy(name + n, ".ring");
+    return 0;
+}
+
+/**
+ * @brief Interpreta una línea del protocolo de texto (sin salto de línea). Modifica line.
+ * @return 0 si la línea es un evento válido, -1 en caso contrario.
+ */
+int ursula_parse_line(char *line, UrsulaEvent *ev) {
+    char *endptr; // Usado para strtol
+
+    char *token = strtok(line, ",");
+    if (!token) return -1;
+    memset(ev, 0, sizeof(*ev));
+    ev->pid = (int)strtol(token, &endptr, 10);
+
+    token = strtok(NULL, ",");
+    if (!token) return -1;
+    while (*token == ' ') token++; // Recortar espacio inicial
+
+    if (strcmp(token, "INIT_CAPT") == 0) ev->type = URSULA_INIT_CAPT;
+    else if (strcmp(token, "END_CAPT") == 0) ev->type = URSULA_END_CAPT;
+    else if (strcmp(token, "TERMINATE") == 0) ev->type = URSULA_TERMINATE;
+    else if (strcmp(token, "LEAVE") == 0) ev->type = URSULA_LEAVE;
+    else if (strcmp(token, "LOST") == 0) ev->type = URSULA_LOST;
+    else if (strcmp(token, "INIT") == 0 || strcmp(token, "MOVE") == 0 || strcmp(token, "ARRIVE") == 0) {
+        if (strcmp(token, "INIT") == 0) ev->type = URSULA_INIT;
+        else if (strcmp(token, "MOVE") == 0) ev->type = URSULA_MOVE;
+        else ev->type = URSULA_ARRIVE;
+
+        char *tok_x = strtok(NULL, ",");
+        char *tok_y = strtok(NULL, ",");
+        char *tok_food = strtok(NULL, ",");
+        char *tok_gold = strtok(NULL, ",");
+        if (!tok_x || !tok_y || !tok_food || !tok_gold) return -1;
+
+        ev->x = (int)strtol(tok_x, &endptr, 10);
+        ev->y = (int)strtol(tok_y, &endptr, 10);
+        ev->food = (int)strtol(tok_food, &endptr, 10);
+        ev->gold = (int)strtol(tok_gold, &endptr, 10);
+
+        // Campo opcional: capitán dueño (los clientes antiguos no lo envían)
+        char *tok_owner = strtok(NULL, ",");
+        if (tok_owner && ev->type != URSULA_MOVE) ev->owner = (int)strtol(tok_owner, &endptr, 10);
+    }
+    else return -1;
+    return 0;
+}
+
+void ursula_pack(const UrsulaEvent *ev, MpscRecord *rec) {
+    memset(rec, 0, sizeof(*rec));
+    rec->op = ev->type;
+    rec->pid = ev->pid;
+    rec->arg[0] = ev->x;
+    rec->arg[1] = ev->y;
+    rec->arg[2] = ev->food;
+    rec->arg[3] = ev->gold;
+    rec->arg[4] = ev->owner;
+}
+
+void ursula_unpack(const MpscRecord *rec, UrsulaEvent *ev) {
+    ev->type = rec->op;
+    ev->pid = rec->pid;
+    ev->x = rec->arg[0];
+    ev->y = rec->arg[1];
+    ev->food = rec->arg[2];
+    ev->gold = rec->arg[3];
+    ev->owner = rec->arg[4];
+}
+
+/**
+ * @brief Lee del descriptor lo que quepa en el buffer (una sola llamada a read).
+ * @return Bytes leídos, 0 si no había nada que leer (o el buffer está lleno), -1 en caso de error.
+ */
+long ursula_lines_fill(UrsulaLineBuffer *lines, int fd) {
+    if (lines->used >= sizeof(lines->buf) - 1) return 0;
+    ssize_t n = read(fd, lines->buf + lines->used, sizeof(lines->buf) - 1 - lines->used);
+    if (n == -1) return (errno == EAGAIN || errno == EINTR) ? 0 : -1;
+    lines->used += n;
+    return n;
+}
+
+/**
+ * @brief Extrae del buffer hasta max eventos de líneas completas; las líneas no válidas se descartan y el
+ * resto (una línea a medias o eventos que no cupieron) se conserva para la siguiente llamada.
+ * @return Número de eventos escritos en out.
+ */
+int ursula_lines_take(UrsulaLineBuffer *lines, UrsulaEvent *out, int max) {
+    char *start = lines->buf;
+    char *nl;
+    int n = 0;
+
+    while (n < max && (nl = memchr(start, '\n', lines->used - (start - lines->buf))) != NULL) {
+        *nl = '\0';
+        if (ursula_parse_line(start, &out[n]) == 0) n++;
+        start = nl + 1;
+    }
+    lines->used -= start - lines->buf;
+    memmove(lines->buf, start, lines->used);
+    if (n == 0 && lines->used == sizeof(lines->buf) - 1) lines->used = 0; // Línea absurdamente larga: se descarta
+    return n;
+}
+
+/**
+ * @brief Carga un fichero de federación: una región por línea, "<fifo> <x0> <y0> <x1> <y1>".
+ * Las líneas vacías y las que empiezan por '#' se ignoran.
+ * @return Número de regiones cargadas, o -1 si el fichero no existe o alguna línea no es válida.
+ */
+int ursula_federation_load(const char *path, UrsulaFederation *federation) {
+    FILE *file = fopen(path, "r");
+    if (!file) return -1;
+
+    char *line = NULL;
+    size_t len = 0;
+    int ok = 1;
+    federation->count = 0;
+
+    while (getline(&line, &len, file) != -1) {
+        char *p = line;
+        while (*p == ' ' || *p == '\t') p++;
+        if (*p == '\n' || *p == '\0' || *p == '#') continue;
+
+        UrsulaRegion *r = &federation->regions[federation->count];
+        char fmt[32];
+        snprintf(fmt, sizeof(fmt), "%%%ds %%d %%d %%d %%d", PATH_MAX - 1);
+        if (federation->count == URSULA_MAX_REGIONS || sscanf(p, fmt, r->fifo, &r->x0, &r->y0, &r->x1, &r->y1) != 5 ||
+            r->x0 > r->x1 || r->y0 > r->y1) {
+            ok = 0;
+            break;
+        }
+        r->connected = 0;
+        memset(&r->link, 0, sizeof(r->link));
+        federation->count++;
+    }
+    free(line);
+    fclose(file);
+    return ok ? federation->count : -1;
+}
+
+/** @brief Región dueña de la celda (x, y): la primera que la contiene, o -1 si ninguna. */
+int ursula_region_of(const UrsulaFederation *federation, int x, int y) {
+    for (int i = 0; i < federation->count; i++) {
+        const UrsulaRegion *r = &federation->regions[i];
+        if (x >= r->x0 && x <= r->x1 && y >= r->y0 && y <= r->y1) return i;
+    }
+    return -1;
+}
+
+// Variación de un recurso en 16 bits con signo, saturada
+static int combat_clamp(int delta) {
+    return delta < -32768 ? -32768 : (delta > 32767 ? 32767 : delta);
+}
+
+/** @brief Codifica las variaciones de comida y oro de un resultado de combate en el valor de una señal. */
+int ursula_combat_pack(int food, int gold) {
+    return (int)(((uint32_t)(uint16_t)combat_clamp(food) << 16) | (uint16_t)combat_clamp(gold));
+}
+
+void ursula_combat_unpack(int value, int *food, int *gold) {
+    *food = (int16_t)((uint32_t)value >> 16);
+    *gold = (int16_t)((uint32_t)value & 0xffff);
+}
+
+/**
+ * @brief Conecta con la Ursula que escucha en fifo, por su anillo en memoria compartida si lo publica
+ * y si no por el FIFO (lo que bloquea hasta que Ursula lo abra, como antes).
+ * Si fifo es un fichero regular se interpreta como un fichero de federación: las conexiones con cada
+ * región se abren al enviarles el primer evento.
+ * @return 0 en caso de éxito, -1 si no hay ningún transporte disponible (link queda desconectado).
+ */
+int ursula_connect(UrsulaLink *link, const char *fifo) {
+    char name[NAME_MAX];
+    struct stat st;
+    link->pipe = NULL;
+    link->ring = NULL;
+    link->federation = NULL;
+    link->region = -1;
+
+    if (stat(fifo, &st) == 0 && S_ISREG(st.st_mode)) {
+        link->federation = malloc(sizeof(UrsulaFederation));
+        if (link->federation && ursula_federation_load(fifo, link->federation) > 0) return 0;
+        free(link->federation);
+        link->federation = NULL;
+        return -1;
+    }
+
+    if (ursula_ring_name(fifo, name, sizeof(name)) == 0) link->ring = mpsc_attach(name);
+    if (link->ring) return 0;
+
+    link->pipe = fopen(fifo, "w");
+    return link->pipe ? 0 : -1;
+}
+
+static int send_region(UrsulaFederation *federation, int region, const UrsulaEvent *ev) {
+    UrsulaRegion *r = &federation->regions[region];
+    if (!r->connected) {
+        if (ursula_connect(&r->link, r->fifo) != 0) return -1;
+        r->connected = 1;
+    }
+    return ursula_send(&r->link, ev);
+}
+
+/**
+ * @brief Encamina un evento dentro de una federación. Los de capitán van a todas las regiones; los de un barco,
+ * a la dueña de su celda (las celdas fuera de toda región pertenecen a la primera). Un MOVE que cruza una frontera
+ * se convierte en LEAVE para la región antigua seguido de ARRIVE para la nueva, de modo que el barco nunca está
+ * registrado en dos regiones a la vez.
+ */
+static int send_federated(UrsulaLink *link, const UrsulaEvent *ev) {
+    UrsulaFederation *federation = link->federation;
+    int result = 0;
+
+    if (ev->type == URSULA_INIT_CAPT || ev->type == URSULA_END_CAPT) {
+        for (int i = 0; i < federation->count; i++) {
+            if (send_region(federation, i, ev) != 0) result = -1;
+        }
+        return result;
+    }
+    if (ev->type == URSULA_TERMINATE || ev->type == URSULA_LOST) {
+        return link->region >= 0 ? send_region(federation, link->region, ev) : -1;
+    }
+
+    int owner = ursula_region_of(federation, ev->x, ev->y);
+    if (owner < 0) owner = 0;
+
+    if (ev->type == URSULA_MOVE && link->region >= 0 && owner != link->region) {
+        UrsulaEvent leave = {URSULA_LEAVE, ev->pid, ev->x, ev->y, ev->food, ev->gold, ev->owner};
+        UrsulaEvent arrive = leave;
+        arrive.type = URSULA_ARRIVE;
+        result = send_region(federation, link->region, &leave);
+        link->region = owner;
+        return send_region(federation, owner, &arrive) == 0 ? result : -1;
+    }
+    link->region = owner;
+    return send_region(federation, owner, ev);
+}
+
+/**
+ * @brief Envía un evento a Ursula. Por el anillo no hace llamadas al sistema salvo que Ursula esté dormida.
+ * @return 0 en caso de éxito, -1 si no hay conexión o Ursula ya no lo recibe.
+ */
+int ursula_send(UrsulaLink *link, const UrsulaEvent *ev) {
+    if (link->federation) return send_federated(link, ev);
+    if (link->ring) {
+        MpscRecord rec;
+        ursula_pack(ev, &rec);
+        return mpsc_push_wait(link->ring, &rec);
+    }
+    if (!link->pipe) return -1;
+
+    switch (ev->type) {
+        case URSULA_INIT:
+            fprintf(link->pipe, "%d,INIT,%d,%d,%d,%d,%d\n", ev->pid, ev->x, ev->y, ev->food, ev->gold, ev->owner);
+            break;
+        case URSULA_MOVE:
+            fprintf(link->pipe, "%d,MOVE,%d,%d,%d,%d\n", ev->pid, ev->x, ev->y, ev->food, ev->gold);
+            break;
+        case URSULA_TERMINATE:
+            fprintf(link->pipe, "%d,TERMINATE\n", ev->pid);
+            break;
+        case URSULA_INIT_CAPT:
+            fprintf(link->pipe, "%d,INIT_CAPT\n", ev->pid);
+            break;
+        case URSULA_END_CAPT:
+            fprintf(link->pipe, "%d,END_CAPT\n", ev->pid);
+            break;
+        case URSULA_LEAVE:
+            fprintf(link->pipe, "%d,LEAVE\n", ev->pid);
+            break;
+        case URSULA_LOST:
+            fprintf(link->pipe, "%d,LOST\n", ev->pid);
+            break;
+        case URSULA_ARRIVE:
+            fprintf(link->pipe, "%d,ARRIVE,%d,%d,%d,%d,%d\n", ev->pid, ev->x, ev->y, ev->food, ev->gold, ev->owner);
+            break;
+        default:
+            return -1;
+    }
+    // fflush: cada evento debe llegar entero y enseguida a Ursula
+    return fflush(link->pipe) == 0 ? 0 : -1;
+}
+
+void ursula_disconnect(UrsulaLink *link) {
+    if (link->federation) {
+        for (int i = 0; i < link->federation->count; i++) {
+            if (link->federation->regions[i].connected) ursula_disconnect(&link->federation->regions[i].link);
+        }
+        free(link->federation);
+        link->federation = NULL;
+    }
+    if (link->pipe) fclose(link->pipe);
+    mpsc_detach(link->ring);
+    link->pipe = NULL;
+    link->ring = NULL;
+}
+
+/**
+ * @brief Ruta del socket de consultas espaciales de la Ursula que escucha en fifo.
+ * @return 0 en caso de éxito, -1 si la ruta no cabe en len.
+ */
+int ursula_query_path(const char *fifo, char *path, int len) {
+    int n = snprintf(path, len, "%s.sock", fifo);
+    return n < 0 || n >= len ? -1 : 0;
+}
+
+/**
+ * @brief Abre una conexión con el servicio de consultas espaciales de Ursula. El descriptor no se hereda en exec.
+ * @return Descriptor del socket conectado, o -1 en caso de error.
+ */
+int ursula_query_open(const char *fifo) {
+    struct sockaddr_un addr;
+    memset(&addr, 0, sizeof(addr));
+    addr.sun_family = AF_UNIX;
+    if (ursula_query_path(fifo, addr.sun_path, sizeof(addr.sun_path)) != 0) return -1;
+
+    int fd = socket(AF_UNIX, SOCK_STREAM | SOCK_CLOEXEC, 0);
+    if (fd == -1) return -1;
+    if (connect(fd, (struct sockaddr *)&addr, sizeof(addr)) == -1) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
@@ -0,0 +1,297 @@
+/**
+ * @file viewer.c
+ * @brief Visor en vivo del mar: dibuja en el terminal el mapa y los barcos que publica Ursula.
+ *
+ * Lee el estado compartido de Ursula (world.h) con instantáneas del seqlock, en solo lectura: no envía mensajes
+ * ni bloquea al escritor, así que mirar una partida no le cuesta nada a la simulación. Cada fotograma se compara
+ * con el que ya está en pantalla y sólo se reescriben las celdas que cambiaron, con secuencias de posicionamiento
+ * del cursor. La frecuencia de refresco está limitada (--fps) y si Ursula no escribió nada desde el último
+ * fotograma ni siquiera se copia la instantánea.
+ */
+
+#define _GNU_SOURCE
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <signal.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/stat.h>
+#include "map.h"
+#include "world.h"
+#include "ursula.h"
+
+#define VIEWER_DEFAULT_FPS 10
+#define VIEWER_MAX_FPS 60
+#define VIEWER_STATUS_LEN 256
+
+// Un Ursula por región (o una sola si no hay federación)
+typedef struct {
+    char fifo[PATH_MAX];
+    const WorldState *shared;   // Proyección en solo lectura, NULL hasta que Ursula la publique
+    WorldState *snapshot;       // Última copia consistente
+    uint32_t seq;               // seq de esa copia (0: ninguna todavía)
+    int gone;                   // Ursula ha terminado
+} ViewerSource;
+
+static volatile sig_atomic_t stop = 0;
+static volatile sig_atomic_t resized = 1;
+
+static void on_stop(int sig) {
+    (void)sig;
+    stop = 1;
+}
+
+static void on_resize(int sig) {
+    (void)sig;
+    resized = 1;
+}
+
+static void usage(const char *prog) {
+    fprintf(stderr, "Uso: %s --map <mapa> [--fps <n>] [--origin <x> <y>] <fifo | federación>\n", prog);
+}
+
+/**
+ * @brief Abre las fuentes: el FIFO de una Ursula o, si es un fichero regular, cada región de la federación.
+ * @return Número de fuentes, o -1 en caso de error.
+ */
+static int sources_open(const char *target, ViewerSource **out) {
+    struct stat st;
+    UrsulaFederation *federation = NULL;
+    if (stat(target, &st) == 0 && S_ISREG(st.st_mode)) {
+        federation = malloc(sizeof(UrsulaFederation));
+        if (!federation || ursula_federation_load(target, federation) <= 0) {
+            free(federation);
+            return -1;
+        }
+    }
+    int count = federation ? federation->count : 1;
+    ViewerSource *sources = calloc(count, sizeof(ViewerSource));
+    if (!sources) {
+        free(federation);
+        return -1;
+    }
+    for (int i = 0; i < count; i++) {
+        const char *fifo = federation ? federation->regions[i].fifo : target;
+        snprintf(sources[i].fifo, sizeof(sources[i].fifo), "%s", fifo);
+        sources[i].snapshot = malloc(sizeof(WorldState));
+        if (!sources[i].snapshot) {
+            for (int j = 0; j <= i; j++) free(sources[j].snapshot);
+            free(sources);
+            free(federation);
+            return -1;
+        }
+    }
+    free(federation);
+    *out = sources;
+    return count;
+}
+
+/**
+ * @brief Actualiza la instantánea de una fuente si Ursula escribió desde la última.
+ * @return 1 si hay algo nuevo que mostrar (una instantánea distinta, o que Ursula terminó), 0 si no.
+ */
+static int source_refresh(ViewerSource *source) {
+    if (source->gone) return 0;
+    if (!source->shared) {
+        source->shared = world_attach(source->fifo);
+        if (!source->shared) return 0;
+    }
+    uint32_t seq = __atomic_load_n(&source->shared->seq, __ATOMIC_ACQUIRE);
+    if (seq == source->seq || (seq & 1)) {
+        // Sin escrituras: puede que Ursula haya terminado (la proyección sigue siendo válida)
+        if (source->seq && kill(source->snapshot->ursula_pid, 0) == -1 && errno == ESRCH) source->gone = 1;
+        return source->gone;
+    }
+    if (world_snapshot(source->shared, source->snapshot) != 0) return 0;
+    source->seq = source->snapshot->seq;
+    return 1;
+}
+
+static int64_t now_ns(void) {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (int64_t)ts.tv_sec * 1000000000 + ts.tv_nsec;
+}
+
+int main(int argc, char *argv[]) {
+    const char *map_path = NULL;
+    const char *target = NULL;
+    int fps = VIEWER_DEFAULT_FPS;
+    int ox = 0, oy = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (strcmp(argv[i], "--map") == 0 && i + 1 < argc) map_path = argv[++i];
+        else if (strcmp(argv[i], "--fps") == 0 && i + 1 < argc) fps = atoi(argv[++i]);
+        else if (strcmp(argv[i], "--origin") == 0 && i + 2 < argc) {
+            ox = atoi(argv[++i]);
+            oy = atoi(argv[++i]);
+        }
+        else if (!target) target = argv[i];
+        else {
+            usage(argv[0]);
+            return EXIT_FAILURE;
+        }
+    }
+    if (!map_path || !target || fps < 1) {
+        usage(argv[0]);
+        return EXIT_FAILURE;
+    }
+    if (fps > VIEWER_MAX_FPS) fps = VIEWER_MAX_FPS;
+
+    Map *map = map_load(map_path);
+    if (!map) {
+        fprintf(stderr, "[Visor] No se pudo cargar el mapa %s.\n", map_path);
+        return EXIT_FAILURE;
+    }
+    if (ox < 0 || oy < 0 || ox >= map->width || oy >= map->height) {
+        fprintf(stderr, "[Visor] El origen (%d, %d) está fuera del mapa.\n", ox, oy);
+        map_destroy(map);
+        return EXIT_FAILURE;
+    }
+
+    ViewerSource *sources;
+    int nsources = sources_open(target, &sources);
+    if (nsources < 0) {
+        fprintf(stderr, "[Visor] No se pudo abrir %s.\n", target);
+        map_destroy(map);
+        return EXIT_FAILURE;
+    }
+
+    struct sigaction sa;
+    memset(&sa, 0, sizeof(sa));
+    sa.sa_handler = on_stop;
+    sigaction(SIGINT, &sa, NULL);
+    sigaction(SIGTERM, &sa, NULL);
+    sa.sa_handler = on_resize;
+    sigaction(SIGWINCH, &sa, NULL);
+
+    // Salida con búfer completo: cada fotograma sale en una sola escritura (salvo los muy grandes)
+    static char outbuf[1 << 16];
+    setvbuf(stdout, outbuf, _IOFBF, sizeof(outbuf));
+    fputs("\033[?1049h\033[?25l", stdout);
+
+    // Ventana visible: terreno fijo, fotograma en pantalla (screen) y fotograma nuevo (frame)
+    int vw = 0, vh = 0, cols = 80;
+    char *terrain = NULL, *screen = NULL, *frame = NULL;
+    unsigned char *count = NULL;
+    char status[VIEWER_STATUS_LEN] = "", shown_status[VIEWER_STATUS_LEN] = "";
+    long redrawn = 0;
+    int64_t period = 1000000000 / fps;
+    int64_t deadline = now_ns();
+    int exit_code = EXIT_SUCCESS;
+
+    while (!stop) {
+        int changed = 0, alive = 0;
+        for (int i = 0; i < nsources; i++) {
+            changed |= source_refresh(&sources[i]);
+            alive += sources[i].seq != 0 && !sources[i].gone;
+        }
+
+        if (resized) {
+            struct winsize ws;
+            int rows = 24;
+            cols = 80;
+            if (ioctl(STDOUT_FILENO, TIOCGWINSZ, &ws) == 0 && ws.ws_col > 0 && ws.ws_row > 1) {
+                cols = ws.ws_col;
+                rows = ws.ws_row;
+            }
+            resized = 0;
+            vw = map->width - ox < cols ? map->width - ox : cols;
+            vh = map->height - oy < rows - 1 ? map->height - oy : rows - 1;
+
+            free(terrain);
+            free(screen);
+            free(frame);
+            free(count);
+            terrain = malloc((size_t)vw * vh);
+            screen = calloc((size_t)vw * vh, 1);   // Todo a 0: el primer fotograma lo dibuja entero
+            frame = malloc((size_t)vw * vh);
+            count = malloc((size_t)vw * vh);
+            if (!terrain || !screen || !frame || !count) {
+                exit_code = EXIT_FAILURE;
+                break;
+            }
+            for (int y = 0; y < vh; y++) {
+                for (int x = 0; x < vw; x++) terrain[y * vw + x] = map_get_terrain(map, ox + x, oy + y);
+            }
+            shown_status[0] = '\0';
+            fputs("\033[2J", stdout);
+            changed = 1;
+        }
+
+        if (changed) {
+            int ships = 0, captains = 0, treasury = 0, food = 0, gold = 0;
+            memcpy(frame, terrain, (size_t)vw * vh);
+            memset(count, 0, (size_t)vw * vh);
+            for (int i = 0; i < nsources; i++) {
+                const WorldState *w = sources[i].snapshot;
+                if (!sources[i].seq) continue;
+                ships += w->ship_count;
+                food += w->food_at_sea;
+                gold += w->gold_at_sea;
+                if (w->captain_count > captains) captains = w->captain_count;   // Cada capitán está en todas las regiones
+                treasury = w->treasury;                                         // El tesoro es común a la federación
+                for (int s = 0; s < WORLD_MAX_SHIPS; s++) {
+                    int x = w->ships[s].x - ox, y = w->ships[s].y - oy;
+                    if (!w->ships[s].active || x < 0 || y < 0 || x >= vw || y >= vh) continue;
+                    int c = ++count[y * vw + x];
+                    frame[y * vw + x] = c == 1 ? SHIP : c < 10 ? '0' + c : '+';
+                    if (c == 255) count[y * vw + x] = 254;
+                }
+            }
+
+            // Sólo las celdas distintas de lo que hay en pantalla; el cursor se recoloca al saltar celdas
+            long dirty = 0;
+            int cx = -1, cy = -1;
+            for (int y = 0; y < vh; y++) {
+                for (int x = 0; x < vw; x++) {
+                    int i = y * vw + x;
+                    if (frame[i] == screen[i]) continue;
+                    if (y != cy || x != cx) printf("\033[%d;%dH", y + 1, x + 1);
+                    putchar(frame[i]);
+                    screen[i] = frame[i];
+                    cx = x + 1;
+                    cy = y;
+                    dirty++;
+                }
+            }
+            redrawn += dirty;
+
+            snprintf(status, sizeof(status), "%sBarcos: %d  Capitanes: %d  Tesoro: %d  Comida: %d  Oro: %d  Celdas: %ld",
+                     alive ? "" : sources[0].seq ? "[Ursula ha terminado] " : "[Esperando a Ursula] ",
+                     ships, captains, treasury, food, gold, redrawn);
+        }
+
+        if (strcmp(status, shown_status) != 0) {
+            printf("\033[%d;1H\033[K%.*s", vh + 1, cols, status);
+            memcpy(shown_status, status, sizeof(status));
+        }
+        fflush(stdout);
+
+        // Ritmo fijo: el siguiente fotograma no antes de deadline, aunque éste haya tardado poco
+        deadline += period;
+        int64_t now = now_ns();
+        if (deadline < now) deadline = now;
+        struct timespec ts = {deadline / 1000000000, deadline % 1000000000};
+        while (!stop && !resized && clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL) == EINTR) {
+        }
+    }
+
+    printf("\033[?25h\033[?1049l");
+    fflush(stdout);
+
+    for (int i = 0; i < nsources; i++) {
+        world_detach(sources[i].shared);
+        free(sources[i].snapshot);
+    }
+    free(sources);
+    free(terrain);
+    free(screen);
+    free(frame);
+    free(count);
+    map_destroy(map);
+    return exit_code;
+}
@@ -0,0 +1,103 @@
+#define _GNU_SOURCE
+#include <errno.h>
+#include <limits.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+#include <linux/futex.h>
+#include "wheel.h"
+
+#define WHEEL_MASK (WHEEL_SLOTS - 1)
+
+// Futex compartido entre procesos (sin FUTEX_PRIVATE_FLAG): la rueda vive en un memfd
+static int futex_wait(uint32_t *addr, uint32_t val, const struct timespec *timeout) {
+    return (int)syscall(SYS_futex, addr, FUTEX_WAIT, val, timeout, NULL, 0);
+}
+
+static void futex_wake(uint32_t *addr) {
+    syscall(SYS_futex, addr, FUTEX_WAKE, INT_MAX, NULL, NULL, 0);
+}
+
+// Comparación de tics que tolera el desbordamiento del contador
+static int tick_reached(uint32_t tick, uint32_t due) {
+    return (int32_t)(tick - due) >= 0;
+}
+
+/**
+ * @brief Crea el reloj en un memfd, que los barcos heredan a través de exec.
+ * @param fd Devuelve el descriptor del memfd; el capitán lo cierra cuando ha lanzado a todos los barcos.
+ * @return La rueda proyectada (en el tic 0), o NULL en caso de error.
+ */
+TickWheel* wheel_create(int *fd) {
+    *fd = memfd_create("fleet-clock", 0);
+    if (*fd == -1) return NULL;
+    if (ftruncate(*fd, sizeof(TickWheel)) == -1) {
+        close(*fd);
+        return NULL;
+    }
+    TickWheel *wheel = wheel_attach(*fd);
+    if (!wheel) close(*fd);
+    return wheel;
+}
+
+/** @brief Proyecta un reloj creado por wheel_create (en el barco, a partir del descriptor heredado). */
+TickWheel* wheel_attach(int fd) {
+    TickWheel *wheel = mmap(NULL, sizeof(TickWheel), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    return wheel == MAP_FAILED ? NULL : wheel;
+}
+
+void wheel_destroy(TickWheel *wheel) {
+    if (wheel) munmap(wheel, sizeof(TickWheel));
+}
+
+/**
+ * @brief Avanza el reloj un tic y despierta de una vez a los barcos de la ranura del tic nuevo.
+ * Si nadie duerme en la ranura no hay llamada al sistema.
+ */
+void wheel_advance(TickWheel *wheel) {
+    uint32_t tick = __atomic_add_fetch(&wheel->tick, 1, __ATOMIC_SEQ_CST);
+    WheelSlot *slot = &wheel->slots[tick & WHEEL_MASK];
+    __atomic_add_fetch(&slot->gen, 1, __ATOMIC_SEQ_CST);
+    if (__atomic_load_n(&slot->waiters, __ATOMIC_SEQ_CST)) futex_wake(&slot->gen);
+}
+
+/**
+ * @brief Calcula el siguiente tic en que debe moverse un barco de periodo period.
+ * Los turnos caen en los múltiplos del periodo, así que todos los barcos con el mismo periodo (y los de periodos
+ * divisores) coinciden. Un barco que se ha retrasado (p.ej. detenido con pause) salta los turnos perdidos.
+ * @param due Último turno del barco, o 0 para el primero.
+ */
+uint32_t wheel_next_due(const TickWheel *wheel, uint32_t due, int period) {
+    uint32_t tick = __atomic_load_n(&wheel->tick, __ATOMIC_ACQUIRE);
+    uint32_t p = period > 0 ? (uint32_t)period : 1;
+    if (due == 0 || tick_reached(tick, due + p)) return (tick / p + 1) * p;
+    return due + p;
+}
+
+/**
+ * @brief Duerme hasta que el reloj llegue al tic due, como mucho timeout_ms (-1 = sin límite).
+ * El barco cuenta como durmiente de la ranura antes de dormir, y el futex compara la generación leída antes de
+ * comprobar el tic, así que un avance simultáneo nunca se pierde.
+ * @return 0 si el reloj ha llegado a due, -1 si se agotó el plazo.
+ */
+int wheel_wait(TickWheel *wheel, uint32_t due, int timeout_ms) {
+    WheelSlot *slot = &wheel->slots[due & WHEEL_MASK];
+    struct timespec ts = {timeout_ms / 1000, (long)(timeout_ms % 1000) * 1000000L};
+
+    while (1) {
+        uint32_t gen = __atomic_load_n(&slot->gen, __ATOMIC_SEQ_CST);
+        if (tick_reached(__atomic_load_n(&wheel->tick, __ATOMIC_SEQ_CST), due)) return 0;
+
+        __atomic_add_fetch(&slot->waiters, 1, __ATOMIC_SEQ_CST);
+        int r = futex_wait(&slot->gen, gen, timeout_ms >= 0 ? &ts : NULL);
+        int err = errno;
+        __atomic_sub_fetch(&slot->waiters, 1, __ATOMIC_SEQ_CST);
+
+        // EINTR (las señales de Ursula) y EAGAIN sólo obligan a volver a comprobar; los periodos de más de
+        // WHEEL_SLOTS tics también se despiertan en las vueltas anteriores de la rueda
+        if (r == -1 && err == ETIMEDOUT) {
+            return tick_reached(__atomic_load_n(&wheel->tick, __ATOMIC_SEQ_CST), due) ? 0 : -1;
+        }
+    }
+}
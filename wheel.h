@@ -0,0 +1,42 @@
+/**
+ * @file wheel.h
+ * @brief Reloj común de la flota en modo aleatorio: una rueda de temporización en memoria compartida.
+ *
+ * El capitán es el único que avanza el reloj, un tic cada --clock ms. Cada barco espera el tic en que le toca
+ * moverse en la ranura (tic % WHEEL_SLOTS) de la rueda; al avanzar, el capitán despierta con un solo FUTEX_WAKE a
+ * todos los barcos de la ranura del tic nuevo, en vez de un alarm() y un SIGALRM por barco. Los barcos con el mismo
+ * periodo se mueven en el mismo tic.
+ */
+
+#ifndef WHEEL_H
+#define WHEEL_H
+
+#include <stdint.h>
+
+#define WHEEL_SLOTS 64          // Potencia de dos
+
+// Ranura de la rueda, en su propia línea de caché
+typedef struct {
+    uint32_t gen;               // Palabra del futex: se incrementa cada vez que el reloj pasa por la ranura
+    uint32_t waiters;           // Barcos durmiendo en la ranura
+    char pad[56];
+} WheelSlot;
+
+typedef struct {
+    uint32_t tick;              // Tics transcurridos desde que se creó el reloj
+    char pad[60];
+    WheelSlot slots[WHEEL_SLOTS];
+} TickWheel;
+
+TickWheel* wheel_create(int *fd);
+TickWheel* wheel_attach(int fd);
+void wheel_destroy(TickWheel *wheel);
+
+// Capitán
+void wheel_advance(TickWheel *wheel);
+
+// Barcos
+uint32_t wheel_next_due(const TickWheel *wheel, uint32_t due, int period);
+int wheel_wait(TickWheel *wheel, uint32_t due, int timeout_ms);
+
+#endif
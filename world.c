@@ -0,0 +1,209 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sched.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "world.h"
+
+#define SNAPSHOT_RETRIES 10000
+
+/**
+ * @brief Deriva el nombre del segmento compartido a partir de la ruta del FIFO de Ursula.
+ * Se usa la ruta absoluta cuando el FIFO existe, para que Ursula y sus clientes coincidan
+ * aunque la hayan escrito de forma distinta.
+ * @return 0 en caso de éxito, -1 si el nombre no cabe en len.
+ */
+int world_shm_name(const char *fifo, char *name, int len) {
+    char resolved[PATH_MAX];
+    const char *path = realpath(fifo, resolved) ? resolved : fifo;
+
+    int n = snprintf(name, len, "/ursula");
+    for (const char *p = path; *p && n < len - 1; p++) {
+        char c = *p;
+        int keep = (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9') || c == '.';
+        name[n++] = keep ? c : '_';
+    }
+    if (n >= len - 1) return -1;
+    name[n] = '\0';
+    return 0;
+}
+
+static unsigned int cell_hash(int x, int y) {
+    return ((unsigned int)x * 73856093u) ^ ((unsigned int)y * 19349663u);
+}
+
+/**
+ * @brief Suma delta al contador de la celda (x, y).
+ * @return 0 en caso de éxito, -1 si hay que añadir la celda y la tabla pasaría de 3/4 de ocupación.
+ */
+static int cell_adjust(WorldState *w, int x, int y, int delta) {
+    unsigned int mask = WORLD_CELL_SLOTS - 1;
+    unsigned int i = cell_hash(x, y) & mask;
+    while (w->cells[i].used) {
+        if (w->cells[i].x == x && w->cells[i].y == y) {
+            w->cells[i].count += delta;
+            return 0;
+        }
+        i = (i + 1) & mask;
+    }
+    if (delta <= 0) return 0;
+    if ((w->cell_used + 1) * 4 > WORLD_CELL_SLOTS * 3) return -1;
+
+    w->cells[i].x = x;
+    w->cells[i].y = y;
+    w->cells[i].count = delta;
+    w->cells[i].used = 1;
+    w->cell_used++;
+    return 0;
+}
+
+// Vacía la tabla de ocupación y la rellena con los barcos activos, descartando las celdas abandonadas
+static void cells_rebuild(WorldState *w) {
+    memset(w->cells, 0, sizeof(w->cells));
+    w->cell_used = 0;
+    for (int i = 0; i < WORLD_MAX_SHIPS; i++) {
+        if (w->ships[i].active) cell_adjust(w, w->ships[i].x, w->ships[i].y, 1);
+    }
+}
+
+/**
+ * @brief Crea (o reinicia) el segmento compartido de Ursula.
+ * @return Puntero al estado proyectado en lectura/escritura, o NULL en caso de error.
+ */
+WorldState* world_create(const char *fifo) {
+    char name[NAME_MAX];
+    if (world_shm_name(fifo, name, sizeof(name)) != 0) return NULL;
+
+    int fd = shm_open(name, O_CREAT | O_RDWR, 0644);
+    if (fd == -1) return NULL;
+
+    // Truncar a 0 antes de fijar el tamaño borra lo que hubiera dejado una Ursula anterior
+    if (ftruncate(fd, 0) == -1 || ftruncate(fd, sizeof(WorldState)) == -1) {
+        close(fd);
+        shm_unlink(name);
+        return NULL;
+    }
+
+    WorldState *w = mmap(NULL, sizeof(WorldState), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    close(fd);
+    if (w == MAP_FAILED) {
+        shm_unlink(name);
+        return NULL;
+    }
+
+    w->ursula_pid = getpid();
+    snprintf(w->shm_name, sizeof(w->shm_name), "%s", name);
+    __atomic_store_n(&w->magic, WORLD_MAGIC, __ATOMIC_RELEASE);
+    return w;
+}
+
+void world_destroy(WorldState *world) {
+    if (!world) return;
+    shm_unlink(world->shm_name);
+    munmap(world, sizeof(WorldState));
+}
+
+/** @brief Abre una sección de escritura: los lectores que la solapen reintentarán su copia. */
+void world_write_begin(WorldState *world) {
+    __atomic_store_n(&world->seq, world->seq + 1, __ATOMIC_RELAXED);
+    __atomic_thread_fence(__ATOMIC_RELEASE);
+}
+
+/** @brief Cierra la sección de escritura y publica los cambios. */
+void world_write_end(WorldState *world) {
+    __atomic_store_n(&world->seq, world->seq + 1, __ATOMIC_RELEASE);
+}
+
+/**
+ * @brief Publica el estado de la ranura slot y mueve su marca de ocupación. Sólo dentro de una sección de escritura.
+ */
+void world_set_ship(WorldState *world, int slot, int pid, int x, int y, int food, int gold) {
+    if (slot < 0 || slot >= WORLD_MAX_SHIPS) return;
+    WorldShip *s = &world->ships[slot];
+
+    if (s->active) cell_adjust(world, s->x, s->y, -1);
+    else world->ship_count++;
+
+    s->pid = pid;
+    s->x = x;
+    s->y = y;
+    s->food = food;
+    s->gold = gold;
+    s->active = 1;
+
+    if (cell_adjust(world, x, y, 1) != 0) cells_rebuild(world);
+}
+
+/** @brief Retira la ranura slot del estado publicado. Sólo dentro de una sección de escritura. */
+void world_clear_ship(WorldState *world, int slot) {
+    if (slot < 0 || slot >= WORLD_MAX_SHIPS || !world->ships[slot].active) return;
+    cell_adjust(world, world->ships[slot].x, world->ships[slot].y, -1);
+    world->ships[slot].active = 0;
+    world->ship_count--;
+}
+
+/**
+ * @brief Proyecta en solo lectura el estado publicado por la Ursula que escucha en fifo.
+ * @return El estado compartido, o NULL si Ursula no lo está publicando.
+ */
+const WorldState* world_attach(const char *fifo) {
+    char name[NAME_MAX];
+    struct stat st;
+    if (world_shm_name(fifo, name, sizeof(name)) != 0) return NULL;
+
+    int fd = shm_open(name, O_RDONLY, 0);
+    if (fd == -1) return NULL;
+    if (fstat(fd, &st) == -1 || (size_t)st.st_size < sizeof(WorldState)) {
+        close(fd);
+        return NULL;
+    }
+
+    const WorldState *w = mmap(NULL, sizeof(WorldState), PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if (w == MAP_FAILED) return NULL;
+    if (__atomic_load_n(&w->magic, __ATOMIC_ACQUIRE) != WORLD_MAGIC) {
+        munmap((void *)w, sizeof(WorldState));
+        return NULL;
+    }
+    return w;
+}
+
+void world_detach(const WorldState *world) {
+    if (world) munmap((void *)world, sizeof(WorldState));
+}
+
+/**
+ * @brief Copia una instantánea consistente del estado compartido en out.
+ * Reintenta mientras Ursula esté escribiendo o haya escrito durante la copia.
+ * @return 0 en caso de éxito, -1 si no se obtuvo una copia estable (p.ej. Ursula murió a mitad de una escritura).
+ */
+int world_snapshot(const WorldState *world, WorldState *out) {
+    for (int attempt = 0; attempt < SNAPSHOT_RETRIES; attempt++) {
+        uint32_t before = __atomic_load_n(&world->seq, __ATOMIC_ACQUIRE);
+        if (before & 1) {
+            if (attempt > 100) sched_yield();
+            continue;
+        }
+
+        memcpy(out, world, sizeof(WorldState));
+        __atomic_thread_fence(__ATOMIC_ACQUIRE);
+
+        if (__atomic_load_n(&world->seq, __ATOMIC_RELAXED) == before) return 0;
+    }
+    return -1;
+}
+
+/** @brief Número de barcos en la celda (x, y) según un estado (normalmente una instantánea). */
+int world_cell_count(const WorldState *world, int x, int y) {
+    unsigned int mask = WORLD_CELL_SLOTS - 1;
+    unsigned int i = cell_hash(x, y) & mask;
+    for (int probes = 0; probes < WORLD_CELL_SLOTS && world->cells[i].used; probes++) {
+        if (world->cells[i].x == x && world->cells[i].y == y) return world->cells[i].count;
+        i = (i + 1) & mask;
+    }
+    return 0;
+}
@@ -0,0 +1,69 @@
+/**
+ * @file world.h
+ * @brief Estado global del mar publicado por Ursula en memoria compartida, protegido por un seqlock.
+ *
+ * Ursula es el único escritor: cada mensaje que procesa se aplica entre world_write_begin y world_write_end.
+ * Los lectores (capitanes, visores) proyectan el segmento en solo lectura y copian instantáneas consistentes
+ * con world_snapshot, sin enviar mensajes ni hacer llamadas al sistema.
+ */
+
+#ifndef WORLD_H
+#define WORLD_H
+
+#include <stdint.h>
+
+#define WORLD_MAGIC 0x57524c44u   // "WRLD"
+#define WORLD_MAX_SHIPS 1000
+#define WORLD_CELL_SLOTS 2048       // Potencia de dos, al menos el doble de WORLD_MAX_SHIPS
+
+typedef struct {
+    int32_t pid;
+    int32_t x;
+    int32_t y;
+    int32_t food;
+    int32_t gold;
+    int32_t active;
+} WorldShip;
+
+// Ranura de la tabla hash de ocupación (celda -> número de barcos). Una celda vaciada conserva su ranura.
+typedef struct {
+    int32_t x;
+    int32_t y;
+    int32_t count;
+    int32_t used;
+} WorldCell;
+
+typedef struct {
+    uint32_t magic;
+    uint32_t seq;               // Impar mientras Ursula está escribiendo
+    int32_t ursula_pid;
+    int32_t treasury;
+    int32_t ship_count;         // Barcos activos
+    int32_t captain_count;      // Capitanes conectados
+    int32_t cell_used;          // Ranuras usadas de cells
+    int32_t backlog;            // Eventos pendientes al empezar la última pasada de Ursula
+    uint32_t coalesced;         // MOVE descartados en total por quedar obsoletos dentro de un lote
+    int32_t food_at_sea;        // Comida total a bordo de los barcos activos (agregado incremental)
+    int32_t gold_at_sea;        // Oro total a bordo de los barcos activos
+    char shm_name[256];         // Nombre del segmento, para retirarlo aunque el FIFO ya no exista
+    WorldShip ships[WORLD_MAX_SHIPS];   // Misma numeración que la tabla interna de Ursula
+    WorldCell cells[WORLD_CELL_SLOTS];
+} WorldState;
+
+int world_shm_name(const char *fifo, char *name, int len);
+
+// Escritor (Ursula)
+WorldState* world_create(const char *fifo);
+void world_destroy(WorldState *world);
+void world_write_begin(WorldState *world);
+void world_write_end(WorldState *world);
+void world_set_ship(WorldState *world, int slot, int pid, int x, int y, int food, int gold);
+void world_clear_ship(WorldState *world, int slot);
+
+// Lectores
+const WorldState* world_attach(const char *fifo);
+void world_detach(const WorldState *world);
+int world_snapshot(const WorldState *world, WorldState *out);
+int world_cell_count(const WorldState *world, int x, int y);
+
+#endif